@@ -4,6 +4,17 @@
 #include <math.h>
 #include <stdlib.h>
 
+//  Chequeos de depuracion; si el proyecto no los define no hacen nada
+#ifndef CHECK_MEMORY1
+#define CHECK_MEMORY1(c, m, a)
+#endif
+#ifndef CHECK_DEBUG
+#define CHECK_DEBUG(c, m)
+#endif
+#ifndef CHECK_DEBUG2
+#define CHECK_DEBUG2(c, m, a, b)
+#endif
+
 
 template<class T> class Array{
   protected:
@@ -0,0 +1,84 @@
+#ifndef RSTARAGGREGATE_H
+#define RSTARAGGREGATE_H
+
+#include <cstddef>
+
+// Politica de agregados de RStarTree. Con una activa, cada nodo guarda el
+// agregado de las hojas de su subarbol y QueryAggregate toma los subarboles
+// que la consulta cubre enteros sin bajar a sus hojas. El agregado es un
+// monoide: Combine asociativo con Identity como neutro. El arbol lo
+// recalcula desde los hijos en cada nodo que cambia (Insert, Split,
+// Reinsert, Remove, Update, BulkLoad, InsertBatch, Merge).
+//
+// Interfaz: enabled, value_type, Identity, Leaf, Combine.
+
+
+// Politica por defecto: los nodos no guardan nada
+struct RStarNoAggregate {
+	static const bool enabled = false;
+
+	struct value_type {};
+
+	static value_type Identity() { return value_type(); }
+
+	template <typename LeafType>
+	static value_type Leaf(const LeafType &) { return value_type(); }
+
+	static void Combine(value_type &, const value_type &) {}
+};
+
+
+// Cantidad de hojas
+struct RStarCountAggregate {
+	static const bool enabled = true;
+
+	typedef std::size_t value_type;
+
+	static value_type Identity() { return 0; }
+
+	template <typename LeafType>
+	static value_type Leaf(const LeafType &) { return 1; }
+
+	static void Combine(value_type &total, const value_type &value) { total += value; }
+};
+
+
+// Peso de un LeafType para RStarSumAggregate: el valor mismo; se
+// especializa para sumar un campo
+template <typename LeafType>
+struct RStarLeafWeight {
+	static const LeafType & Get(const LeafType &leaf) { return leaf; }
+};
+
+// Cantidad de hojas y suma de sus pesos
+template <typename Weight = double>
+struct RStarSumAggregate {
+	static const bool enabled = true;
+
+	struct value_type {
+		std::size_t count;
+		Weight sum;
+	};
+
+	static value_type Identity()
+	{
+		value_type value = { 0, Weight() };
+		return value;
+	}
+
+	template <typename LeafType>
+	static value_type Leaf(const LeafType &leaf)
+	{
+		value_type value = { 1, (Weight)RStarLeafWeight<LeafType>::Get(leaf) };
+		return value;
+	}
+
+	static void Combine(value_type &total, const value_type &value)
+	{
+		total.count += value.count;
+		total.sum += value.sum;
+	}
+};
+
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef RSTARALLOCATOR_H
+#define RSTARALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+// tamano de cada slab del pool (bytes)
+#define RSTAR_POOL_SLAB_BYTES 65536
+
+// Pool de objetos de tamano fijo: reserva slabs contiguos y recicla los
+// objetos liberados con una lista libre. ReleaseAll() descarta todos los
+// slabs de una vez sin recorrer los objetos.
+template <typename T>
+class RStarObjectPool {
+public:
+
+	RStarObjectPool() : m_free(NULL), m_next(NULL), m_end(NULL) {}
+
+	~RStarObjectPool()
+	{
+		ReleaseAll();
+	}
+
+	void * Allocate()
+	{
+		if (m_free)
+		{
+			Slot * slot = m_free;
+			m_free = slot->next;
+			return slot;
+		}
+
+		if (m_next == m_end)
+			AddSlab();
+
+		return m_next++;
+	}
+
+	void Deallocate(void * ptr)
+	{
+		Slot * slot = static_cast<Slot*>(ptr);
+		slot->next = m_free;
+		m_free = slot;
+	}
+
+	void ReleaseAll()
+	{
+		for (std::size_t i = 0; i < m_slabs.size(); i++)
+			::operator delete(m_slabs[i]);
+
+		m_slabs.clear();
+		m_free = m_next = m_end = NULL;
+	}
+
+	// pasa a este pool los slabs de other junto con los objetos vivos que
+	// contengan; lo que other tenia libre queda en la lista libre de este
+	void Adopt(RStarObjectPool &other)
+	{
+		m_slabs.insert(m_slabs.end(), other.m_slabs.begin(), other.m_slabs.end());
+
+		for (Slot * slot = other.m_next; slot != other.m_end; slot++)
+			Deallocate(slot);
+
+		while (other.m_free)
+		{
+			Slot * slot = other.m_free;
+			other.m_free = slot->next;
+			Deallocate(slot);
+		}
+
+		other.m_slabs.clear();
+		other.m_next = other.m_end = NULL;
+	}
+
+	std::size_t GetSlabCount() const { return m_slabs.size(); }
+
+private:
+
+	union Slot {
+		Slot * next;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	};
+
+	enum { objects_per_slab = sizeof(Slot) < RSTAR_POOL_SLAB_BYTES ? RSTAR_POOL_SLAB_BYTES / sizeof(Slot) : 1 };
+
+	void AddSlab()
+	{
+		Slot * slab = static_cast<Slot*>(::operator new(sizeof(Slot) * objects_per_slab));
+		m_slabs.push_back(slab);
+
+		m_next = slab;
+		m_end  = slab + objects_per_slab;
+	}
+
+	RStarObjectPool(const RStarObjectPool &);
+	RStarObjectPool & operator=(const RStarObjectPool &);
+
+	std::vector<Slot*> m_slabs;
+	Slot * m_free;
+	Slot * m_next;
+	Slot * m_end;
+};
+
+
+// Politica por defecto: pools separados para nodos y hojas
+template <typename Node, typename Leaf>
+class RStarPoolAllocator {
+public:
+
+	// los slabs se pueden liberar sin devolver cada objeto
+	static const bool bulk_release = true;
+
+	Node * NewNode() { return new (m_nodes.Allocate()) Node(); }
+	Leaf * NewLeaf() { return new (m_leaves.Allocate()) Leaf(); }
+
+	void DeleteNode(Node * node)
+	{
+		node->~Node();
+		m_nodes.Deallocate(node);
+	}
+
+	void DeleteLeaf(Leaf * leaf)
+	{
+		leaf->~Leaf();
+		m_leaves.Deallocate(leaf);
+	}
+
+	void ReleaseAll()
+	{
+		m_nodes.ReleaseAll();
+		m_leaves.ReleaseAll();
+	}
+
+	// los nodos y hojas de other pasan a ser de este allocator
+	void Adopt(RStarPoolAllocator &other)
+	{
+		m_nodes.Adopt(other.m_nodes);
+		m_leaves.Adopt(other.m_leaves);
+	}
+
+private:
+	RStarObjectPool<Node> m_nodes;
+	RStarObjectPool<Leaf> m_leaves;
+};
+
+
+// new/delete de toda la vida
+template <typename Node, typename Leaf>
+class RStarHeapAllocator {
+public:
+
+	static const bool bulk_release = false;
+
+	Node * NewNode() { return new Node(); }
+	Leaf * NewLeaf() { return new Leaf(); }
+
+	void DeleteNode(Node * node) { delete node; }
+	void DeleteLeaf(Leaf * leaf) { delete leaf; }
+
+	void ReleaseAll() {}
+	void Adopt(RStarHeapAllocator &) {}
+};
+
+
+#endif
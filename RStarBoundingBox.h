@@ -9,27 +9,62 @@
 
 
 template <std::size_t dimensions>
+struct RStarPoint {
+	double coords[dimensions];
+};
+
+
+// Tipo en que se calculan area, overlap y margen para cada tipo de
+// coordenada: double para enteros y double, float para float.
+template <typename Coord>
+struct RStarCoordinateTraits {
+	typedef double accum_type;
+};
+
+template <>
+struct RStarCoordinateTraits<float> {
+	typedef float accum_type;
+};
+
+template <>
+struct RStarCoordinateTraits<long double> {
+	typedef long double accum_type;
+};
+
+
+// Un eje de RStarBoundingBox, con los nombres de std::pair pero
+// trivialmente copiable: las cajas se escriben a disco y se mapean tal cual
+template <typename Coord>
+struct RStarEdge {
+	Coord first, second;
+};
+
+
+template <std::size_t dimensions, typename Coord = int>
 struct RStarBoundingBox {
 
-	std::pair<int, int> edges[dimensions];
+	typedef Coord coord_type;
+	typedef typename RStarCoordinateTraits<Coord>::accum_type accum_type;
+
+	RStarEdge<Coord> edges[dimensions];
 	
 	void reset()
 	{
 		for (std::size_t axis = 0; axis < dimensions; axis++)
 		{
-			edges[axis].first = std::numeric_limits<int>::max();
-			edges[axis].second = std::numeric_limits<int>::min();
+			edges[axis].first = std::numeric_limits<Coord>::max();
+			edges[axis].second = std::numeric_limits<Coord>::lowest();
 		}
 	}
 	
 	static RStarBoundingBox MaximumBounds()
 	{
-		RStarBoundingBox<dimensions> bound;
+		RStarBoundingBox bound;
 		bound.reset();
 		return bound;
 	}
 	
-	bool stretch(const RStarBoundingBox<dimensions> &bb)
+	bool stretch(const RStarBoundingBox &bb)
 	{
 		bool ret = false;
 		
@@ -52,25 +87,25 @@ struct RStarBoundingBox {
 		return ret;
 	}
 	
-	inline int edgeDeltas() const
+	inline accum_type edgeDeltas() const
 	{
-		int distance = 0;
+		accum_type distance = 0;
 		for (std::size_t axis = 0; axis < dimensions; axis++)
-			distance += edges[axis].second - edges[axis].first;
+			distance += (accum_type)edges[axis].second - (accum_type)edges[axis].first;
 			
 		return distance;
 	}
 	
-	inline double area() const
+	inline accum_type area() const
 	{
-		double area = 1;
+		accum_type area = 1;
 		for (std::size_t axis = 0; axis < dimensions; axis++)
-			area *= (double)(edges[axis].second - edges[axis].first);
+			area *= (accum_type)edges[axis].second - (accum_type)edges[axis].first;
 		
 		return area;
 	}
 	
-	inline bool encloses(const RStarBoundingBox<dimensions>& bb) const
+	inline bool encloses(const RStarBoundingBox& bb) const
 	{
 		for (std::size_t axis = 0; axis < dimensions; axis++)
 			if (bb.edges[axis].first < edges[axis].first || edges[axis].second < bb.edges[axis].second)
@@ -79,7 +114,7 @@ struct RStarBoundingBox {
 		return true;
 	}
 	
-	inline bool overlaps(const RStarBoundingBox<dimensions>& bb) const
+	inline bool overlaps(const RStarBoundingBox& bb) const
 	{
 		// if (!(x1 < y2) && !(x2 > y1))
 		for (std::size_t axis = 0; axis < dimensions; axis++)
@@ -91,15 +126,15 @@ struct RStarBoundingBox {
 		return true;
 	}
 	
-	double overlap(const RStarBoundingBox<dimensions>& bb) const
+	accum_type overlap(const RStarBoundingBox& bb) const
 	{
-		double area = 1.0;
+		accum_type area = 1.0;
 		for (std::size_t axis = 0; area && axis < dimensions; axis++)
 		{
-			const int x1 = edges[axis].first;
-			const int x2 = edges[axis].second;
-			const int y1 = bb.edges[axis].first;
-			const int y2 = bb.edges[axis].second;
+			const accum_type x1 = edges[axis].first;
+			const accum_type x2 = edges[axis].second;
+			const accum_type y1 = bb.edges[axis].first;
+			const accum_type y2 = bb.edges[axis].second;
 		
 			// borde izquierdo fuera borde izquierdo
 			if (x1 < y1)
@@ -109,9 +144,9 @@ struct RStarBoundingBox {
 				{
 					// borde derecho fuera del borde derecho
 					if (y2 < x2)
-						area *= (double)( y2 - y1 );
+						area *= ( y2 - y1 );
 					else
-						area *= (double)( x2 - y1 );
+						area *= ( x2 - y1 );
 						
 					continue;
 				}
@@ -121,9 +156,9 @@ struct RStarBoundingBox {
 			{
 				// borde derecho fuera del borde derecho
 				if (x2 < y2)
-					area *= (double)( x2 - x1 );
+					area *= ( x2 - x1 );
 				else
-					area *= (double)( y2 - x1 );
+					area *= ( y2 - x1 );
 					
 				continue;
 			}
@@ -134,13 +169,13 @@ struct RStarBoundingBox {
 		return area;
 	}
 	
-	double distanceFromCenter(const RStarBoundingBox<dimensions>& bb) const
+	accum_type distanceFromCenter(const RStarBoundingBox& bb) const
 	{
-		double distance = 0, t;
+		accum_type distance = 0, t;
 		for (std::size_t axis = 0; axis < dimensions; axis++)
 		{
-			t = ((double)edges[axis].first + (double)edges[axis].second + 
-			     (double)bb.edges[axis].first + (double)bb.edges[axis].second)
+			t = ((accum_type)edges[axis].first + (accum_type)edges[axis].second + 
+			     (accum_type)bb.edges[axis].first + (accum_type)bb.edges[axis].second)
 				 /2.0;
 			distance += t*t;
 		}
@@ -148,7 +183,26 @@ struct RStarBoundingBox {
 		return distance;
 	}
 	
-	bool operator==(const RStarBoundingBox<dimensions>& bb)
+	// MINDIST: distancia al cuadrado del punto al punto mas cercano de la caja
+	double minDistance(const RStarPoint<dimensions>& p) const
+	{
+		double distance = 0, t;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			if (p.coords[axis] < (double)edges[axis].first)
+				t = (double)edges[axis].first - p.coords[axis];
+			else if (p.coords[axis] > (double)edges[axis].second)
+				t = p.coords[axis] - (double)edges[axis].second;
+			else
+				continue;
+			
+			distance += t*t;
+		}
+		
+		return distance;
+	}
+	
+	bool operator==(const RStarBoundingBox& bb) const
 	{
 		for (std::size_t axis = 0; axis < dimensions; axis++)
 			if (edges[axis].first != bb.edges[axis].first || edges[axis].second != bb.edges[axis].second)
@@ -176,9 +230,9 @@ struct RStarBoundingBox {
 
 
 
-template <std::size_t dimensions>
+template <std::size_t dimensions, typename Coord = int>
 struct RStarBoundedItem {
-	typedef RStarBoundingBox<dimensions> BoundingBox;
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
 
 	BoundingBox bound;
 };
@@ -226,6 +280,22 @@ struct SortBoundedItemsBySecondEdge :
 };
 
 
+template <typename BoundedItem>
+struct SortBoundedItemsByCenter :
+	public std::binary_function< const BoundedItem * const, const BoundedItem * const, bool >
+{
+	const std::size_t m_axis;
+	explicit SortBoundedItemsByCenter (const std::size_t axis) : m_axis(axis) {}
+
+	// first+second evita dividir entre 2
+	bool operator() (const BoundedItem * const bi1, const BoundedItem * const bi2) const
+	{
+		return (double)bi1->bound.edges[m_axis].first + (double)bi1->bound.edges[m_axis].second <
+		       (double)bi2->bound.edges[m_axis].first + (double)bi2->bound.edges[m_axis].second;
+	}
+};
+
+
 template <typename BoundedItem>
 struct SortBoundedItemsByDistanceFromCenter : 
 	public std::binary_function< const BoundedItem * const, const BoundedItem * const, bool >
@@ -243,12 +313,20 @@ template <typename BoundedItem>
 struct SortBoundedItemsByAreaEnlargement : 
 	public std::binary_function< const BoundedItem * const, const BoundedItem * const, bool >
 {
-	const double area;
-	explicit SortBoundedItemsByAreaEnlargement(const typename BoundedItem::BoundingBox * center) : area(center->area()) {}
+	const typename BoundedItem::BoundingBox * const m_center;
+	explicit SortBoundedItemsByAreaEnlargement(const typename BoundedItem::BoundingBox * center) : m_center(center) {}
 
+	// cuanto crece el area de cada item para incluir a center
 	bool operator() (const BoundedItem * const bi1, const BoundedItem * const bi2) const 
 	{
-		return area - bi1->bound.area() < area - bi2->bound.area();
+		return Enlargement(bi1->bound) < Enlargement(bi2->bound);
+	}
+
+	typename BoundedItem::BoundingBox::accum_type Enlargement(const typename BoundedItem::BoundingBox &bound) const
+	{
+		typename BoundedItem::BoundingBox enlarged = bound;
+		enlarged.stretch(*m_center);
+		return enlarged.area() - bound.area();
 	}
 };
 
@@ -0,0 +1,535 @@
+#ifndef RSTARBUFFERPOOL_H
+#define RSTARBUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// alineacion de los frames del pool y de los tamanos de pagina
+#define RSTAR_PAGE_ALIGN 4096
+
+
+// Archivo de paginas de tamano fijo: la pagina p esta en p * pageSize. Se
+// lee y escribe con pread/pwrite, sin pasar por buffers de stdio.
+class RStarPageFile {
+public:
+
+	RStarPageFile() : m_fd(-1), m_pageSize(0) {}
+
+	~RStarPageFile()
+	{
+		Close();
+	}
+
+	// truncate descarta lo que tenga el archivo; si no existe se crea
+	bool Open(const char * fileName, std::size_t pageSize, bool truncate)
+	{
+		Close();
+
+		const int fd = ::open(fileName, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+		if (fd < 0)
+			return false;
+
+		m_fd = fd;
+		m_pageSize = pageSize;
+		return true;
+	}
+
+	void Close()
+	{
+		if (m_fd >= 0)
+			::close(m_fd);
+
+		m_fd = -1;
+	}
+
+	bool IsOpen() const { return m_fd >= 0; }
+
+	// en bytes
+	uint64_t GetSize() const
+	{
+		struct stat st;
+		if (m_fd < 0 || fstat(m_fd, &st) != 0)
+			return 0;
+
+		return (uint64_t)st.st_size;
+	}
+
+	// paginas completas que tiene el archivo
+	uint64_t GetPageCount() const
+	{
+		return GetSize() / m_pageSize;
+	}
+
+	// false si la pagina no esta entera en el archivo
+	bool Read(uint64_t page, void * data) const
+	{
+		char * out = static_cast<char*>(data);
+		std::size_t done = 0;
+
+		while (done < m_pageSize)
+		{
+			const ssize_t n = ::pread(m_fd, out + done, m_pageSize - done, (off_t)(page * m_pageSize + done));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			done += (std::size_t)n;
+		}
+
+		return true;
+	}
+
+	bool Write(uint64_t page, const void * data)
+	{
+		const char * in = static_cast<const char*>(data);
+		std::size_t done = 0;
+
+		while (done < m_pageSize)
+		{
+			const ssize_t n = ::pwrite(m_fd, in + done, m_pageSize - done, (off_t)(page * m_pageSize + done));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			done += (std::size_t)n;
+		}
+
+		return true;
+	}
+
+	bool Sync()
+	{
+		return m_fd >= 0 && ::fdatasync(m_fd) == 0;
+	}
+
+private:
+
+	RStarPageFile(const RStarPageFile &);
+	RStarPageFile & operator=(const RStarPageFile &);
+
+	int m_fd;
+	std::size_t m_pageSize;
+};
+
+
+// Contadores del pool. Cada Pin es un hit o un miss; reads y writes son
+// paginas leidas y escritas en el archivo.
+struct RStarBufferStats {
+	std::size_t hits;
+	std::size_t misses;
+	std::size_t reads;
+	std::size_t writes;
+	std::size_t evictions;
+
+	RStarBufferStats() : hits(0), misses(0), reads(0), writes(0), evictions(0) {}
+
+	void Reset() { *this = RStarBufferStats(); }
+
+	double HitRatio() const { return hits + misses ? (double)hits / (double)(hits + misses) : 0; }
+
+	RStarBufferStats operator-(const RStarBufferStats &s) const
+	{
+		RStarBufferStats d;
+		d.hits      = hits - s.hits;
+		d.misses    = misses - s.misses;
+		d.reads     = reads - s.reads;
+		d.writes    = writes - s.writes;
+		d.evictions = evictions - s.evictions;
+		return d;
+	}
+};
+
+
+// Politicas de reemplazo de RStarBufferPool. Interfaz:
+//   Reset(frames)      frames vacios, sin historia
+//   Access(frame)      el frame se acaba de fijar
+//   Remove(frame)      el frame deja de tener pagina
+//   Victim(pinned)     frame a desalojar entre los que pinned(frame) da
+//                      por libres; npos si estan todos fijados
+
+// LRU exacto: lista doblemente enlazada por ultimo acceso
+class RStarLRUReplacement {
+public:
+
+	static const std::size_t npos = (std::size_t)-1;
+
+	void Reset(std::size_t frames)
+	{
+		m_prev.assign(frames, std::size_t(npos));
+		m_next.assign(frames, std::size_t(npos));
+		m_linked.assign(frames, false);
+		m_head = m_tail = npos;
+	}
+
+	void Access(std::size_t frame)
+	{
+		Remove(frame);
+
+		m_prev[frame] = npos;
+		m_next[frame] = m_head;
+		if (m_head != npos)
+			m_prev[m_head] = frame;
+		m_head = frame;
+		if (m_tail == npos)
+			m_tail = frame;
+
+		m_linked[frame] = true;
+	}
+
+	void Remove(std::size_t frame)
+	{
+		if (!m_linked[frame])
+			return;
+
+		if (m_prev[frame] != npos) m_next[m_prev[frame]] = m_next[frame]; else m_head = m_next[frame];
+		if (m_next[frame] != npos) m_prev[m_next[frame]] = m_prev[frame]; else m_tail = m_prev[frame];
+
+		m_linked[frame] = false;
+	}
+
+	// desde el menos usado; los fijados son pocos, los del camino actual
+	template <typename Pinned>
+	std::size_t Victim(const Pinned &pinned)
+	{
+		for (std::size_t frame = m_tail; frame != npos; frame = m_prev[frame])
+			if (!pinned(frame))
+				return frame;
+
+		return npos;
+	}
+
+private:
+	std::vector<std::size_t> m_prev, m_next;
+	std::vector<bool> m_linked;
+	std::size_t m_head, m_tail;
+};
+
+// CLOCK: un bit de referencia por frame y una aguja que da la vuelta
+// apagandolos; se desaloja el primero que encuentra apagado. Un acceso solo
+// enciende un bit, sin tocar listas.
+class RStarClockReplacement {
+public:
+
+	static const std::size_t npos = (std::size_t)-1;
+
+	void Reset(std::size_t frames)
+	{
+		m_referenced.assign(frames, 0);
+		m_hand = 0;
+	}
+
+	void Access(std::size_t frame) { m_referenced[frame] = 1; }
+	void Remove(std::size_t frame) { m_referenced[frame] = 0; }
+
+	// dos vueltas alcanzan: en la primera se apagan todos los bits
+	template <typename Pinned>
+	std::size_t Victim(const Pinned &pinned)
+	{
+		const std::size_t frames = m_referenced.size();
+
+		for (std::size_t step = 0; step < 2 * frames; step++)
+		{
+			const std::size_t frame = m_hand;
+			m_hand = m_hand + 1 == frames ? 0 : m_hand + 1;
+
+			if (pinned(frame))
+				continue;
+
+			if (!m_referenced[frame])
+				return frame;
+
+			m_referenced[frame] = 0;
+		}
+
+		return npos;
+	}
+
+private:
+	std::vector<unsigned char> m_referenced;
+	std::size_t m_hand;
+};
+
+
+// Pool de frames de una pagina sobre un RStarPageFile. Pin devuelve el
+// frame con la pagina, leyendola si no estaba, y la deja fijada hasta el
+// Unpin correspondiente; una pagina fijada nunca se desaloja. Las paginas
+// sucias se escriben al desalojarlas o en Flush. Un solo hilo.
+template <typename Replacement = RStarClockReplacement>
+class RStarBufferPool {
+public:
+
+	static const std::size_t npos = (std::size_t)-1;
+
+	RStarBufferPool() : m_memory(NULL), m_pageSize(0) {}
+
+	~RStarBufferPool()
+	{
+		Close();
+	}
+
+	bool Open(const char * fileName, std::size_t pageSize, std::size_t frames, bool truncate = false)
+	{
+		Close();
+
+		assert(pageSize % RSTAR_PAGE_ALIGN == 0);
+		m_pageSize = pageSize;
+
+		if (!m_file.Open(fileName, pageSize, truncate))
+			return false;
+
+		if (!Allocate(frames))
+		{
+			m_file.Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	// escribe lo sucio y cierra; false si alguna escritura fallo
+	bool Close()
+	{
+		bool ok = true;
+
+		if (m_file.IsOpen())
+		{
+			ok = Flush();
+			m_file.Close();
+		}
+
+		Release();
+		return ok;
+	}
+
+	bool IsOpen() const { return m_file.IsOpen(); }
+
+	std::size_t GetPageSize() const { return m_pageSize; }
+	std::size_t GetFrameCount() const { return m_frames.size(); }
+	uint64_t GetFileSize() const { return m_file.GetSize(); }
+	uint64_t GetFilePageCount() const { return m_file.GetPageCount(); }
+
+	// npos si no se pudo leer o no queda ningun frame sin fijar
+	std::size_t Pin(uint64_t page)
+	{
+		typename Table::const_iterator it = m_table.find(page);
+
+		if (it != m_table.end())
+		{
+			m_stats.hits++;
+			m_frames[it->second].pins++;
+			m_replacement.Access(it->second);
+			return it->second;
+		}
+
+		m_stats.misses++;
+
+		const std::size_t frame = Claim();
+		if (frame == npos)
+			return npos;
+
+		if (!m_file.Read(page, Data(frame)))
+		{
+			m_free.push_back(frame);
+			return npos;
+		}
+
+		m_stats.reads++;
+		Install(frame, page, false);
+		return frame;
+	}
+
+	// pagina nueva o reciclada: no se lee, se fija en ceros y sucia
+	std::size_t PinNew(uint64_t page)
+	{
+		typename Table::const_iterator it = m_table.find(page);
+		std::size_t frame;
+
+		if (it != m_table.end())
+		{
+			frame = it->second;
+			m_frames[frame].pins++;
+			m_frames[frame].dirty = true;
+			m_replacement.Access(frame);
+		}
+		else
+		{
+			frame = Claim();
+			if (frame == npos)
+				return npos;
+
+			Install(frame, page, true);
+		}
+
+		std::memset(Data(frame), 0, m_pageSize);
+		return frame;
+	}
+
+	void Unpin(std::size_t frame, bool dirty)
+	{
+		assert(m_frames[frame].pins > 0);
+
+		m_frames[frame].pins--;
+		if (dirty)
+			m_frames[frame].dirty = true;
+	}
+
+	char * Data(std::size_t frame) { return m_memory + frame * m_pageSize; }
+	const char * Data(std::size_t frame) const { return m_memory + frame * m_pageSize; }
+
+	// escribe las paginas sucias, sin sacarlas del pool
+	bool Flush()
+	{
+		bool ok = true;
+
+		for (std::size_t frame = 0; frame < m_frames.size(); frame++)
+			if (m_frames[frame].dirty && !WriteBack(frame))
+				ok = false;
+
+		return ok;
+	}
+
+	// Flush y fdatasync: lo escrito queda en el disco
+	bool Sync()
+	{
+		return Flush() && m_file.Sync();
+	}
+
+	// Cambia la cantidad de frames; lo que estaba en el pool se escribe y
+	// se descarta. false si hay paginas fijadas o falla una escritura.
+	bool Resize(std::size_t frames)
+	{
+		for (std::size_t frame = 0; frame < m_frames.size(); frame++)
+			if (m_frames[frame].pins)
+				return false;
+
+		if (!Flush())
+			return false;
+
+		Release();
+		return Allocate(frames);
+	}
+
+	const RStarBufferStats & GetStats() const { return m_stats; }
+	void ResetStats() { m_stats.Reset(); }
+
+private:
+
+	struct Frame {
+		uint64_t page;
+		std::size_t pins;
+		bool dirty;
+	};
+
+	typedef std::unordered_map<uint64_t, std::size_t> Table;
+
+	struct PinnedFrames {
+		const std::vector<Frame> &frames;
+		explicit PinnedFrames(const std::vector<Frame> &f) : frames(f) {}
+
+		bool operator()(std::size_t frame) const { return frames[frame].pins != 0; }
+	};
+
+	RStarBufferPool(const RStarBufferPool &);
+	RStarBufferPool & operator=(const RStarBufferPool &);
+
+	bool Allocate(std::size_t frames)
+	{
+		void * memory = NULL;
+		if (!frames || posix_memalign(&memory, RSTAR_PAGE_ALIGN, frames * m_pageSize) != 0)
+			return false;
+
+		m_memory = static_cast<char*>(memory);
+
+		Frame empty = { 0, 0, false };
+		m_frames.assign(frames, empty);
+
+		// los frames libres se toman desde el 0
+		m_free.clear();
+		for (std::size_t frame = frames; frame > 0; frame--)
+			m_free.push_back(frame - 1);
+
+		m_table.clear();
+		m_table.reserve(frames);
+		m_replacement.Reset(frames);
+		return true;
+	}
+
+	void Release()
+	{
+		std::free(m_memory);
+		m_memory = NULL;
+
+		m_frames.clear();
+		m_free.clear();
+		m_table.clear();
+	}
+
+	// un frame libre, o el que elige Replacement despues de escribirlo
+	std::size_t Claim()
+	{
+		if (!m_free.empty())
+		{
+			const std::size_t frame = m_free.back();
+			m_free.pop_back();
+			return frame;
+		}
+
+		const std::size_t frame = m_replacement.Victim(PinnedFrames(m_frames));
+		if (frame == npos)
+			return npos;
+
+		if (m_frames[frame].dirty && !WriteBack(frame))
+			return npos;
+
+		m_table.erase(m_frames[frame].page);
+		m_replacement.Remove(frame);
+		m_stats.evictions++;
+		return frame;
+	}
+
+	void Install(std::size_t frame, uint64_t page, bool dirty)
+	{
+		Frame &f = m_frames[frame];
+		f.page = page;
+		f.pins = 1;
+		f.dirty = dirty;
+
+		m_table[page] = frame;
+		m_replacement.Access(frame);
+	}
+
+	bool WriteBack(std::size_t frame)
+	{
+		if (!m_file.Write(m_frames[frame].page, Data(frame)))
+			return false;
+
+		m_stats.writes++;
+		m_frames[frame].dirty = false;
+		return true;
+	}
+
+	RStarPageFile m_file;
+	Replacement m_replacement;
+
+	char * m_memory;
+	std::size_t m_pageSize;
+
+	std::vector<Frame> m_frames;
+	std::vector<std::size_t> m_free;
+	Table m_table;
+
+	RStarBufferStats m_stats;
+};
+
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef RSTARBULKLOAD_H
+#define RSTARBULKLOAD_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "RStarBoundingBox.h"
+
+// por debajo de este numero de items se ordena en un solo hilo
+#define RSTAR_BULK_PARALLEL_MIN 32768
+
+enum RStarBulkOrder {
+	RSTAR_BULK_STR,
+	RSTAR_BULK_HILBERT
+};
+
+
+template <typename Iterator, typename Compare>
+void RStarParallelSort(Iterator begin, Iterator end, Compare comp, unsigned threads)
+{
+	const std::size_t n = end - begin;
+
+	if (threads < 2 || n < RSTAR_BULK_PARALLEL_MIN)
+	{
+		std::sort(begin, end, comp);
+		return;
+	}
+
+	const Iterator middle = begin + n/2;
+
+	std::thread worker(RStarParallelSort<Iterator, Compare>, begin, middle, comp, threads/2);
+	RStarParallelSort(middle, end, comp, threads - threads/2);
+	worker.join();
+
+	std::inplace_merge(begin, middle, end, comp);
+}
+
+
+// J. Skilling, "Programming the Hilbert curve" (2004): coordenadas a
+// forma transpuesta y luego se entrelazan los bits. x tiene bits bits por
+// eje y se modifica
+template <std::size_t dimensions>
+uint64_t RStarHilbertKey(uint32_t * x, unsigned bits)
+{
+	const uint32_t m = (uint32_t)1 << (bits - 1);
+	uint32_t t;
+
+	for (uint32_t q = m; q > 1; q >>= 1)
+	{
+		const uint32_t p = q - 1;
+		for (std::size_t i = 0; i < dimensions; i++)
+		{
+			if (x[i] & q)
+				x[0] ^= p;
+			else
+			{
+				t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
+	}
+
+	for (std::size_t i = 1; i < dimensions; i++)
+		x[i] ^= x[i-1];
+
+	t = 0;
+	for (uint32_t q = m; q > 1; q >>= 1)
+		if (x[dimensions-1] & q)
+			t ^= q - 1;
+
+	for (std::size_t i = 0; i < dimensions; i++)
+		x[i] ^= t;
+
+	uint64_t key = 0;
+	for (int b = (int)bits - 1; b >= 0; b--)
+		for (std::size_t i = 0; i < dimensions; i++)
+			key = (key << 1) | ((x[i] >> b) & 1);
+
+	return key;
+}
+
+
+// Empaqueta items (hojas o nodos) en grupos de como mucho `capacity`
+// elementos y al menos `minimum`, ordenados con Sort-Tile-Recursive o por
+// clave de Hilbert. Solo queda un grupo con menos de minimum si no hay
+// items para mas, y es la raiz.
+template <typename BoundedItem, std::size_t dimensions>
+class RStarBulkPacker {
+public:
+
+	typedef typename std::vector<BoundedItem*>::iterator ItemIterator;
+
+	RStarBulkPacker(std::size_t capacity, std::size_t minimum, RStarBulkOrder order, unsigned threads) :
+		m_capacity(capacity), m_minimum(minimum ? minimum : 1), m_order(order), m_threads(threads ? threads : 1) {}
+
+	// reordena items; groups recibe el tamano de cada nodo, en orden
+	void Pack(std::vector<BoundedItem*> &items, std::vector<std::size_t> &groups) const
+	{
+		groups.clear();
+
+		if (items.empty())
+			return;
+
+		const std::size_t count = NodeCount(items.size());
+
+		if (m_order == RSTAR_BULK_HILBERT)
+		{
+			SortByHilbert(items);
+			Chunk(items.size(), count, groups);
+		}
+		else
+			TileTop(items, count, groups);
+	}
+
+private:
+
+	// un slab de STR: desde donde, cuantos items y en cuantos nodos
+	struct Slab {
+		std::size_t begin, size, nodes;
+	};
+
+	// los nodos que hacen falta con capacity, pero sin bajar de minimum
+	// items por nodo: si capacity es chica (fill bajo) quedan menos nodos,
+	// de hasta 2*minimum-1 items, que entra en max_child_items
+	std::size_t NodeCount(std::size_t n) const
+	{
+		const std::size_t count = (n + m_capacity - 1) / m_capacity;
+		return std::max<std::size_t>(1, std::min(count, n / m_minimum));
+	}
+
+	// reparte n items en count nodos, lo mas parejos posible
+	void Chunk(std::size_t n, std::size_t count, std::vector<std::size_t> &groups) const
+	{
+		for (std::size_t i = 0; i < count; i++)
+			groups.push_back(n / count + (i < n % count ? 1 : 0));
+	}
+
+	// reparte count nodos entre los slabs del eje y a cada slab le da n/count
+	// items por nodo, mas uno por cada uno de los primeros n%count nodos; asi
+	// todos los nodos de todos los slabs terminan con n/count o n/count+1
+	void Slabs(std::size_t n, std::size_t count, std::size_t axis, std::vector<Slab> &slabs) const
+	{
+		const std::size_t slabCount = std::min(count,
+			(std::size_t)std::ceil(std::pow((double)count, 1.0 / (double)(dimensions - axis))));
+
+		std::size_t begin = 0, extra = n % count;
+		for (std::size_t s = 0; s < slabCount; s++)
+		{
+			Slab slab;
+			slab.begin = begin;
+			slab.nodes = count / slabCount + (s < count % slabCount ? 1 : 0);
+
+			const std::size_t more = std::min(extra, slab.nodes);
+			slab.size = slab.nodes * (n / count) + more;
+			extra -= more;
+
+			slabs.push_back(slab);
+			begin += slab.size;
+		}
+	}
+
+	void Tile(ItemIterator begin, ItemIterator end, std::size_t count, std::size_t axis, std::vector<std::size_t> &groups) const
+	{
+		const std::size_t n = end - begin;
+
+		if (axis == dimensions - 1 || count <= 1)
+		{
+			if (count > 1)
+				std::sort(begin, end, SortBoundedItemsByCenter<BoundedItem>(axis));
+
+			Chunk(n, count, groups);
+			return;
+		}
+
+		std::sort(begin, end, SortBoundedItemsByCenter<BoundedItem>(axis));
+
+		std::vector<Slab> slabs;
+		Slabs(n, count, axis, slabs);
+
+		for (std::size_t s = 0; s < slabs.size(); s++)
+			Tile(begin + slabs[s].begin, begin + slabs[s].begin + slabs[s].size, slabs[s].nodes, axis + 1, groups);
+	}
+
+	// primer eje: orden global en paralelo y luego cada hilo procesa sus slabs
+	void TileTop(std::vector<BoundedItem*> &items, std::size_t count, std::vector<std::size_t> &groups) const
+	{
+		const std::size_t n = items.size();
+
+		if (m_threads < 2 || n < RSTAR_BULK_PARALLEL_MIN || dimensions == 1)
+		{
+			Tile(items.begin(), items.end(), count, 0, groups);
+			return;
+		}
+
+		RStarParallelSort(items.begin(), items.end(), SortBoundedItemsByCenter<BoundedItem>(0), m_threads);
+
+		std::vector<Slab> slabs;
+		Slabs(n, count, 0, slabs);
+
+		const std::size_t workers = std::min<std::size_t>(m_threads, slabs.size());
+
+		std::vector< std::vector<std::size_t> > slabGroups(slabs.size());
+		std::vector<std::thread> threads;
+
+		for (std::size_t w = 0; w < workers; w++)
+			threads.push_back(std::thread(&RStarBulkPacker::TileSlabs, this, &items, &slabs,
+				w * slabs.size() / workers, (w+1) * slabs.size() / workers, &slabGroups));
+
+		for (std::size_t w = 0; w < workers; w++)
+			threads[w].join();
+
+		for (std::size_t s = 0; s < slabs.size(); s++)
+			groups.insert(groups.end(), slabGroups[s].begin(), slabGroups[s].end());
+	}
+
+	void TileSlabs(std::vector<BoundedItem*> * items, const std::vector<Slab> * slabs, std::size_t first, std::size_t last,
+		std::vector< std::vector<std::size_t> > * slabGroups) const
+	{
+		for (std::size_t s = first; s < last; s++)
+		{
+			const Slab &slab = (*slabs)[s];
+			Tile(items->begin() + slab.begin, items->begin() + slab.begin + slab.size, slab.nodes, 1, (*slabGroups)[s]);
+		}
+	}
+
+	typedef std::pair<uint64_t, BoundedItem*> KeyedItem;
+
+	static bool CompareKeys(const KeyedItem &a, const KeyedItem &b)
+	{
+		return a.first < b.first;
+	}
+
+	void SortByHilbert(std::vector<BoundedItem*> &items) const
+	{
+		const std::size_t n = items.size();
+		double low[dimensions], scale[dimensions];
+
+		// bits por eje para que la clave quepa en 64 bits
+		const unsigned bits = (unsigned)std::max<std::size_t>(1, std::min<std::size_t>(32, 64 / dimensions));
+		const double cells = std::ldexp(1.0, bits) - 1.0;
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			double lo = std::numeric_limits<double>::max(), hi = -std::numeric_limits<double>::max();
+
+			for (std::size_t i = 0; i < n; i++)
+			{
+				const double c = Center(items[i], axis);
+				lo = std::min(lo, c);
+				hi = std::max(hi, c);
+			}
+
+			low[axis] = lo;
+			scale[axis] = hi > lo ? cells / (hi - lo) : 0.0;
+		}
+
+		std::vector<KeyedItem> keyed(n);
+		const std::size_t workers = n < RSTAR_BULK_PARALLEL_MIN ? 1 : m_threads;
+		std::vector<std::thread> threads;
+
+		for (std::size_t w = 1; w < workers; w++)
+			threads.push_back(std::thread(&RStarBulkPacker::ComputeKeys, &items, &keyed,
+				w * n / workers, (w+1) * n / workers, low, scale, bits));
+
+		ComputeKeys(&items, &keyed, 0, n / workers, low, scale, bits);
+
+		for (std::size_t w = 0; w < threads.size(); w++)
+			threads[w].join();
+
+		RStarParallelSort(keyed.begin(), keyed.end(), CompareKeys, m_threads);
+
+		for (std::size_t i = 0; i < n; i++)
+			items[i] = keyed[i].second;
+	}
+
+	static double Center(const BoundedItem * item, std::size_t axis)
+	{
+		return ((double)item->bound.edges[axis].first + (double)item->bound.edges[axis].second) / 2.0;
+	}
+
+	static void ComputeKeys(const std::vector<BoundedItem*> * items, std::vector<KeyedItem> * keyed,
+		std::size_t first, std::size_t last, const double * low, const double * scale, unsigned bits)
+	{
+		uint32_t x[dimensions];
+
+		for (std::size_t i = first; i < last; i++)
+		{
+			BoundedItem * item = (*items)[i];
+
+			for (std::size_t axis = 0; axis < dimensions; axis++)
+				x[axis] = (uint32_t)((Center(item, axis) - low[axis]) * scale[axis]);
+
+			(*keyed)[i] = KeyedItem(RStarHilbertKey<dimensions>(x, bits), item);
+		}
+	}
+
+	const std::size_t m_capacity, m_minimum;
+	const RStarBulkOrder m_order;
+	const unsigned m_threads;
+};
+
+
+#endif
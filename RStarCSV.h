@@ -0,0 +1,560 @@
+#ifndef RSTARCSV_H
+#define RSTARCSV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__has_include)
+	#if __cplusplus >= 201703L && __has_include(<charconv>)
+		#include <charconv>
+	#endif
+#endif
+
+#include "RStarBoundingBox.h"
+#include "RStarThreadPool.h"
+
+// Carga de archivos de texto con una fila por linea y campos numericos
+// separados por comas, como YearPredictionMSD.txt. El archivo se mapea y
+// se procesa en lotes de RSTAR_CSV_BATCH_BYTES: cada lote se corta en
+// trozos que terminan en fin de linea, los trozos se parsean en paralelo en
+// un RStarThreadPool y las cajas del lote se entregan en orden de archivo
+// antes de pasar al siguiente, asi que la memoria no depende del tamano
+// del archivo. Con C++17 los numeros se leen con std::from_chars; si no,
+// con RStarParseDouble.
+
+// bytes de archivo por lote
+#define RSTAR_CSV_BATCH_BYTES (64 << 20)
+
+// bytes minimos por trozo de un lote
+#define RSTAR_CSV_CHUNK_BYTES (256 << 10)
+
+
+// Decimales de hasta 19 cifras significativas con exponente chico salen
+// exactos de una multiplicacion o division (Clinger): mantisa <= 2^53 y
+// 10^|exponente| <= 10^22 son exactos en double. El resto va a strtod.
+// El campo entero tiene que ser el numero, sin espacios.
+inline bool RStarParseDouble(const char * first, const char * last, double &value)
+{
+#if defined(__cpp_lib_to_chars)
+	if (first != last && *first == '+')
+		first++;
+
+	const std::from_chars_result result = std::from_chars(first, last, value);
+	return result.ec == std::errc() && result.ptr == last;
+#else
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char * p = first;
+	const bool negative = p != last && *p == '-';
+	if (p != last && (*p == '-' || *p == '+'))
+		p++;
+
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false, fast = true;
+
+	for (; p != last && *p >= '0' && *p <= '9'; p++, any = true)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+			digits += mantissa != 0;
+		}
+		else
+			fast = false;
+	}
+
+	if (p != last && *p == '.')
+	{
+		for (p++; p != last && *p >= '0' && *p <= '9'; p++, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+			else
+				fast = false;
+		}
+	}
+
+	if (any && p != last && (*p == 'e' || *p == 'E'))
+	{
+		const char * q = p + 1;
+		const bool negativeExponent = q != last && *q == '-';
+		if (q != last && (*q == '-' || *q == '+'))
+			q++;
+
+		int e = 0;
+		bool exponentDigits = false;
+		for (; q != last && *q >= '0' && *q <= '9'; q++, exponentDigits = true)
+			e = std::min(e * 10 + (*q - '0'), 100000);
+
+		if (exponentDigits)
+		{
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	if (any && fast && p == last && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+	{
+		value = exponent < 0 ? (double)mantissa / powers[-exponent] : (double)mantissa * powers[exponent];
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	// inf, nan o muchas cifras: strtod necesita el campo terminado en 0,
+	// y el archivo mapeado no lo esta. Como from_chars, sin hexadecimales
+	// ni valores que no entran en un double
+	char buffer[128];
+	const std::size_t length = (std::size_t)(last - first);
+	if (length == 0 || length >= sizeof(buffer) || std::memchr(first, 'x', length) || std::memchr(first, 'X', length))
+		return false;
+
+	std::memcpy(buffer, first, length);
+	buffer[length] = 0;
+
+	char * end;
+	errno = 0;
+	value = std::strtod(buffer, &end);
+	return end == buffer + length && !(errno == ERANGE && std::fabs(value) == HUGE_VAL);
+#endif
+}
+
+
+// Columnas (desde 0) de cada eje. Con high < 0 el eje es un punto; con
+// extent, high es el ancho y la caja va de low a low + |ancho|, como en
+// main.cpp; si no, high es el otro borde y se ordenan.
+template <std::size_t dimensions>
+struct RStarCSVLayout {
+
+	int low[dimensions];
+	int high[dimensions];
+	bool extent;
+
+	char separator;
+
+	// lineas de encabezado que se saltan; no cuentan como filas
+	std::size_t skipLines;
+
+	// las primeras dimensions columnas como un punto
+	RStarCSVLayout() : extent(false), separator(','), skipLines(0)
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			low[axis]  = (int)axis;
+			high[axis] = -1;
+		}
+	}
+
+	RStarCSVLayout & Set(std::size_t axis, int lowColumn, int highColumn = -1)
+	{
+		low[axis]  = lowColumn;
+		high[axis] = highColumn;
+		return *this;
+	}
+
+	int LastColumn() const
+	{
+		int last = 0;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			last = std::max(last, std::max(low[axis], high[axis]));
+		return last;
+	}
+};
+
+
+struct RStarCSVStats {
+	std::size_t rows;		// filas entregadas
+	std::size_t badRows;	// lineas sin todas las columnas o con campos que no son numeros
+	std::size_t bytes;		// bytes del archivo recorridos
+	std::size_t batches;
+
+	double parseSeconds;	// partir y parsear, sin el sink
+	double seconds;			// todo, con el sink
+
+	RStarCSVStats() : rows(0), badRows(0), bytes(0), batches(0), parseSeconds(0), seconds(0) {}
+
+	double RowsPerSecond() const { return seconds > 0 ? rows / seconds : 0; }
+	double BytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+};
+
+
+// Las filas se numeran desde 0 en orden de archivo, sin el encabezado; una
+// fila mala tambien consume su numero, asi el numero es la linea. El sink
+// recibe lotes de Item (numero de fila, caja) y el LeafType de los arboles
+// se construye con ese numero.
+template <std::size_t dimensions, typename Coord = double>
+class RStarCSVLoader {
+public:
+
+	typedef RStarBoundingBox<dimensions, Coord>		BoundingBox;
+	typedef RStarCSVLayout<dimensions>				Layout;
+	typedef std::pair<std::size_t, BoundingBox>		Item;
+
+	explicit RStarCSVLoader(const Layout &layout = Layout(), RStarThreadPool &pool = RStarThreadPool::Default()) :
+		m_layout(layout), m_pool(pool), m_batchBytes(RSTAR_CSV_BATCH_BYTES), m_limit((std::size_t)-1)
+	{
+		// columna -> eje y borde, para recorrer cada linea una sola vez
+		m_columns.assign(layout.LastColumn() + 1, Target());
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			m_columns[layout.low[axis]].mask |= 1u << (2*axis);
+			if (layout.high[axis] >= 0)
+				m_columns[layout.high[axis]].mask |= 1u << (2*axis + 1);
+		}
+	}
+
+	void SetBatchBytes(std::size_t bytes) { m_batchBytes = std::max<std::size_t>(bytes, 1); }
+	std::size_t GetBatchBytes() const { return m_batchBytes; }
+
+	// filas buenas como maximo
+	void SetLimit(std::size_t rows) { m_limit = rows; }
+	std::size_t GetLimit() const { return m_limit; }
+
+	const RStarCSVStats & GetStats() const { return m_stats; }
+
+	// sink(first, last) con cada lote de Item; false si no se puede mapear
+	// el archivo
+	template <typename Sink>
+	bool Read(const char * fileName, Sink &sink)
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+
+		m_stats = RStarCSVStats();
+
+		const int fd = ::open(fileName, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		const std::size_t length = (std::size_t)st.st_size;
+		void * data = length ? mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+		::close(fd);
+
+		if (data == MAP_FAILED)
+			return false;
+
+		if (data)
+			madvise(data, length, MADV_SEQUENTIAL);
+
+		const char * const text = static_cast<const char*>(data);
+		const std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+
+		std::size_t pos = 0, row = 0, released = 0;
+
+		for (std::size_t i = 0; i < m_layout.skipLines && pos < length; i++)
+			pos = LineEnd(text, pos, length);
+
+		while (pos < length && m_stats.rows < m_limit)
+		{
+			const Clock::time_point parseStart = Clock::now();
+
+			// con limit, el lote alcanza para las filas que faltan segun el
+			// largo medio de las lineas vistas
+			std::size_t window = m_batchBytes;
+			if (m_limit != (std::size_t)-1)
+			{
+				const std::size_t seen = row ? (pos / row) : LineEnd(text, pos, length) - pos;
+				const std::size_t wanted = (m_limit - m_stats.rows) * (seen + 1) * 2;
+				window = std::min(window, std::max<std::size_t>(wanted, 4096));
+			}
+
+			const std::size_t end = pos + window >= length ? length : LineEnd(text, pos + window - 1, length);
+
+			ParseBatch(text, pos, end, row);
+
+			m_stats.parseSeconds += std::chrono::duration<double>(Clock::now() - parseStart).count();
+			m_stats.bytes += end - pos;
+			m_stats.batches++;
+
+			if (m_stats.rows + m_items.size() > m_limit)
+				m_items.resize(m_limit - m_stats.rows);
+
+			m_stats.rows += m_items.size();
+
+			if (!m_items.empty())
+				sink(&m_items[0], &m_items[0] + m_items.size());
+
+			// las paginas ya leidas no siguen contando en la memoria del
+			// proceso
+			pos = end;
+			const std::size_t done = pos / page * page;
+			if (done > released)
+			{
+				madvise(const_cast<char*>(text) + released, done - released, MADV_DONTNEED);
+				released = done;
+			}
+		}
+
+		m_items.clear();
+
+		if (data)
+			munmap(data, length);
+
+		m_stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		return true;
+	}
+
+	// todas las filas a items (sin limite de memoria)
+	bool ReadAll(const char * fileName, std::vector<Item> &items)
+	{
+		AppendItems sink(&items);
+		return Read(fileName, sink);
+	}
+
+	// tree.Insert de cada fila
+	template <typename Tree>
+	bool Insert(const char * fileName, Tree &tree)
+	{
+		InsertItems<Tree> sink(&tree);
+		return Read(fileName, sink);
+	}
+
+	// tree.InsertBatch de cada lote: el primero, con el arbol vacio, es un
+	// BulkLoad y los siguientes se empaquetan y se injertan
+	template <typename Tree>
+	bool InsertBatch(const char * fileName, Tree &tree, double fill = 1.0)
+	{
+		InsertBatches<Tree> sink(&tree, fill);
+		return Read(fileName, sink);
+	}
+
+private:
+
+	RStarCSVLoader(const RStarCSVLoader &);
+	RStarCSVLoader & operator=(const RStarCSVLoader &);
+
+	// bits 2*axis (low) y 2*axis + 1 (high) de los ejes que usan la columna
+	struct Target {
+		unsigned mask;
+		Target() : mask(0) {}
+	};
+
+	// fila dentro del trozo, para numerarla cuando se conozcan los trozos
+	// anteriores
+	struct ChunkItem {
+		std::size_t line;
+		BoundingBox bound;
+	};
+
+	struct Chunk {
+		std::size_t begin, end;
+		std::size_t lines, bad;
+		std::vector<ChunkItem> items;
+	};
+
+	struct AppendItems {
+		std::vector<Item> * items;
+		explicit AppendItems(std::vector<Item> * i) : items(i) {}
+
+		void operator()(const Item * first, const Item * last) { items->insert(items->end(), first, last); }
+	};
+
+	template <typename Tree>
+	struct InsertItems {
+		Tree * tree;
+		explicit InsertItems(Tree * t) : tree(t) {}
+
+		void operator()(const Item * first, const Item * last)
+		{
+			for (; first != last; ++first)
+				tree->Insert(first->first, first->second);
+		}
+	};
+
+	template <typename Tree>
+	struct InsertBatches {
+		Tree * tree;
+		double fill;
+		InsertBatches(Tree * t, double f) : tree(t), fill(f) {}
+
+		void operator()(const Item * first, const Item * last) { tree->InsertBatch(first, last, fill); }
+	};
+
+	struct ParseJob {
+		RStarCSVLoader * loader;
+		const char * text;
+
+		void operator()(std::size_t begin, std::size_t end, unsigned) const
+		{
+			for (std::size_t c = begin; c < end; c++)
+				loader->ParseChunk(text, loader->m_chunks[c]);
+		}
+	};
+
+	// posicion siguiente al '\n' de la linea en que esta pos
+	static std::size_t LineEnd(const char * text, std::size_t pos, std::size_t length)
+	{
+		const void * newline = std::memchr(text + pos, '\n', length - pos);
+		return newline ? (std::size_t)(static_cast<const char*>(newline) - text) + 1 : length;
+	}
+
+	// parte [begin, end) en trozos por linea, los parsea en paralelo y deja
+	// las filas buenas en m_items; row avanza con las lineas del lote
+	void ParseBatch(const char * text, std::size_t begin, std::size_t end, std::size_t &row)
+	{
+		const std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(
+			(end - begin) / RSTAR_CSV_CHUNK_BYTES, 4 * (std::size_t)m_pool.GetThreadCount()));
+
+		m_chunks.resize(chunks);
+
+		std::size_t at = begin;
+		for (std::size_t c = 0; c < chunks; c++)
+		{
+			m_chunks[c].begin = at;
+
+			if (c + 1 == chunks)
+				at = end;
+			else
+			{
+				const std::size_t target = begin + (end - begin) * (c + 1) / chunks;
+				if (target > at)
+					at = LineEnd(text, target - 1, end);
+			}
+
+			m_chunks[c].end = at;
+		}
+
+		ParseJob job = { this, text };
+		if (chunks > 1)
+			m_pool.ParallelFor(chunks, 1, job);
+		else
+			job(0, 1, 0);
+
+		m_items.clear();
+
+		for (std::size_t c = 0; c < chunks; c++)
+		{
+			const Chunk &chunk = m_chunks[c];
+
+			for (std::size_t i = 0; i < chunk.items.size(); i++)
+				m_items.push_back(Item(row + chunk.items[i].line, chunk.items[i].bound));
+
+			row += chunk.lines;
+			m_stats.badRows += chunk.bad;
+		}
+	}
+
+	void ParseChunk(const char * text, Chunk &chunk) const
+	{
+		chunk.lines = 0;
+		chunk.bad = 0;
+		chunk.items.clear();
+
+		std::size_t pos = chunk.begin;
+
+		while (pos < chunk.end)
+		{
+			const std::size_t next = LineEnd(text, pos, chunk.end);
+
+			ChunkItem item;
+			item.line = chunk.lines++;
+
+			if (ParseLine(text + pos, text + next, item.bound))
+				chunk.items.push_back(item);
+			else
+				chunk.bad++;
+
+			pos = next;
+		}
+	}
+
+	bool ParseLine(const char * p, const char * end, BoundingBox &bound) const
+	{
+		double low[dimensions], high[dimensions];
+
+		while (end != p && (end[-1] == '\n' || end[-1] == '\r'))
+			end--;
+
+		for (std::size_t column = 0; column < m_columns.size(); column++)
+		{
+			if (p > end)
+				return false;
+
+			const char * separator = static_cast<const char*>(std::memchr(p, m_layout.separator, end - p));
+			const char * fieldEnd = separator ? separator : end;
+
+			const unsigned mask = m_columns[column].mask;
+			if (mask)
+			{
+				const char * first = p, * last = fieldEnd;
+				while (first != last && (*first == ' ' || *first == '\t'))
+					first++;
+				while (last != first && (last[-1] == ' ' || last[-1] == '\t'))
+					last--;
+
+				double value;
+				if (!RStarParseDouble(first, last, value))
+					return false;
+
+				for (std::size_t axis = 0; axis < dimensions; axis++)
+				{
+					if (mask & (1u << (2*axis)))
+						low[axis] = value;
+					if (mask & (1u << (2*axis + 1)))
+						high[axis] = value;
+				}
+			}
+
+			p = fieldEnd + 1;
+		}
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			if (m_layout.high[axis] < 0)
+				high[axis] = low[axis];
+			else if (m_layout.extent)
+				high[axis] = low[axis] + std::fabs(high[axis]);
+			else if (high[axis] < low[axis])
+				std::swap(low[axis], high[axis]);
+
+			bound.edges[axis].first  = (Coord)low[axis];
+			bound.edges[axis].second = (Coord)high[axis];
+		}
+
+		return true;
+	}
+
+	const Layout m_layout;
+	RStarThreadPool & m_pool;
+
+	std::size_t m_batchBytes;
+	std::size_t m_limit;
+
+	std::vector<Target> m_columns;
+	std::vector<Chunk> m_chunks;
+	std::vector<Item> m_items;
+
+	RStarCSVStats m_stats;
+};
+
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef RSTAREPOCH_H
+#define RSTAREPOCH_H
+
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstddef>
+
+// numero maximo de lectores concurrentes
+#define RSTAR_EPOCH_MAX_READERS 128
+
+// Reclamacion por epocas para un escritor y muchos lectores. Cada lector
+// anuncia la epoca global al entrar; el escritor etiqueta lo que retira con
+// la epoca vigente y solo lo libera cuando todos los lectores activos
+// anunciaron una epoca posterior.
+class RStarEpochManager {
+public:
+
+	RStarEpochManager() : m_epoch(1)
+	{
+		for (std::size_t i = 0; i < RSTAR_EPOCH_MAX_READERS; i++)
+			m_slots[i].epoch.store(0, std::memory_order_relaxed);
+	}
+
+	// devuelve el slot del lector; espera si todos estan ocupados
+	std::size_t Enter()
+	{
+		std::size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % RSTAR_EPOCH_MAX_READERS;
+
+		for (;;)
+		{
+			for (std::size_t i = 0; i < RSTAR_EPOCH_MAX_READERS; i++, slot = (slot + 1) % RSTAR_EPOCH_MAX_READERS)
+			{
+				unsigned long expected = 0;
+				const unsigned long epoch = m_epoch.load(std::memory_order_seq_cst);
+
+				if (m_slots[slot].epoch.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst))
+					return slot;
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	void Exit(std::size_t slot)
+	{
+		m_slots[slot].epoch.store(0, std::memory_order_release);
+	}
+
+	// solo el escritor
+	unsigned long GetEpoch() const
+	{
+		return m_epoch.load(std::memory_order_relaxed);
+	}
+
+	void Advance()
+	{
+		m_epoch.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	// lo retirado en una epoca menor que esta ya no es visible para nadie
+	unsigned long SafeEpoch() const
+	{
+		unsigned long safe = m_epoch.load(std::memory_order_seq_cst);
+
+		for (std::size_t i = 0; i < RSTAR_EPOCH_MAX_READERS; i++)
+		{
+			const unsigned long epoch = m_slots[i].epoch.load(std::memory_order_seq_cst);
+			if (epoch && epoch < safe)
+				safe = epoch;
+		}
+
+		return safe;
+	}
+
+private:
+
+	// un slot por linea de cache
+	struct Slot {
+		std::atomic<unsigned long> epoch;
+		char padding[64 - sizeof(std::atomic<unsigned long>)];
+	};
+
+	RStarEpochManager(const RStarEpochManager &);
+	RStarEpochManager & operator=(const RStarEpochManager &);
+
+	std::atomic<unsigned long> m_epoch;
+	Slot m_slots[RSTAR_EPOCH_MAX_READERS];
+};
+
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef RSTARFILE_H
+#define RSTARFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "RStarBoundingBox.h"
+#include "RStarVisitor.h"
+
+// Formato binario de RStarTree::Save. Todo es relativo al inicio del
+// archivo, sin punteros, asi que se puede mapear tal cual:
+//
+//   RStarFileHeader
+//   nodos en orden BFS (raiz = 0), RStarFileNode<...>
+//   hojas en el orden de sus nodos, RStarFileLeaf<...>
+//
+// Los hijos de un nodo son contiguos: [first, first + count) en el arreglo
+// de nodos, o en el de hojas si hasLeaves. Los tamanos y el tipo de
+// coordenada van en el header para rechazar archivos de otra configuracion.
+
+#define RSTAR_FILE_MAGIC "RSTARTRE"
+#define RSTAR_FILE_VERSION 1
+
+// los arreglos empiezan alineados a esto
+#define RSTAR_FILE_ALIGN 64
+
+struct RStarFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;		// 0x01020304 escrito en el orden de la maquina
+
+	uint32_t dimensions;
+	uint32_t coordSize;
+	uint32_t coordKind;		// 0 entero con signo, 1 sin signo, 2 flotante
+	uint32_t height;
+
+	uint32_t nodeSize;
+	uint32_t leafSize;
+	uint32_t payloadSize;	// sizeof(LeafType)
+	uint32_t reserved;
+	uint64_t nodeCount;
+	uint64_t leafCount;
+	uint64_t nodeOffset;
+	uint64_t leafOffset;
+	uint64_t fileSize;
+
+	template <typename Coord>
+	static uint32_t CoordKind()
+	{
+		return std::is_floating_point<Coord>::value ? 2 : (std::is_signed<Coord>::value ? 0 : 1);
+	}
+};
+
+template <std::size_t dimensions, typename Coord>
+struct RStarFileNode {
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
+
+	BoundingBox bound;
+	uint64_t first;
+	uint32_t count;
+	uint32_t hasLeaves;
+};
+
+// misma interfaz que RStarLeaf: los Acceptors y visitors sirven igual
+template <std::size_t dimensions, typename Coord, typename LeafType>
+struct RStarFileLeaf {
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
+	typedef LeafType leaf_type;
+
+	BoundingBox bound;
+	LeafType leaf;
+};
+
+inline uint64_t RStarFileAlign(uint64_t offset)
+{
+	return (offset + RSTAR_FILE_ALIGN - 1) & ~(uint64_t)(RSTAR_FILE_ALIGN - 1);
+}
+
+
+// Arbol de solo lectura sobre un archivo escrito con RStarTree::Save. El
+// archivo se mapea con MAP_SHARED, sin copiarlo: los procesos que abren el
+// mismo archivo comparten sus paginas en el page cache.
+template <typename LeafType, std::size_t dimensions, typename Coord = int>
+class RStarMappedTree {
+public:
+
+	typedef RStarFileNode<dimensions, Coord>			Node;
+	typedef RStarFileLeaf<dimensions, Coord, LeafType>	Leaf;
+	typedef typename Node::BoundingBox					BoundingBox;
+
+	typedef RStarAcceptOverlapping<Node, Leaf>	AcceptOverlapping;
+	typedef RStarAcceptEnclosing<Node, Leaf>	AcceptEnclosing;
+	typedef RStarAcceptAny<Node, Leaf>			AcceptAny;
+
+	// los registros se leen del mapeo sin copiarlos
+	static_assert(std::is_trivially_copyable<Node>::value, "RStarFileNode tiene que ser trivialmente copiable");
+	static_assert(std::is_trivially_copyable<Leaf>::value, "RStarMappedTree requiere un LeafType trivialmente copiable");
+
+	RStarMappedTree() : m_data(NULL), m_length(0), m_header(NULL), m_nodes(NULL), m_leaves(NULL) {}
+
+	~RStarMappedTree()
+	{
+		Close();
+	}
+
+	// false si no se puede mapear o no es un arbol de esta configuracion;
+	// verify ademas comprueba los rangos de hijos de todos los nodos
+	bool Open(const char * fileName, bool verify = true)
+	{
+		Close();
+
+		const int fd = ::open(fileName, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(RStarFileHeader))
+		{
+			::close(fd);
+			return false;
+		}
+
+		void * data = mmap(NULL, (std::size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if (data == MAP_FAILED)
+			return false;
+
+		m_data = data;
+		m_length = (std::size_t)st.st_size;
+		m_header = static_cast<const RStarFileHeader*>(data);
+
+		if (!CheckHeader() || (verify && !CheckNodes()))
+		{
+			Close();
+			return false;
+		}
+
+		const char * base = static_cast<const char*>(m_data);
+		m_nodes  = reinterpret_cast<const Node*>(base + m_header->nodeOffset);
+		m_leaves = reinterpret_cast<const Leaf*>(base + m_header->leafOffset);
+
+		return true;
+	}
+
+	void Close()
+	{
+		if (m_data)
+			munmap(m_data, m_length);
+
+		m_data = NULL;
+		m_length = 0;
+		m_header = NULL;
+		m_nodes = NULL;
+		m_leaves = NULL;
+	}
+
+	bool IsOpen() const { return m_data != NULL; }
+
+	std::size_t GetSize() const { return m_header ? (std::size_t)m_header->leafCount : 0; }
+	std::size_t GetDimensions() const { return dimensions; }
+
+	// arreglos del archivo, para recorridos externos como RStarTree::Load;
+	// la raiz es GetNodes()[0] si GetNodeCount() > 0
+	const Node * GetNodes() const { return m_nodes; }
+	const Leaf * GetLeaves() const { return m_leaves; }
+	std::size_t GetNodeCount() const { return m_header ? (std::size_t)m_header->nodeCount : 0; }
+
+	// mismas reglas que RStarTree::Query
+	template <typename Acceptor, typename Visitor>
+	Visitor Query(const Acceptor &accept, Visitor visitor) const
+	{
+		if (m_header && m_header->nodeCount && visitor.ContinueVisiting && accept(&m_nodes[0]))
+			Visit(m_nodes[0], accept, visitor);
+
+		return visitor;
+	}
+
+private:
+
+	RStarMappedTree(const RStarMappedTree &);
+	RStarMappedTree & operator=(const RStarMappedTree &);
+
+	template <typename Acceptor, typename Visitor>
+	void Visit(const Node &node, const Acceptor &accept, Visitor &visitor) const
+	{
+		if (node.hasLeaves)
+		{
+			const Leaf * leaf = m_leaves + node.first;
+			for (uint32_t i = 0; i < node.count && visitor.ContinueVisiting; i++, leaf++)
+				if (accept(leaf))
+					visitor(leaf);
+		}
+		else
+		{
+			const Node * child = m_nodes + node.first;
+			for (uint32_t i = 0; i < node.count && visitor.ContinueVisiting; i++, child++)
+				if (accept(child))
+					Visit(*child, accept, visitor);
+		}
+	}
+
+	bool CheckHeader() const
+	{
+		const RStarFileHeader &h = *m_header;
+
+		if (std::memcmp(h.magic, RSTAR_FILE_MAGIC, sizeof(h.magic)) != 0 ||
+			h.version != RSTAR_FILE_VERSION || h.byteOrder != 0x01020304 ||
+			h.dimensions != dimensions || h.coordSize != sizeof(Coord) ||
+			h.coordKind != RStarFileHeader::CoordKind<Coord>() ||
+			h.nodeSize != sizeof(Node) || h.leafSize != sizeof(Leaf) || h.payloadSize != sizeof(LeafType) ||
+			h.fileSize != m_length)
+			return false;
+
+		if (h.nodeOffset % RSTAR_FILE_ALIGN || h.leafOffset % RSTAR_FILE_ALIGN)
+			return false;
+
+		if (h.nodeOffset > m_length || h.nodeCount > (m_length - h.nodeOffset) / sizeof(Node) ||
+			h.leafOffset > m_length || h.leafCount > (m_length - h.leafOffset) / sizeof(Leaf))
+			return false;
+
+		return h.nodeOffset + h.nodeCount * sizeof(Node) <= h.leafOffset;
+	}
+
+	// en BFS los hijos siempre van despues del padre
+	bool CheckNodes() const
+	{
+		const RStarFileHeader &h = *m_header;
+		const Node * nodes = reinterpret_cast<const Node*>(static_cast<const char*>(m_data) + h.nodeOffset);
+
+		for (uint64_t i = 0; i < h.nodeCount; i++)
+		{
+			const Node &node = nodes[i];
+			const uint64_t limit = node.hasLeaves ? h.leafCount : h.nodeCount;
+
+			if (node.first > limit || node.count > limit - node.first || (!node.hasLeaves && node.first <= i))
+				return false;
+		}
+
+		return true;
+	}
+
+	void * m_data;
+	std::size_t m_length;
+
+	const RStarFileHeader * m_header;
+	const Node * m_nodes;
+	const Leaf * m_leaves;
+};
+
+
+#endif
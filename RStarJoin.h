@@ -0,0 +1,333 @@
+#ifndef RSTARJOIN_H
+#define RSTARJOIN_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include "RStarBoundingBox.h"
+#include "RStarThreadPool.h"
+
+// Join espacial entre dos RStarTree de igual dimension y coordenada: se
+// recorren los dos arboles juntos y solo se baja por pares de nodos que
+// cumplen el predicado. En cada par los hijos de ambos lados se filtran
+// contra el bound del otro nodo y se cruzan con un barrido sobre el eje 0,
+// ordenados por su primer borde. visitor(leafA, leafB) recibe cada par de
+// hojas que cumple el predicado. Los arboles no deben modificarse mientras
+// tanto.
+
+// pares de nodos por worker que arma RStarJoinParallel antes de repartir
+#define RSTAR_JOIN_TASKS_PER_THREAD 8
+
+// Predicados: operator() se usa igual con nodos y con hojas, asi que si dos
+// cajas lo cumplen, cualquier par de cajas que las encierre tambien.
+// Margin() es cuanto pueden separarse en un eje dos cajas que lo cumplen.
+
+template <typename BoundingBox>
+struct RStarJoinOverlapping
+{
+	bool operator()(const BoundingBox &a, const BoundingBox &b) const
+	{
+		return a.overlaps(b);
+	}
+
+	double Margin() const { return 0; }
+};
+
+// distancia euclidea minima entre las cajas <= distance
+template <typename BoundingBox>
+struct RStarJoinWithinDistance
+{
+	const double m_distance;
+	explicit RStarJoinWithinDistance(double distance) : m_distance(distance) {}
+
+	bool operator()(const BoundingBox &a, const BoundingBox &b) const
+	{
+		const std::size_t dimensions = sizeof(a.edges) / sizeof(a.edges[0]);
+		double distance = 0, t;
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			if (b.edges[axis].second < a.edges[axis].first)
+				t = (double)a.edges[axis].first - (double)b.edges[axis].second;
+			else if (a.edges[axis].second < b.edges[axis].first)
+				t = (double)b.edges[axis].first - (double)a.edges[axis].second;
+			else
+				continue;
+
+			distance += t*t;
+			if (distance > m_distance * m_distance)
+				return false;
+		}
+
+		return true;
+	}
+
+	double Margin() const { return m_distance; }
+
+	private: RStarJoinWithinDistance(){}
+};
+
+
+template <typename TreeA, typename TreeB, typename Predicate, typename Visitor>
+class RStarJoiner {
+public:
+
+	typedef typename TreeA::Node	NodeA;
+	typedef typename TreeB::Node	NodeB;
+	typedef typename TreeA::Leaf	LeafA;
+	typedef typename TreeB::Leaf	LeafB;
+	typedef typename TreeA::BoundingBox	BoundingBox;
+
+	static_assert(std::is_same<BoundingBox, typename TreeB::BoundingBox>::value,
+		"RStarJoin: los arboles deben tener la misma dimension y coordenada");
+
+	// un par de nodos por recorrer
+	struct Task {
+		const NodeA * a;
+		const NodeB * b;
+	};
+
+	RStarJoiner(const Predicate &predicate, Visitor &visitor) : m_predicate(predicate), m_visitor(visitor) {}
+
+	void Join(const NodeA * a, const NodeB * b)
+	{
+		if (!m_visitor.ContinueVisiting)
+			return;
+
+		JoinPairs join = { this };
+		Expand(a, b, join);
+	}
+
+	// reemplaza cada par de tasks por sus pares de hijos; los pares de nodos
+	// hoja quedan como estan. false si no habia nada que expandir
+	bool Split(std::vector<Task> &tasks)
+	{
+		std::vector<Task> expanded;
+		bool split = false;
+
+		for (std::size_t t = 0; t < tasks.size(); t++)
+		{
+			if (tasks[t].a->hasLeaves && tasks[t].b->hasLeaves)
+				expanded.push_back(tasks[t]);
+			else
+			{
+				CollectPairs collect = { &expanded };
+				Expand(tasks[t].a, tasks[t].b, collect);
+				split = true;
+			}
+		}
+
+		tasks.swap(expanded);
+		return split;
+	}
+
+private:
+
+	struct Entry {
+		double first, second;
+		std::size_t index;
+		BoundingBox bound;
+
+		bool operator<(const Entry &e) const { return first < e.first; }
+	};
+
+	// hijos de ambos lados que llegan hasta ahi; Expand les pasa pares
+	struct JoinPairs {
+		RStarJoiner * joiner;
+
+		void operator()(const NodeA * a, const NodeB * b) const { joiner->Join(a, b); }
+	};
+
+	struct CollectPairs {
+		std::vector<Task> * tasks;
+
+		void operator()(const NodeA * a, const NodeB * b) const
+		{
+			const Task task = { a, b };
+			tasks->push_back(task);
+		}
+	};
+
+	struct VisitLeaves {
+		RStarJoiner * joiner;
+		const NodeA * a;
+		const NodeB * b;
+
+		void operator()(std::size_t i, std::size_t j) const
+		{
+			joiner->m_visitor(static_cast<const LeafA*>(a->items[i]), static_cast<const LeafB*>(b->items[j]));
+		}
+	};
+
+	template <typename Pairs>
+	struct VisitNodes {
+		const Pairs * pairs;
+		const NodeA * a;
+		const NodeB * b;
+
+		void operator()(std::size_t i, std::size_t j) const
+		{
+			(*pairs)(static_cast<const NodeA*>(a->items[i]), static_cast<const NodeB*>(b->items[j]));
+		}
+	};
+
+	// pares hijo/hijo de (a, b), o nodo/hijo si solo un lado tiene hojas
+	// debajo; con dos nodos hoja, los pares de hojas van al visitor
+	template <typename Pairs>
+	void Expand(const NodeA * a, const NodeB * b, const Pairs &pairs)
+	{
+		if (a->hasLeaves && b->hasLeaves)
+		{
+			VisitLeaves visit = { this, a, b };
+			Sweep(a, b, visit);
+		}
+		else if (a->hasLeaves)
+		{
+			for (std::size_t j = 0; j < b->items.size() && m_visitor.ContinueVisiting; j++)
+				if (m_predicate(a->bound, b->childBounds.get(j)))
+					pairs(a, static_cast<const NodeB*>(b->items[j]));
+		}
+		else if (b->hasLeaves)
+		{
+			for (std::size_t i = 0; i < a->items.size() && m_visitor.ContinueVisiting; i++)
+				if (m_predicate(a->childBounds.get(i), b->bound))
+					pairs(static_cast<const NodeA*>(a->items[i]), b);
+		}
+		else
+		{
+			VisitNodes<Pairs> visit = { &pairs, a, b };
+			Sweep(a, b, visit);
+		}
+	}
+
+	template <typename Node>
+	std::size_t Load(const Node * node, const BoundingBox &other, double margin, bool isA, Entry * entries) const
+	{
+		std::size_t n = 0;
+
+		for (std::size_t i = 0; i < node->items.size(); i++)
+		{
+			Entry &entry = entries[n];
+			entry.bound = node->childBounds.get(i);
+
+			if (!(isA ? m_predicate(entry.bound, other) : m_predicate(other, entry.bound)))
+				continue;
+
+			entry.first  = (double)entry.bound.edges[0].first - margin;
+			entry.second = (double)entry.bound.edges[0].second + margin;
+			entry.index  = i;
+			n++;
+		}
+
+		std::sort(entries, entries + n);
+		return n;
+	}
+
+	// barrido sobre el eje 0: las cajas de a se agrandan en Margin(), asi
+	// que basta con que los intervalos se toquen para probar el par
+	template <typename Pairs>
+	void Sweep(const NodeA * a, const NodeB * b, const Pairs &pairs)
+	{
+		Entry left[NodeA::ChildBounds::stride];
+		Entry right[NodeB::ChildBounds::stride];
+
+		const std::size_t na = Load(a, b->bound, m_predicate.Margin(), true, left);
+		const std::size_t nb = Load(b, a->bound, 0, false, right);
+
+		std::size_t i = 0, j = 0;
+
+		while (i < na && j < nb && m_visitor.ContinueVisiting)
+		{
+			if (left[i].first <= right[j].first)
+			{
+				for (std::size_t k = j; k < nb && right[k].first <= left[i].second && m_visitor.ContinueVisiting; k++)
+					if (m_predicate(left[i].bound, right[k].bound))
+						pairs(left[i].index, right[k].index);
+				i++;
+			}
+			else
+			{
+				for (std::size_t k = i; k < na && left[k].first <= right[j].second && m_visitor.ContinueVisiting; k++)
+					if (m_predicate(left[k].bound, right[j].bound))
+						pairs(left[k].index, right[j].index);
+				j++;
+			}
+		}
+	}
+
+	const Predicate &m_predicate;
+	Visitor &m_visitor;
+};
+
+
+template <typename TreeA, typename TreeB, typename Predicate, typename Visitor>
+Visitor RStarJoin(const TreeA &treeA, const TreeB &treeB, const Predicate &predicate, Visitor visitor)
+{
+	if (treeA.GetRoot() && treeB.GetRoot() && predicate(treeA.GetRoot()->bound, treeB.GetRoot()->bound))
+	{
+		RStarJoiner<TreeA, TreeB, Predicate, Visitor> joiner(predicate, visitor);
+		joiner.Join(treeA.GetRoot(), treeB.GetRoot());
+	}
+
+	return visitor;
+}
+
+template <typename TreeA, typename TreeB, typename Visitor>
+Visitor RStarJoin(const TreeA &treeA, const TreeB &treeB, Visitor visitor)
+{
+	return RStarJoin(treeA, treeB, RStarJoinOverlapping<typename TreeA::BoundingBox>(), visitor);
+}
+
+
+template <typename TreeA, typename TreeB, typename Predicate, typename Visitor>
+struct RStarJoinJob {
+	typedef RStarJoiner<TreeA, TreeB, Predicate, Visitor> Joiner;
+
+	const std::vector<typename Joiner::Task> * tasks;
+	const Predicate * predicate;
+	std::vector<Visitor> * visitors;
+
+	void operator()(std::size_t begin, std::size_t end, unsigned worker) const
+	{
+		Joiner joiner(*predicate, (*visitors)[worker]);
+
+		for (std::size_t t = begin; t < end; t++)
+			joiner.Join((*tasks)[t].a, (*tasks)[t].b);
+	}
+};
+
+// Igual que RStarJoin, repartido en pool: los pares de nodos de arriba se
+// expanden hasta tener unos RSTAR_JOIN_TASKS_PER_THREAD por worker y cada
+// worker recorre los suyos con su copia de visitor. Se devuelve una copia
+// por worker para que el llamador las combine.
+template <typename TreeA, typename TreeB, typename Predicate, typename Visitor>
+std::vector<Visitor> RStarJoinParallel(const TreeA &treeA, const TreeB &treeB, const Predicate &predicate, Visitor visitor,
+	RStarThreadPool &pool = RStarThreadPool::Default())
+{
+	typedef RStarJoiner<TreeA, TreeB, Predicate, Visitor> Joiner;
+
+	std::vector<Visitor> visitors(pool.GetThreadCount(), visitor);
+	std::vector<typename Joiner::Task> tasks;
+
+	if (!treeA.GetRoot() || !treeB.GetRoot() || !predicate(treeA.GetRoot()->bound, treeB.GetRoot()->bound))
+		return visitors;
+
+	const typename Joiner::Task root = { treeA.GetRoot(), treeB.GetRoot() };
+	tasks.push_back(root);
+
+	// Split nunca llega a un par de nodos hoja, asi que no visita nada: su
+	// visitor solo aporta ContinueVisiting
+	Joiner splitter(predicate, visitor);
+	while (tasks.size() < (std::size_t)pool.GetThreadCount() * RSTAR_JOIN_TASKS_PER_THREAD && splitter.Split(tasks))
+		;
+
+	RStarJoinJob<TreeA, TreeB, Predicate, Visitor> job = { &tasks, &predicate, &visitors };
+	pool.ParallelFor(tasks.size(), 1, job);
+
+	return visitors;
+}
+
+
+#endif
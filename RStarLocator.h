@@ -0,0 +1,103 @@
+#ifndef RSTARLOCATOR_H
+#define RSTARLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+// Politica de localizacion de hojas de RStarTree. Con un locator,
+// RemoveItem encuentra las hojas de un item sin recorrer el arbol y baja
+// solo por los nodos que encierran el bound de cada hoja. El arbol llama a
+// Add/Remove cada vez que una hoja aparece, se libera o se reemplaza por una
+// copia (Update con lectores concurrentes), asi que el Leaf* es el vigente.
+//
+// Interfaz: enabled, Add, Remove, Find, Clear, Adopt.
+
+
+// Clave por la que RStarHashLocator indexa un LeafType; se especializa para
+// indexar por un campo (p.ej. un id) en vez del valor completo
+template <typename LeafType>
+struct RStarLocatorKey {
+	typedef LeafType key_type;
+	typedef std::hash<LeafType> hash_type;
+
+	static const key_type & Get(const LeafType &leaf) { return leaf; }
+};
+
+
+// Politica por defecto: sin indice, RemoveItem recorre el arbol
+template <typename LeafType, typename Leaf>
+class RStarNoLocator {
+public:
+
+	static const bool enabled = false;
+
+	void Add(Leaf *) {}
+	void Remove(Leaf *) {}
+	void Find(const LeafType &, std::vector<Leaf*> &) const {}
+	void Clear() {}
+	void Adopt(RStarNoLocator &) {}
+};
+
+
+// Hash de clave a hoja. Varias hojas pueden compartir clave (duplicados, o
+// una clave que no distingue todo el valor): Find devuelve solo las que
+// son == al item, como RStarRemoveSpecificLeaf.
+template <typename LeafType, typename Leaf>
+class RStarHashLocator {
+public:
+
+	typedef RStarLocatorKey<LeafType>		KeyOf;
+	typedef typename KeyOf::key_type		Key;
+
+	static const bool enabled = true;
+
+	void Add(Leaf * leaf)
+	{
+		m_leaves.insert(typename Map::value_type(KeyOf::Get(leaf->leaf), leaf));
+	}
+
+	void Remove(Leaf * leaf)
+	{
+		std::pair<typename Map::iterator, typename Map::iterator> range = m_leaves.equal_range(KeyOf::Get(leaf->leaf));
+
+		for (typename Map::iterator it = range.first; it != range.second; ++it)
+			if (it->second == leaf)
+			{
+				m_leaves.erase(it);
+				return;
+			}
+	}
+
+	void Find(const LeafType &item, std::vector<Leaf*> &leaves) const
+	{
+		std::pair<typename Map::const_iterator, typename Map::const_iterator> range = m_leaves.equal_range(KeyOf::Get(item));
+
+		for (typename Map::const_iterator it = range.first; it != range.second; ++it)
+			if (item == it->second->leaf)
+				leaves.push_back(it->second);
+	}
+
+	void Clear()
+	{
+		m_leaves.clear();
+	}
+
+	// las hojas de other pasan a este indice
+	void Adopt(RStarHashLocator &other)
+	{
+		m_leaves.insert(other.m_leaves.begin(), other.m_leaves.end());
+		other.m_leaves.clear();
+	}
+
+	std::size_t GetSize() const { return m_leaves.size(); }
+
+private:
+	typedef std::unordered_multimap<Key, Leaf*, typename KeyOf::hash_type> Map;
+
+	Map m_leaves;
+};
+
+
+#endif
@@ -0,0 +1,856 @@
+#ifndef RSTARLOG_H
+#define RSTARLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "RStarFile.h"
+
+// Log de cambios de RStarTree y checkpoints para arrancar rapido. Todos los
+// archivos de un indice comparten un prefijo y llevan una generacion:
+//
+//   prefijo.G.ckpt   el arbol al empezar la generacion G (RStarTree::Save)
+//   prefijo.G.log    RStarLogHeader y los cambios de la generacion G
+//
+// Un registro es op, flags, los campos de op copiados byte a byte y un
+// CRC-32 del registro. Al arrancar se carga el checkpoint mas nuevo que se
+// pueda leer y se reaplican los logs desde su generacion; un registro
+// cortado o con CRC malo al final del ultimo log es una escritura que no
+// termino y se descarta.
+
+#define RSTAR_LOG_MAGIC "RSTARLOG"
+#define RSTAR_LOG_VERSION 1
+
+// registros por Commit automatico si no se dice otra cosa
+#define RSTAR_LOG_GROUP_COMMIT 256
+
+// bytes que se leen de una vez al reaplicar un log
+#define RSTAR_LOG_READ_BYTES (1 << 20)
+
+enum RStarLogOp {
+	RSTAR_LOG_INSERT = 1,			// leaf, bound
+	RSTAR_LOG_REMOVE_AREA,			// bound
+	RSTAR_LOG_REMOVE_ITEM,			// leaf, bound; flags = removeDuplicates
+	RSTAR_LOG_REMOVE_ITEM_ANYWHERE,	// leaf; flags = removeDuplicates
+	RSTAR_LOG_UPDATE,				// leaf, oldBound, newBound, slack
+	RSTAR_LOG_CLEAR
+};
+
+struct RStarLogHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;		// 0x01020304 escrito en el orden de la maquina
+
+	uint32_t boundSize;
+	uint32_t coordSize;
+	uint32_t coordKind;		// como RStarFileHeader
+	uint32_t payloadSize;	// sizeof(LeafType)
+	uint64_t generation;
+};
+
+// CRC-32 (polinomio 0xEDB88320, el de zlib)
+inline uint32_t RStarCRC32(const void * data, std::size_t length, uint32_t crc = 0)
+{
+	struct Table {
+		uint32_t entries[256];
+
+		Table()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[i] = c;
+			}
+		}
+	};
+
+	static const Table table;
+
+	const unsigned char * p = static_cast<const unsigned char*>(data);
+	crc = ~crc;
+	for (std::size_t i = 0; i < length; i++)
+		crc = table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+struct RStarLogOptions {
+	// registros por Commit automatico; 0 deja los Commit al llamador
+	std::size_t groupCommit;
+	// registros entre checkpoints automaticos; 0 los desactiva
+	std::size_t checkpointRecords;
+	// fdatasync en cada Commit; sin el, un Commit sobrevive a que muera el
+	// proceso pero no a que se caiga la maquina
+	bool sync;
+
+	RStarLogOptions() : groupCommit(RSTAR_LOG_GROUP_COMMIT), checkpointRecords(0), sync(true) {}
+};
+
+struct RStarLogStats {
+	std::size_t records;		// registros escritos
+	std::size_t commits;
+	std::size_t bytes;
+	std::size_t checkpoints;
+
+	// del ultimo Open: hojas del checkpoint cargado y registros reaplicados
+	std::size_t loadedLeaves;
+	std::size_t replayed;
+
+	RStarLogStats() : records(0), commits(0), bytes(0), checkpoints(0), loadedLeaves(0), replayed(0) {}
+};
+
+
+// Un archivo de log: registros en un buffer que Commit escribe de una vez
+template <typename LeafType, typename BoundingBox>
+class RStarChangeLog {
+public:
+
+	typedef typename BoundingBox::coord_type Coord;
+
+	// un bound va como first y second de cada eje, sin el padding que
+	// pudiera tener BoundingBox
+	enum { bound_size = sizeof(BoundingBox().edges) / sizeof(BoundingBox().edges[0]) * 2 * sizeof(Coord) };
+
+	// op, flags, leaf, dos bounds, slack y CRC
+	enum { max_record = 2 + sizeof(LeafType) + 2 * bound_size + sizeof(Coord) + 4 };
+
+	RStarChangeLog() : m_fd(-1), m_records(0) {}
+
+	~RStarChangeLog()
+	{
+		Close();
+	}
+
+	// archivo nuevo, vacio salvo el header, ya en el disco
+	bool Create(const char * fileName, uint64_t generation)
+	{
+		Close();
+
+		const int fd = ::open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+
+		RStarLogHeader header;
+		FillHeader(header, generation);
+
+		if (!WriteAll(fd, &header, sizeof(header)) || ::fdatasync(fd) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_fd = fd;
+		return true;
+	}
+
+	// Para seguir escribiendo un log ya reaplicado: se corta en length, lo
+	// que devolvio Replay, para descartar un registro a medias
+	bool Append(const char * fileName, uint64_t length)
+	{
+		Close();
+
+		const int fd = ::open(fileName, O_WRONLY);
+		if (fd < 0)
+			return false;
+
+		if (::ftruncate(fd, (off_t)length) != 0 || ::lseek(fd, 0, SEEK_END) < 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_fd = fd;
+		return true;
+	}
+
+	// false si falla el Commit pendiente
+	bool Close()
+	{
+		bool ok = true;
+
+		if (m_fd >= 0)
+		{
+			ok = Commit(true);
+			::close(m_fd);
+		}
+
+		m_fd = -1;
+		m_buffer.clear();
+		m_records = 0;
+		return ok;
+	}
+
+	bool IsOpen() const { return m_fd >= 0; }
+
+	void LogInsert(const LeafType &leaf, const BoundingBox &bound)
+	{
+		Begin(RSTAR_LOG_INSERT, 0);
+		Put(leaf);
+		Put(bound);
+		End();
+	}
+
+	void LogRemoveArea(const BoundingBox &bound)
+	{
+		Begin(RSTAR_LOG_REMOVE_AREA, 0);
+		Put(bound);
+		End();
+	}
+
+	void LogRemoveItem(const LeafType &leaf, const BoundingBox &bound, bool removeDuplicates)
+	{
+		Begin(RSTAR_LOG_REMOVE_ITEM, removeDuplicates);
+		Put(leaf);
+		Put(bound);
+		End();
+	}
+
+	void LogRemoveItem(const LeafType &leaf, bool removeDuplicates)
+	{
+		Begin(RSTAR_LOG_REMOVE_ITEM_ANYWHERE, removeDuplicates);
+		Put(leaf);
+		End();
+	}
+
+	void LogUpdate(const LeafType &leaf, const BoundingBox &oldBound, const BoundingBox &newBound, Coord slack)
+	{
+		Begin(RSTAR_LOG_UPDATE, 0);
+		Put(leaf);
+		Put(oldBound);
+		Put(newBound);
+		Put(slack);
+		End();
+	}
+
+	void LogClear()
+	{
+		Begin(RSTAR_LOG_CLEAR, 0);
+		End();
+	}
+
+	// registros en el buffer, sin escribir
+	std::size_t GetPending() const { return m_records; }
+	std::size_t GetPendingBytes() const { return m_buffer.size(); }
+
+	// Escribe el buffer con un solo write y, con sync, hace fdatasync: todo
+	// lo registrado hasta aqui queda en el log
+	bool Commit(bool sync)
+	{
+		if (m_fd < 0)
+			return false;
+
+		if (m_buffer.empty())
+			return true;
+
+		if (!WriteAll(m_fd, &m_buffer[0], m_buffer.size()) || (sync && ::fdatasync(m_fd) != 0))
+			return false;
+
+		m_buffer.clear();
+		m_records = 0;
+		return true;
+	}
+
+	// Aplica a tree los registros de fileName, que tiene que ser de la
+	// generacion generation. length recibe hasta donde llegan los registros
+	// completos y torn si despues de eso quedo algo. false si el archivo no
+	// se puede leer o no es un log de esta configuracion.
+	template <typename Tree>
+	static bool Replay(const char * fileName, uint64_t generation, Tree &tree, std::size_t &records, uint64_t &length, bool &torn)
+	{
+		records = 0;
+		length = 0;
+		torn = false;
+
+		const int fd = ::open(fileName, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		RStarLogHeader header, expected;
+		FillHeader(expected, generation);
+
+		if (!ReadAll(fd, &header, sizeof(header)) || std::memcmp(&header, &expected, sizeof(header)) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		length = sizeof(header);
+
+		// los registros se leen en bloques; el que queda cortado al final de
+		// un bloque se mueve al principio del siguiente
+		std::vector<char> block(RSTAR_LOG_READ_BYTES + max_record);
+		std::size_t filled = 0;
+		bool end = false, ok = true;
+
+		while (ok && !end)
+		{
+			const ssize_t n = ::read(fd, &block[filled], RSTAR_LOG_READ_BYTES);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+			{
+				ok = false;
+				break;
+			}
+
+			end = n == 0;
+			filled += (std::size_t)n;
+
+			std::size_t at = 0;
+			for (;;)
+			{
+				const std::size_t size = filled - at >= 1 ? RecordSize((unsigned char)block[at]) : 0;
+
+				if (!size || filled - at < size)
+				{
+					// con el archivo terminado, lo que sobra es un registro a medias
+					if (end && filled > at)
+						torn = true;
+					if (filled - at >= 1 && !size)
+						torn = end = true;
+					break;
+				}
+
+				uint32_t crc;
+				std::memcpy(&crc, &block[at + size - 4], 4);
+
+				if (crc != RStarCRC32(&block[at], size - 4))
+				{
+					torn = end = true;
+					break;
+				}
+
+				Apply(&block[at], tree);
+				records++;
+				at += size;
+				length += size;
+			}
+
+			std::memmove(&block[0], &block[at], filled - at);
+			filled -= at;
+		}
+
+		::close(fd);
+		return ok;
+	}
+
+private:
+
+	RStarChangeLog(const RStarChangeLog &);
+	RStarChangeLog & operator=(const RStarChangeLog &);
+
+	static void FillHeader(RStarLogHeader &header, uint64_t generation)
+	{
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, RSTAR_LOG_MAGIC, sizeof(header.magic));
+		header.version     = RSTAR_LOG_VERSION;
+		header.byteOrder   = 0x01020304;
+		header.boundSize   = bound_size;
+		header.coordSize   = sizeof(Coord);
+		header.coordKind   = RStarFileHeader::CoordKind<Coord>();
+		header.payloadSize = sizeof(LeafType);
+		header.generation  = generation;
+	}
+
+	// tamano del registro que empieza con op, CRC incluido; 0 si op no existe
+	static std::size_t RecordSize(unsigned char op)
+	{
+		switch (op)
+		{
+			case RSTAR_LOG_INSERT:				return 2 + sizeof(LeafType) + bound_size + 4;
+			case RSTAR_LOG_REMOVE_AREA:			return 2 + bound_size + 4;
+			case RSTAR_LOG_REMOVE_ITEM:			return 2 + sizeof(LeafType) + bound_size + 4;
+			case RSTAR_LOG_REMOVE_ITEM_ANYWHERE:	return 2 + sizeof(LeafType) + 4;
+			case RSTAR_LOG_UPDATE:				return 2 + sizeof(LeafType) + 2 * bound_size + sizeof(Coord) + 4;
+			case RSTAR_LOG_CLEAR:				return 2 + 4;
+			default:							return 0;
+		}
+	}
+
+	template <typename T>
+	static void Get(const char * &p, T &value)
+	{
+		std::memcpy(&value, p, sizeof(T));
+		p += sizeof(T);
+	}
+
+	static void Get(const char * &p, BoundingBox &bound)
+	{
+		for (std::size_t axis = 0; axis < sizeof(bound.edges) / sizeof(bound.edges[0]); axis++)
+		{
+			Get(p, bound.edges[axis].first);
+			Get(p, bound.edges[axis].second);
+		}
+	}
+
+	// record ya tiene el tamano de su op y el CRC comprobado
+	template <typename Tree>
+	static void Apply(const char * record, Tree &tree)
+	{
+		const unsigned char op = (unsigned char)record[0];
+		const bool flag = record[1] != 0;
+		const char * p = record + 2;
+
+		LeafType leaf;
+		BoundingBox bound, newBound;
+		Coord slack;
+
+		switch (op)
+		{
+			case RSTAR_LOG_INSERT:
+				Get(p, leaf);
+				Get(p, bound);
+				tree.Insert(leaf, bound);
+				break;
+
+			case RSTAR_LOG_REMOVE_AREA:
+				Get(p, bound);
+				tree.RemoveBoundedArea(bound);
+				break;
+
+			case RSTAR_LOG_REMOVE_ITEM:
+				Get(p, leaf);
+				Get(p, bound);
+				tree.RemoveItem(leaf, bound, flag);
+				break;
+
+			case RSTAR_LOG_REMOVE_ITEM_ANYWHERE:
+				Get(p, leaf);
+				tree.RemoveItem(leaf, flag);
+				break;
+
+			case RSTAR_LOG_UPDATE:
+				Get(p, leaf);
+				Get(p, bound);
+				Get(p, newBound);
+				Get(p, slack);
+				tree.Update(leaf, bound, newBound, slack);
+				break;
+
+			case RSTAR_LOG_CLEAR:
+				tree.Clear();
+				break;
+		}
+	}
+
+	void Begin(RStarLogOp op, bool flag)
+	{
+		m_start = m_buffer.size();
+		m_buffer.push_back((char)op);
+		m_buffer.push_back((char)flag);
+	}
+
+	template <typename T>
+	void Put(const T &value)
+	{
+		const char * bytes = reinterpret_cast<const char*>(&value);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	void Put(const BoundingBox &bound)
+	{
+		for (std::size_t axis = 0; axis < sizeof(bound.edges) / sizeof(bound.edges[0]); axis++)
+		{
+			Put(bound.edges[axis].first);
+			Put(bound.edges[axis].second);
+		}
+	}
+
+	void End()
+	{
+		const uint32_t crc = RStarCRC32(&m_buffer[m_start], m_buffer.size() - m_start);
+		Put(crc);
+		m_records++;
+	}
+
+	static bool WriteAll(int fd, const void * data, std::size_t length)
+	{
+		const char * p = static_cast<const char*>(data);
+
+		while (length)
+		{
+			const ssize_t n = ::write(fd, p, length);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+
+			p += n;
+			length -= (std::size_t)n;
+		}
+
+		return true;
+	}
+
+	static bool ReadAll(int fd, void * data, std::size_t length)
+	{
+		char * p = static_cast<char*>(data);
+
+		while (length)
+		{
+			const ssize_t n = ::read(fd, p, length);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+
+			p += n;
+			length -= (std::size_t)n;
+		}
+
+		return true;
+	}
+
+	int m_fd;
+	std::vector<char> m_buffer;
+	std::size_t m_start;
+	std::size_t m_records;
+};
+
+
+// RStarTree con log de cambios. Insert, RemoveBoundedArea, RemoveItem,
+// Update y Clear quedan en el log antes de aplicarse; las consultas van a
+// GetTree(). Un cambio es durable despues del Commit que lo escribe, que
+// se hace solo cada options.groupCommit registros: el llamador decide
+// cuantos cambios arriesga por cada fdatasync. Remove con Acceptors
+// arbitrarios no se puede registrar: hay que usar las variantes de arriba.
+// LeafType tiene que ser trivialmente copiable, como para Save. Un solo
+// escritor.
+template <typename Tree>
+class RStarLoggedTree {
+public:
+
+	typedef typename Tree::BoundingBox			BoundingBox;
+	typedef typename Tree::Leaf::leaf_type		LeafType;
+	typedef typename BoundingBox::coord_type	Coord;
+	typedef RStarChangeLog<LeafType, BoundingBox>	ChangeLog;
+
+	static_assert(std::is_trivially_copyable<LeafType>::value, "RStarLoggedTree requiere un LeafType trivialmente copiable");
+
+	RStarLoggedTree() : m_generation(0), m_sinceCheckpoint(0) {}
+
+	~RStarLoggedTree()
+	{
+		Close();
+	}
+
+	// Carga el checkpoint mas nuevo de prefix y reaplica los logs que le
+	// siguen; sin archivos, empieza un indice vacio. false si falta un log
+	// de la secuencia o uno que no es el ultimo esta danado.
+	bool Open(const char * prefix, const RStarLogOptions &options = RStarLogOptions())
+	{
+		Close();
+
+		m_prefix = prefix;
+		m_options = options;
+		m_stats = RStarLogStats();
+		m_sinceCheckpoint = 0;
+
+		std::vector<uint64_t> checkpoints, logs;
+		if (!Scan(checkpoints, logs))
+			return false;
+
+		if (checkpoints.empty() && logs.empty())
+		{
+			m_tree.Clear();
+			m_generation = 1;
+			return m_log.Create(FileName(1, "log").c_str(), 1) && SaveCheckpoint(1);
+		}
+
+		// el checkpoint mas nuevo que se pueda leer; sin ninguno se parte
+		// de un arbol vacio y de todos los logs
+		uint64_t base = 0;
+		for (std::size_t i = checkpoints.size(); i-- > 0 && !base; )
+			if (m_tree.Load(FileName(checkpoints[i], "ckpt").c_str()))
+				base = checkpoints[i];
+
+		// el log 1 empieza con el arbol vacio
+		if (!base)
+		{
+			if (logs.empty() || logs[0] != 1)
+				return false;
+			m_tree.Clear();
+		}
+
+		m_stats.loadedLeaves = m_tree.GetSize();
+
+		std::vector<uint64_t>::iterator first = std::lower_bound(logs.begin(), logs.end(), base);
+		if (first != logs.end() && base && *first != base)
+			return false;
+
+		m_generation = base ? base : (first != logs.end() ? *first : 1);
+		uint64_t length = 0;
+		bool torn = false;
+
+		for (std::vector<uint64_t>::iterator it = first; it != logs.end(); ++it)
+		{
+			// las generaciones van seguidas
+			if (*it != m_generation + (it != first))
+				return false;
+
+			std::size_t records;
+			if (!ChangeLog::Replay(FileName(*it, "log").c_str(), *it, m_tree, records, length, torn))
+				return false;
+
+			// solo el ultimo log puede terminar en un registro a medias
+			if (torn && it + 1 != logs.end())
+				return false;
+
+			m_stats.replayed += records;
+			m_sinceCheckpoint += records;
+			m_generation = *it;
+		}
+
+		if (first == logs.end())
+			return m_log.Create(FileName(m_generation, "log").c_str(), m_generation);
+
+		return m_log.Append(FileName(m_generation, "log").c_str(), length);
+	}
+
+	// Commit de lo pendiente
+	bool Close()
+	{
+		const bool ok = !m_log.IsOpen() || m_log.Close();
+		m_tree.Clear();
+		return ok;
+	}
+
+	bool IsOpen() const { return m_log.IsOpen(); }
+
+	bool Insert(const LeafType &leaf, const BoundingBox &bound)
+	{
+		m_log.LogInsert(leaf, bound);
+		m_tree.Insert(leaf, bound);
+		return Logged();
+	}
+
+	bool RemoveBoundedArea(const BoundingBox &bound)
+	{
+		m_log.LogRemoveArea(bound);
+		m_tree.RemoveBoundedArea(bound);
+		return Logged();
+	}
+
+	bool RemoveItem(const LeafType &leaf, const BoundingBox &bound, bool removeDuplicates = true)
+	{
+		m_log.LogRemoveItem(leaf, bound, removeDuplicates);
+		m_tree.RemoveItem(leaf, bound, removeDuplicates);
+		return Logged();
+	}
+
+	bool RemoveItem(const LeafType &leaf, bool removeDuplicates = true)
+	{
+		m_log.LogRemoveItem(leaf, removeDuplicates);
+		m_tree.RemoveItem(leaf, removeDuplicates);
+		return Logged();
+	}
+
+	// el resultado de Tree::Update; tambien false si fallo el log
+	bool Update(const LeafType &leaf, const BoundingBox &oldBound, const BoundingBox &newBound, Coord slack = 0)
+	{
+		m_log.LogUpdate(leaf, oldBound, newBound, slack);
+		const bool found = m_tree.Update(leaf, oldBound, newBound, slack);
+		return Logged() && found;
+	}
+
+	bool Clear()
+	{
+		m_log.LogClear();
+		m_tree.Clear();
+		return Logged();
+	}
+
+	// escribe y sincroniza los registros pendientes
+	bool Commit()
+	{
+		if (!m_log.GetPending())
+			return true;
+
+		const std::size_t bytes = m_log.GetPendingBytes();
+		if (!m_log.Commit(m_options.sync))
+			return false;
+
+		m_stats.commits++;
+		m_stats.bytes += bytes;
+		return true;
+	}
+
+	// Checkpoint: Commit, se empieza la generacion siguiente con un log
+	// vacio, se guarda el arbol como su checkpoint y se borran los archivos
+	// de las generaciones anteriores. Si algo falla a mitad, lo anterior
+	// sigue en el disco y Open lo usa.
+	bool Checkpoint()
+	{
+		if (!Commit())
+			return false;
+
+		const uint64_t generation = m_generation + 1;
+		if (!m_log.Create(FileName(generation, "log").c_str(), generation))
+			return false;
+
+		m_generation = generation;
+		m_sinceCheckpoint = 0;
+
+		if (!SaveCheckpoint(generation))
+			return false;
+
+		std::vector<uint64_t> checkpoints, logs;
+		if (Scan(checkpoints, logs))
+		{
+			for (std::size_t i = 0; i < checkpoints.size() && checkpoints[i] < generation; i++)
+				std::remove(FileName(checkpoints[i], "ckpt").c_str());
+			for (std::size_t i = 0; i < logs.size() && logs[i] < generation; i++)
+				std::remove(FileName(logs[i], "log").c_str());
+		}
+
+		return true;
+	}
+
+	// para consultas; lo que se cambie por aqui no queda en el log
+	Tree & GetTree() { return m_tree; }
+	const Tree & GetTree() const { return m_tree; }
+
+	std::size_t GetSize() const { return m_tree.GetSize(); }
+	uint64_t GetGeneration() const { return m_generation; }
+	const RStarLogStats & GetStats() const { return m_stats; }
+
+	// borra todos los archivos de prefix
+	static bool Destroy(const char * prefix)
+	{
+		RStarLoggedTree files;
+		files.m_prefix = prefix;
+
+		std::vector<uint64_t> checkpoints, logs;
+		if (!files.Scan(checkpoints, logs))
+			return false;
+
+		bool ok = true;
+		for (std::size_t i = 0; i < checkpoints.size(); i++)
+			ok = std::remove(files.FileName(checkpoints[i], "ckpt").c_str()) == 0 && ok;
+		for (std::size_t i = 0; i < logs.size(); i++)
+			ok = std::remove(files.FileName(logs[i], "log").c_str()) == 0 && ok;
+
+		return ok;
+	}
+
+private:
+
+	RStarLoggedTree(const RStarLoggedTree &);
+	RStarLoggedTree & operator=(const RStarLoggedTree &);
+
+	// contabiliza el ultimo registro y hace los Commit y checkpoints
+	// automaticos
+	bool Logged()
+	{
+		m_stats.records++;
+		m_sinceCheckpoint++;
+
+		if (m_options.checkpointRecords && m_sinceCheckpoint >= m_options.checkpointRecords)
+			return Checkpoint();
+
+		if (m_options.groupCommit && m_log.GetPending() >= m_options.groupCommit)
+			return Commit();
+
+		return true;
+	}
+
+	std::string FileName(uint64_t generation, const char * extension) const
+	{
+		char suffix[48];
+		std::snprintf(suffix, sizeof(suffix), ".%llu.%s", (unsigned long long)generation, extension);
+		return m_prefix + suffix;
+	}
+
+	// Save escribe a un temporal y renombra; ademas se sincronizan el
+	// archivo y el directorio antes de que Checkpoint borre lo anterior
+	bool SaveCheckpoint(uint64_t generation)
+	{
+		const std::string name = FileName(generation, "ckpt");
+		if (!m_tree.Save(name.c_str()) || !SyncPath(name.c_str()) || !SyncPath(Directory().c_str()))
+			return false;
+
+		m_stats.checkpoints++;
+		return true;
+	}
+
+	static bool SyncPath(const char * path)
+	{
+		const int fd = ::open(path, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		const bool ok = ::fsync(fd) == 0;
+		::close(fd);
+		return ok;
+	}
+
+	std::string Directory() const
+	{
+		const std::string::size_type slash = m_prefix.rfind('/');
+		return slash == std::string::npos ? "." : (slash == 0 ? "/" : m_prefix.substr(0, slash));
+	}
+
+	// generaciones de los archivos de m_prefix, en orden creciente
+	bool Scan(std::vector<uint64_t> &checkpoints, std::vector<uint64_t> &logs) const
+	{
+		const std::string::size_type slash = m_prefix.rfind('/');
+		const std::string base = slash == std::string::npos ? m_prefix : m_prefix.substr(slash + 1);
+
+		DIR * dir = ::opendir(Directory().c_str());
+		if (!dir)
+			return false;
+
+		while (struct dirent * entry = ::readdir(dir))
+		{
+			const std::string name = entry->d_name;
+			if (name.size() <= base.size() + 1 || name.compare(0, base.size(), base) != 0 || name[base.size()] != '.')
+				continue;
+
+			const char * digits = name.c_str() + base.size() + 1;
+			char * end;
+			const unsigned long long generation = std::strtoull(digits, &end, 10);
+
+			if (end == digits || generation == 0)
+				continue;
+
+			if (std::strcmp(end, ".ckpt") == 0)
+				checkpoints.push_back(generation);
+			else if (std::strcmp(end, ".log") == 0)
+				logs.push_back(generation);
+		}
+
+		::closedir(dir);
+
+		std::sort(checkpoints.begin(), checkpoints.end());
+		std::sort(logs.begin(), logs.end());
+		return true;
+	}
+
+	Tree m_tree;
+	ChangeLog m_log;
+
+	std::string m_prefix;
+	RStarLogOptions m_options;
+	RStarLogStats m_stats;
+
+	uint64_t m_generation;
+	std::size_t m_sinceCheckpoint;
+};
+
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef RSTARNEAREST_H
+#define RSTARNEAREST_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// Memoria de trabajo de RStarTree::QueryNearest. Se puede reutilizar entre
+// consultas para no reservar memoria en cada una.
+template <typename BoundedItem>
+struct RStarNearestBuffer {
+
+	struct Entry {
+		double distance;
+		const BoundedItem * item;
+		bool isLeaf;
+	};
+
+	// cola de prioridad por MINDIST (min-heap)
+	std::vector<Entry> queue;
+
+	// k menores distancias de hojas encoladas (max-heap)
+	std::vector<double> best;
+
+	void clear()
+	{
+		queue.clear();
+		best.clear();
+	}
+
+	void push(double distance, const BoundedItem * item, bool isLeaf)
+	{
+		Entry e = { distance, item, isLeaf };
+		queue.push_back(e);
+		std::push_heap(queue.begin(), queue.end(), CompareEntries);
+	}
+
+	Entry pop()
+	{
+		std::pop_heap(queue.begin(), queue.end(), CompareEntries);
+		Entry e = queue.back();
+		queue.pop_back();
+		return e;
+	}
+
+	// registra la distancia de una hoja; devuelve la k-esima menor distancia
+	// conocida, o max() si aun no hay k
+	double addCandidate(double distance, std::size_t k)
+	{
+		if (best.size() < k)
+		{
+			best.push_back(distance);
+			std::push_heap(best.begin(), best.end());
+		}
+		else if (distance < best.front())
+		{
+			std::pop_heap(best.begin(), best.end());
+			best.back() = distance;
+			std::push_heap(best.begin(), best.end());
+		}
+
+		return best.size() < k ? std::numeric_limits<double>::max() : best.front();
+	}
+
+	static bool CompareEntries(const Entry &a, const Entry &b)
+	{
+		return a.distance > b.distance;
+	}
+};
+
+
+#endif
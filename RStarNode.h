@@ -0,0 +1,280 @@
+#ifndef RSTARNODE_H
+#define RSTARNODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <cassert>
+
+#include "RStarBoundingBox.h"
+#include "RStarAggregate.h"
+
+// Arreglo de capacidad fija con la interfaz de std::vector que usa el arbol.
+// Vive dentro del nodo, sin buffer aparte en el heap.
+template <typename T, std::size_t capacity>
+struct RStarNodeItems {
+
+	typedef T * iterator;
+	typedef const T * const_iterator;
+
+	RStarNodeItems() : m_size(0) {}
+
+	iterator begin() { return m_items; }
+	iterator end() { return m_items + m_size; }
+	const_iterator begin() const { return m_items; }
+	const_iterator end() const { return m_items + m_size; }
+
+	std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	void reserve(std::size_t) {}
+	void clear() { m_size = 0; }
+
+	T & operator[](std::size_t i) { return m_items[i]; }
+	const T & operator[](std::size_t i) const { return m_items[i]; }
+	T & back() { return m_items[m_size-1]; }
+
+	void push_back(const T &item)
+	{
+		assert(m_size < capacity);
+		m_items[m_size++] = item;
+	}
+
+	template <typename Iterator>
+	void assign(Iterator first, Iterator last)
+	{
+		m_size = 0;
+		for (; first != last; ++first)
+			push_back(*first);
+	}
+
+	iterator erase(iterator first, iterator last)
+	{
+		iterator out = first;
+		for (iterator it = last; it != end(); ++it)
+			*out++ = *it;
+
+		m_size -= last - first;
+		return first;
+	}
+
+	iterator erase(iterator it) { return erase(it, it + 1); }
+
+private:
+	T m_items[capacity];
+	std::size_t m_size;
+};
+
+
+// Copia de los bounds de los hijos como structure-of-arrays: todos los
+// first del eje 0, todos los second del eje 0, ... Los recorridos prueban
+// los hijos sin seguir punteros. El padding se llena con cajas vacias.
+template <std::size_t dimensions, std::size_t capacity, typename Coord>
+struct RStarChildBounds {
+
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
+
+	enum { stride = (capacity + 15) & ~(std::size_t)15 };
+
+	Coord first[dimensions][stride];
+	Coord second[dimensions][stride];
+
+	void set(std::size_t i, const BoundingBox &bound)
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			first[axis][i]  = bound.edges[axis].first;
+			second[axis][i] = bound.edges[axis].second;
+		}
+	}
+
+	void reset(std::size_t i)
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			first[axis][i]  = std::numeric_limits<Coord>::max();
+			second[axis][i] = std::numeric_limits<Coord>::lowest();
+		}
+	}
+
+	BoundingBox get(std::size_t i) const
+	{
+		BoundingBox bound;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			bound.edges[axis].first  = first[axis][i];
+			bound.edges[axis].second = second[axis][i];
+		}
+		return bound;
+	}
+
+	// mismas comparaciones que RStarBoundingBox::overlaps / encloses; encloses
+	// es el hijo i encerrando a bound, enclosedBy al reves
+	bool overlaps(std::size_t i, const BoundingBox &bound) const
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			if (!(bound.edges[axis].first < second[axis][i]) || !(first[axis][i] < bound.edges[axis].second))
+				return false;
+
+		return true;
+	}
+
+	bool enclosedBy(std::size_t i, const BoundingBox &bound) const
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			if (first[axis][i] < bound.edges[axis].first || bound.edges[axis].second < second[axis][i])
+				return false;
+
+		return true;
+	}
+
+	bool encloses(std::size_t i, const BoundingBox &bound) const
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			if (bound.edges[axis].first < first[axis][i] || second[axis][i] < bound.edges[axis].second)
+				return false;
+
+		return true;
+	}
+};
+
+
+// Un bit por hijo que paso el filtro de un Acceptor
+template <std::size_t capacity>
+struct RStarHitMask {
+
+	enum { word_count = (capacity + 63) / 64 };
+
+	uint64_t words[word_count];
+
+	void clear()
+	{
+		for (std::size_t w = 0; w < word_count; w++)
+			words[w] = 0;
+	}
+
+	void set(std::size_t i)
+	{
+		words[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+
+	// recorre los bits encendidos: for (i = next(0); i < capacity; i = next(i+1))
+	std::size_t next(std::size_t i) const
+	{
+		for (std::size_t w = i / 64; w < word_count; w++)
+		{
+			uint64_t bits = words[w];
+			if (w == i / 64)
+				bits &= ~(uint64_t)0 << (i % 64);
+
+			if (bits)
+				return w * 64 + LowestBit(bits);
+		}
+
+		return capacity;
+	}
+
+	// bits encendidos
+	std::size_t count() const
+	{
+		std::size_t n = 0;
+		for (std::size_t w = 0; w < word_count; w++)
+		{
+#if defined(__GNUC__)
+			n += __builtin_popcountll(words[w]);
+#else
+			for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+				n++;
+#endif
+		}
+		return n;
+	}
+
+	static std::size_t LowestBit(uint64_t bits)
+	{
+#if defined(__GNUC__)
+		return __builtin_ctzll(bits);
+#else
+		std::size_t i = 0;
+		while (!(bits & 1)) { bits >>= 1; i++; }
+		return i;
+#endif
+	}
+};
+
+
+template <typename BoundedItem, typename LeafType>
+struct RStarLeaf : BoundedItem {
+
+	typedef LeafType leaf_type;
+	LeafType leaf;
+};
+
+// capacity = max_child_items + 1: el hijo extra antes de un split o reinsert.
+// AggregateValue es el value_type de la politica de RStarAggregate.h
+template <typename BoundedItem, std::size_t dimensions, std::size_t capacity,
+	typename AggregateValue = RStarNoAggregate::value_type>
+struct RStarNode : BoundedItem {
+
+	typedef RStarNodeItems<BoundedItem*, capacity>		Items;
+	typedef RStarChildBounds<dimensions, capacity, typename BoundedItem::BoundingBox::coord_type>	ChildBounds;
+	typedef RStarHitMask<capacity>						HitMask;
+
+	// para las politicas de RStarStrategy.h
+	typedef BoundedItem item_type;
+	enum { node_capacity = capacity, node_dimensions = dimensions };
+
+	Items items;
+	ChildBounds childBounds;
+	bool hasLeaves;
+
+	// agregado de las hojas del subarbol
+	AggregateValue aggregate;
+
+	// version de escritura en que se creo; con lectores concurrentes el
+	// arbol solo modifica en sitio los nodos de la version en curso
+	unsigned long version;
+
+	// solo el hijo i
+	void SyncChild(std::size_t i)
+	{
+		childBounds.set(i, items[i]->bound);
+	}
+
+	// child estaba en la posicion i; si se movio, se copian todos
+	void SyncChild(const BoundedItem * child, std::size_t i)
+	{
+		if (i < items.size() && items[i] == child)
+			SyncChild(i);
+		else
+			Sync();
+	}
+
+	// copia los bounds de items a childBounds; se llama despues de cada
+	// cambio en los hijos o en sus bounds
+	void Sync()
+	{
+		std::size_t i = 0;
+		for (; i < items.size(); i++)
+			childBounds.set(i, items[i]->bound);
+
+		for (; i < (std::size_t)ChildBounds::stride; i++)
+			childBounds.reset(i);
+	}
+};
+
+
+// Tamano de nodo a partir de un tamano objetivo en bytes (p.ej. 4096):
+// cada hijo ocupa un puntero y 2*dimensions coordenadas.
+template <std::size_t dimensions, std::size_t node_bytes, typename Coord = int>
+struct RStarFanout {
+	enum {
+		child_bytes = sizeof(void*) + 2 * dimensions * sizeof(Coord),
+		slots = ((node_bytes - 64) / child_bytes) & ~(std::size_t)15,
+		max_child_items = slots - 1,
+		// 40% del maximo, como en el paper del R*
+		min_child_items = max_child_items * 2 / 5
+	};
+};
+
+
+#endif
@@ -0,0 +1,948 @@
+#ifndef RSTARPAGEDTREE_H
+#define RSTARPAGEDTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "RStarBoundingBox.h"
+#include "RStarNode.h"
+#include "RStarStrategy.h"
+#include "RStarFile.h"
+#include "RStarVisitor.h"
+#include "RStarBufferPool.h"
+
+// Formato del archivo de RStarPagedTree: paginas de page_size bytes. La 0
+// es RStarPagedHeader; las demas son nodos, RStarPage<...>, o paginas
+// libres encadenadas desde freeHead. Un nodo de nivel 0 guarda sus hojas
+// dentro de la pagina; los de arriba guardan (bound, pagina) de sus hijos.
+
+#define RSTAR_PAGED_MAGIC "RSTARPAG"
+#define RSTAR_PAGED_VERSION 1
+
+// frames del pool si no se dice otra cosa
+#define RSTAR_PAGED_DEFAULT_FRAMES 1024
+
+// Insert y Remove mantienen fijado el camino desde la raiz, asi que el pool
+// nunca baja de esto
+#define RSTAR_PAGED_MIN_FRAMES 32
+
+// candidatos que ChooseSubtree mira por overlap, como choose_subtree_p de R*
+#define RSTAR_PAGED_CHOOSE_P 32
+
+// level de una pagina libre
+#define RSTAR_PAGE_FREE 0xFFFFFFFFu
+
+struct RStarPagedHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;		// 0x01020304 escrito en el orden de la maquina
+
+	uint32_t dimensions;
+	uint32_t coordSize;
+	uint32_t coordKind;		// como RStarFileHeader
+	uint32_t pageSize;
+	uint32_t payloadSize;	// sizeof(LeafType)
+	uint32_t minItems;
+	uint32_t maxItems;
+	uint32_t height;		// niveles de nodos, 0 si esta vacio
+
+	uint64_t root;			// 0 si esta vacio
+	uint64_t size;
+	uint64_t pageCount;
+	uint64_t freeHead;		// 0 si no hay paginas libres
+};
+
+// hijo de un nodo interno; tiene bound como un nodo, para los Acceptors
+template <std::size_t dimensions, typename Coord>
+struct RStarPageBranch {
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
+
+	BoundingBox bound;
+	uint64_t page;
+};
+
+template <typename Entry, std::size_t capacity>
+struct RStarPage {
+	uint32_t count;
+	uint32_t level;			// 0: entries son hojas
+	Entry entries[capacity];
+};
+
+struct RStarFreePage {
+	uint32_t count;
+	uint32_t level;			// RSTAR_PAGE_FREE
+	uint64_t next;
+};
+
+// max_child_items que llena una pagina de page_bytes
+template <typename LeafType, std::size_t dimensions, typename Coord = int, std::size_t page_bytes = RSTAR_PAGE_ALIGN>
+struct RStarPagedCapacity {
+	enum {
+		branch_size = sizeof(RStarPageBranch<dimensions, Coord>),
+		leaf_size   = sizeof(RStarFileLeaf<dimensions, Coord, LeafType>),
+		value = (page_bytes - 16) / (branch_size > leaf_size ? branch_size : leaf_size)
+	};
+};
+
+// Los max_child_items+1 hijos de un nodo desbordado, con la interfaz de
+// nodo que usan Split y Reinsert de las politicas de RStarStrategy.h
+template <typename Entry, std::size_t dimensions, std::size_t capacity>
+struct RStarPageOverflow {
+	typedef typename Entry::BoundingBox	BoundingBox;
+	typedef Entry						item_type;
+	enum { node_capacity = capacity, node_dimensions = dimensions };
+
+	RStarNodeItems<Entry*, capacity> items;
+	BoundingBox bound;
+};
+
+
+// R*-tree en disco: cada nodo es una pagina del archivo y los hijos se
+// referencian por numero de pagina. Insert, Remove y Query leen las paginas
+// a traves de un RStarBufferPool de tamano fijo, asi que el arbol puede ser
+// mucho mas grande que la memoria y cada consulta cuesta a lo sumo una
+// lectura por nodo visitado. LeafType se guarda byte a byte: tiene que ser
+// trivialmente copiable.
+//
+// Strategy decide Split y Reinsert como en RStarTree; ChooseSubtree es el
+// de R*. Las reinserciones forzadas se hacen al terminar de ajustar el
+// camino, no en medio. Los Acceptors y visitors reciben Branch y Leaf
+// (RStarFileLeaf, como RStarMappedTree); un Leaf solo es valido durante la
+// llamada. Sin WAL: lo que no se escribio con Flush o Close se pierde si
+// el proceso muere, y el archivo puede quedar inconsistente. Un solo hilo.
+template <
+	typename LeafType,
+	std::size_t dimensions, std::size_t min_child_items, std::size_t max_child_items,
+	typename Coord = int,
+	typename Replacement = RStarClockReplacement,
+	typename Strategy = RStarStrategyRStar<>
+>
+class RStarPagedTree {
+public:
+
+	typedef RStarPageBranch<dimensions, Coord>			Branch;
+	typedef RStarFileLeaf<dimensions, Coord, LeafType>	Leaf;
+	typedef typename Branch::BoundingBox				BoundingBox;
+
+	typedef RStarPage<Branch, max_child_items>	BranchPage;
+	typedef RStarPage<Leaf, max_child_items>	LeafPage;
+	typedef RStarBufferPool<Replacement>		Pool;
+
+	typedef RStarAcceptOverlapping<Branch, Leaf>	AcceptOverlapping;
+	typedef RStarAcceptEnclosing<Branch, Leaf>		AcceptEnclosing;
+	typedef RStarAcceptAny<Branch, Leaf>			AcceptAny;
+	typedef RStarAcceptContaining<Branch, Leaf>		AcceptContaining;
+
+	typedef RStarRemoveLeaf<Leaf>				RemoveLeaf;
+	typedef RStarRemoveSpecificLeaf<Leaf>		RemoveSpecificLeaf;
+
+	static const std::size_t page_size =
+		((sizeof(BranchPage) > sizeof(LeafPage) ? sizeof(BranchPage) : sizeof(LeafPage)) + RSTAR_PAGE_ALIGN - 1) / RSTAR_PAGE_ALIGN * RSTAR_PAGE_ALIGN;
+
+	static_assert(std::is_trivially_copyable<LeafType>::value, "RStarPagedTree requiere un LeafType trivialmente copiable");
+	static_assert(std::is_trivially_copyable<BranchPage>::value && std::is_trivially_copyable<LeafPage>::value,
+		"RStarPagedTree: las paginas se leen del pool sin copiarlas");
+	static_assert(2 <= min_child_items && min_child_items <= max_child_items / 2, "RStarPagedTree: min_child_items fuera de rango");
+	static_assert(sizeof(RStarPagedHeader) <= page_size, "RStarPagedTree: el header no entra en una pagina");
+
+	RStarPagedTree() : m_root(0), m_height(0), m_size(0), m_pageCount(0), m_freeHead(0), m_failed(false)
+	{
+		m_bound.reset();
+	}
+
+	~RStarPagedTree()
+	{
+		Close();
+	}
+
+	// Abre fileName o lo crea vacio si no existe, tiene 0 bytes o truncate.
+	// false si no se puede abrir o es un arbol de otra configuracion.
+	bool Open(const char * fileName, std::size_t frames = RSTAR_PAGED_DEFAULT_FRAMES, bool truncate = false)
+	{
+		Close();
+
+		if (!m_pool.Open(fileName, page_size, std::max<std::size_t>(frames, RSTAR_PAGED_MIN_FRAMES), truncate))
+			return false;
+
+		m_failed = false;
+
+		if (m_pool.GetFileSize() == 0)
+		{
+			m_root = 0;
+			m_height = 0;
+			m_size = 0;
+			m_pageCount = 1;
+			m_freeHead = 0;
+			m_bound.reset();
+
+			if (WriteHeader())
+				return true;
+		}
+		else if (ReadHeader())
+			return true;
+
+		m_pool.Close();
+		return false;
+	}
+
+	// Flush y cierra; false si algo no se pudo escribir
+	bool Close()
+	{
+		if (!m_pool.IsOpen())
+			return true;
+
+		const bool ok = Flush();
+		m_pool.Close();
+
+		m_root = 0;
+		m_height = 0;
+		m_size = 0;
+		m_bound.reset();
+		return ok;
+	}
+
+	bool IsOpen() const { return m_pool.IsOpen(); }
+
+	// Una lectura o escritura fallo: el arbol ya no se modifica ni se
+	// consulta hasta volver a abrirlo
+	bool HasFailed() const { return m_failed; }
+
+	// escribe el header y las paginas sucias y hace fdatasync
+	bool Flush()
+	{
+		if (!m_pool.IsOpen() || m_failed)
+			return false;
+
+		return WriteHeader() && m_pool.Sync();
+	}
+
+	bool Insert(const LeafType &leaf, const BoundingBox &bound)
+	{
+		if (!Writable())
+			return false;
+
+		Leaf entry;
+		entry.bound = bound;
+		entry.leaf  = leaf;
+
+		if (!InsertLeaf(entry))
+			return false;
+
+		m_size++;
+		return true;
+	}
+
+	// Mismas reglas que RStarTree::Remove: se sacan las hojas que accept
+	// acepta y leafRemover confirma; los nodos que quedan por debajo de
+	// min_child_items se liberan y sus hojas se reinsertan
+	template <typename Acceptor, typename LeafRemover>
+	bool Remove(const Acceptor &accept, LeafRemover leafRemover)
+	{
+		if (!Writable())
+			return false;
+
+		if (!m_root)
+			return true;
+
+		Branch root;
+		root.bound = m_bound;
+		root.page  = m_root;
+
+		if (!accept(&root))
+			return true;
+
+		RemoveOutcome out;
+		if (!RemoveAt(m_root, accept, leafRemover, true, out))
+			return false;
+
+		if (out.changed && !Condense(out))
+			return false;
+
+		std::vector<Leaf> orphans;
+		orphans.swap(m_orphans);
+
+		for (std::size_t i = 0; i < orphans.size(); i++)
+			if (!InsertLeaf(orphans[i]))
+				return false;
+
+		return true;
+	}
+
+	bool RemoveBoundedArea(const BoundingBox &bound)
+	{
+		return Remove(AcceptEnclosing(bound), RemoveLeaf());
+	}
+
+	// recorre todo el arbol
+	bool RemoveItem(const LeafType &item, bool removeDuplicates = true)
+	{
+		return Remove(AcceptAny(), RemoveSpecificLeaf(item, removeDuplicates));
+	}
+
+	// bound tiene que ser el que se uso en Insert
+	bool RemoveItem(const LeafType &item, const BoundingBox &bound, bool removeDuplicates = true)
+	{
+		return Remove(AcceptContaining(bound), RemoveSpecificLeaf(item, removeDuplicates));
+	}
+
+	// mismas reglas que RStarTree::Query
+	template <typename Acceptor, typename Visitor>
+	Visitor Query(const Acceptor &accept, Visitor visitor)
+	{
+		if (!m_root || m_failed || !visitor.ContinueVisiting)
+			return visitor;
+
+		Branch root;
+		root.bound = m_bound;
+		root.page  = m_root;
+
+		if (accept(&root))
+			Visit(m_root, accept, visitor);
+
+		return visitor;
+	}
+
+	std::size_t GetSize() const { return (std::size_t)m_size; }
+	std::size_t GetDimensions() const { return dimensions; }
+	std::size_t GetHeight() const { return m_height; }
+
+	// paginas del archivo, incluidos el header y las libres
+	uint64_t GetPageCount() const { return m_pageCount; }
+
+	// Cambia los frames del pool; el contenido del pool se escribe y se
+	// descarta
+	bool SetPoolSize(std::size_t frames)
+	{
+		return m_pool.Resize(std::max<std::size_t>(frames, RSTAR_PAGED_MIN_FRAMES));
+	}
+
+	std::size_t GetPoolSize() const { return m_pool.GetFrameCount(); }
+
+	// hits y misses del pool; la diferencia entre dos lecturas da las de
+	// una consulta
+	const RStarBufferStats & GetBufferStats() const { return m_pool.GetStats(); }
+	void ResetBufferStats() { m_pool.ResetStats(); }
+
+private:
+
+	RStarPagedTree(const RStarPagedTree &);
+	RStarPagedTree & operator=(const RStarPagedTree &);
+
+	// pagina fijada mientras vive; dirty se pasa al Unpin
+	struct PageRef {
+		Pool * pool;
+		std::size_t frame;
+		bool dirty;
+
+		PageRef() : pool(NULL), frame(Pool::npos), dirty(false) {}
+		~PageRef() { Release(); }
+
+		void Release()
+		{
+			if (frame != Pool::npos)
+				pool->Unpin(frame, dirty);
+
+			frame = Pool::npos;
+			dirty = false;
+		}
+
+		template <typename Page>
+		Page * As() const { return reinterpret_cast<Page*>(pool->Data(frame)); }
+
+	private:
+		PageRef(const PageRef &);
+		PageRef & operator=(const PageRef &);
+	};
+
+	// como quedo una pagina despues de insertar debajo: su bound y, si se
+	// partio, la rama de la pagina nueva
+	struct InsertOutcome {
+		BoundingBox bound;
+		bool split;
+		Branch sibling;
+	};
+
+	struct RemoveOutcome {
+		BoundingBox bound;
+		std::size_t count;
+		bool changed;
+		bool dropped;
+	};
+
+	bool Writable() const { return m_pool.IsOpen() && !m_failed; }
+
+	bool Fetch(uint64_t page, PageRef &ref)
+	{
+		ref.pool = &m_pool;
+		ref.frame = m_pool.Pin(page);
+
+		if (ref.frame == Pool::npos)
+			m_failed = true;
+
+		return !m_failed;
+	}
+
+	// pagina en ceros, de la lista libre o al final del archivo
+	bool NewPage(PageRef &ref, uint64_t &page)
+	{
+		if (m_freeHead)
+		{
+			PageRef free;
+			if (!Fetch(m_freeHead, free))
+				return false;
+
+			page = m_freeHead;
+			m_freeHead = free.template As<RStarFreePage>()->next;
+		}
+		else
+			page = m_pageCount++;
+
+		ref.pool = &m_pool;
+		ref.frame = m_pool.PinNew(page);
+
+		if (ref.frame == Pool::npos)
+			m_failed = true;
+
+		return !m_failed;
+	}
+
+	// la pagina no se lee: se pisa con el enlace a la lista libre
+	bool FreePage(uint64_t page)
+	{
+		PageRef ref;
+		ref.pool = &m_pool;
+		ref.frame = m_pool.PinNew(page);
+
+		if (ref.frame == Pool::npos)
+		{
+			m_failed = true;
+			return false;
+		}
+
+		RStarFreePage * free = ref.template As<RStarFreePage>();
+		free->level = RSTAR_PAGE_FREE;
+		free->next = m_freeHead;
+		m_freeHead = page;
+		return true;
+	}
+
+	bool WriteHeader()
+	{
+		PageRef ref;
+		ref.pool = &m_pool;
+		ref.frame = m_pool.PinNew(0);
+
+		if (ref.frame == Pool::npos)
+		{
+			m_failed = true;
+			return false;
+		}
+
+		RStarPagedHeader &h = *ref.template As<RStarPagedHeader>();
+		std::memcpy(h.magic, RSTAR_PAGED_MAGIC, sizeof(h.magic));
+		h.version     = RSTAR_PAGED_VERSION;
+		h.byteOrder   = 0x01020304;
+		h.dimensions  = dimensions;
+		h.coordSize   = sizeof(Coord);
+		h.coordKind   = RStarFileHeader::CoordKind<Coord>();
+		h.pageSize    = page_size;
+		h.payloadSize = sizeof(LeafType);
+		h.minItems    = min_child_items;
+		h.maxItems    = max_child_items;
+		h.height      = m_height;
+		h.root        = m_root;
+		h.size        = m_size;
+		h.pageCount   = m_pageCount;
+		h.freeHead    = m_freeHead;
+		return true;
+	}
+
+	// lee el header y el bound de la raiz
+	bool ReadHeader()
+	{
+		PageRef ref;
+		if (!Fetch(0, ref))
+			return false;
+
+		const RStarPagedHeader &h = *ref.template As<RStarPagedHeader>();
+
+		if (std::memcmp(h.magic, RSTAR_PAGED_MAGIC, sizeof(h.magic)) != 0 ||
+			h.version != RSTAR_PAGED_VERSION || h.byteOrder != 0x01020304 ||
+			h.dimensions != dimensions || h.coordSize != sizeof(Coord) ||
+			h.coordKind != RStarFileHeader::CoordKind<Coord>() ||
+			h.pageSize != page_size || h.payloadSize != sizeof(LeafType) ||
+			h.minItems != min_child_items || h.maxItems != max_child_items)
+			return false;
+
+		if (h.pageCount < 1 || h.pageCount > m_pool.GetFilePageCount() ||
+			h.root >= h.pageCount || h.freeHead >= h.pageCount || (h.root == 0) != (h.height == 0))
+			return false;
+
+		m_root      = h.root;
+		m_height    = h.height;
+		m_size      = h.size;
+		m_pageCount = h.pageCount;
+		m_freeHead  = h.freeHead;
+		ref.Release();
+
+		m_bound.reset();
+		if (!m_root)
+			return true;
+
+		PageRef root;
+		if (!Fetch(m_root, root))
+			return false;
+
+		const BranchPage * node = root.template As<BranchPage>();
+		if (node->level + 1 != m_height || node->count > max_child_items)
+			return false;
+
+		m_bound = node->level ? Cover(node) : Cover(root.template As<LeafPage>());
+		return true;
+	}
+
+	template <typename Page>
+	static BoundingBox Cover(const Page * node)
+	{
+		BoundingBox bound = BoundingBox::MaximumBounds();
+		for (uint32_t i = 0; i < node->count; i++)
+			bound.stretch(node->entries[i].bound);
+		return bound;
+	}
+
+	// Insert desde la raiz y despues las reinserciones que haya dejado;
+	// cada nivel reinserta a lo sumo una vez
+	bool InsertLeaf(const Leaf &entry)
+	{
+		if (!m_root)
+		{
+			PageRef ref;
+			uint64_t page;
+			if (!NewPage(ref, page))
+				return false;
+
+			LeafPage * node = ref.template As<LeafPage>();
+			node->level = 0;
+			node->count = 1;
+			node->entries[0] = entry;
+
+			m_root = page;
+			m_height = 1;
+			m_bound = entry.bound;
+			return true;
+		}
+
+		m_reinserted.assign(m_height, false);
+
+		if (!InsertEntry(entry, 0))
+			return false;
+
+		while (!m_pendingLeaves.empty() || !m_pendingBranches.empty())
+		{
+			bool ok;
+
+			if (!m_pendingBranches.empty())
+			{
+				const std::pair<Branch, uint32_t> pending = m_pendingBranches.back();
+				m_pendingBranches.pop_back();
+				ok = InsertEntry(pending.first, pending.second);
+			}
+			else
+			{
+				const Leaf pending = m_pendingLeaves.back();
+				m_pendingLeaves.pop_back();
+				ok = InsertEntry(pending, 0);
+			}
+
+			if (!ok)
+			{
+				m_pendingLeaves.clear();
+				m_pendingBranches.clear();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// entry va a un nodo de nivel level; si la raiz se parte, el arbol crece
+	template <typename Entry>
+	bool InsertEntry(const Entry &entry, uint32_t level)
+	{
+		InsertOutcome out;
+		if (!InsertAt(m_root, entry, level, true, out))
+			return false;
+
+		m_bound = out.bound;
+		if (!out.split)
+			return true;
+
+		PageRef ref;
+		uint64_t page;
+		if (!NewPage(ref, page))
+			return false;
+
+		BranchPage * root = ref.template As<BranchPage>();
+		root->level = (uint32_t)m_height;
+		root->count = 2;
+		root->entries[0].bound = out.bound;
+		root->entries[0].page  = m_root;
+		root->entries[1] = out.sibling;
+
+		m_root = page;
+		m_height++;
+		m_bound.stretch(out.sibling.bound);
+		return true;
+	}
+
+	template <typename Entry>
+	bool InsertAt(uint64_t page, const Entry &entry, uint32_t level, bool isRoot, InsertOutcome &out)
+	{
+		PageRef ref;
+		if (!Fetch(page, ref))
+			return false;
+
+		BranchPage * node = ref.template As<BranchPage>();
+
+		if (node->level == level)
+			return Add(ref, entry, isRoot, out);
+
+		const std::size_t i = ChooseSubtree(node, entry.bound);
+
+		InsertOutcome child;
+		if (!InsertAt(node->entries[i].page, entry, level, false, child))
+			return false;
+
+		ref.dirty = true;
+		node->entries[i].bound = child.bound;
+
+		if (child.split)
+			return Add(ref, child.sibling, isRoot, out);
+
+		out.bound = Cover(node);
+		out.split = false;
+		return true;
+	}
+
+	// Agrega entry al nodo de ref; si desborda, reinserta (primera vez en
+	// el nivel, fuera de la raiz) o parte segun Strategy
+	template <typename Entry>
+	bool Add(PageRef &ref, const Entry &entry, bool isRoot, InsertOutcome &out)
+	{
+		typedef RStarPage<Entry, max_child_items>								Page;
+		typedef RStarPageOverflow<Entry, dimensions, max_child_items + 1>		Overflow;
+
+		Page * node = ref.template As<Page>();
+		ref.dirty = true;
+		out.split = false;
+
+		if (node->count < max_child_items)
+		{
+			node->entries[node->count++] = entry;
+			out.bound = Cover(node);
+			return true;
+		}
+
+		Entry entries[max_child_items + 1];
+		std::copy(node->entries, node->entries + max_child_items, entries);
+		entries[max_child_items] = entry;
+
+		Overflow overflow;
+		overflow.bound = entry.bound;
+		for (std::size_t i = 0; i <= max_child_items; i++)
+		{
+			overflow.items.push_back(&entries[i]);
+			overflow.bound.stretch(entries[i].bound);
+		}
+
+		if (m_reinserted.size() <= node->level)
+			m_reinserted.resize(node->level + 1, false);
+
+		if (!isRoot && !m_reinserted[node->level])
+		{
+			m_reinserted[node->level] = true;
+
+			const std::size_t p = Strategy::Reinsert(&overflow);
+			if (p)
+			{
+				const std::size_t keep = max_child_items + 1 - p;
+
+				for (std::size_t i = 0; i < keep; i++)
+					node->entries[i] = *overflow.items[i];
+				node->count = (uint32_t)keep;
+
+				for (std::size_t i = keep; i <= max_child_items; i++)
+					Queue(*overflow.items[i], node->level);
+
+				out.bound = Cover(node);
+				return true;
+			}
+		}
+
+		const std::size_t split_index = Strategy::template Split<min_child_items>(&overflow);
+
+		PageRef siblingRef;
+		uint64_t siblingPage;
+		if (!NewPage(siblingRef, siblingPage))
+			return false;
+
+		Page * sibling = siblingRef.template As<Page>();
+		sibling->level = node->level;
+		sibling->count = (uint32_t)(max_child_items + 1 - split_index);
+		node->count = (uint32_t)split_index;
+
+		for (std::size_t i = 0; i < split_index; i++)
+			node->entries[i] = *overflow.items[i];
+		for (std::size_t i = split_index; i <= max_child_items; i++)
+			sibling->entries[i - split_index] = *overflow.items[i];
+
+		out.bound = Cover(node);
+		out.split = true;
+		out.sibling.bound = Cover(sibling);
+		out.sibling.page  = siblingPage;
+		return true;
+	}
+
+	void Queue(const Leaf &leaf, uint32_t) { m_pendingLeaves.push_back(leaf); }
+	void Queue(const Branch &branch, uint32_t level) { m_pendingBranches.push_back(std::make_pair(branch, level)); }
+
+	// El de R*: si los hijos tienen hojas, el de menor ampliacion de overlap
+	// con sus hermanos entre los RSTAR_PAGED_CHOOSE_P de menor ampliacion
+	// de area; si no, el de menor ampliacion de area
+	std::size_t ChooseSubtree(const BranchPage * node, const BoundingBox &bound) const
+	{
+		typedef RStarChooseCost<BoundingBox>	Cost;
+		typedef typename Cost::Accum			Accum;
+
+		const std::size_t n = node->count;
+		Cost costs[max_child_items];
+
+		for (std::size_t i = 0; i < n; i++)
+			costs[i].Set(i, node->entries[i].bound, bound);
+
+		if (node->level != 1)
+			return std::min_element(costs, costs + n, Cost::ByEnlargement)->index;
+
+		const std::size_t candidates = std::min<std::size_t>(n, RSTAR_PAGED_CHOOSE_P);
+		std::partial_sort(costs, costs + candidates, costs + n, Cost::ByEnlargement);
+
+		std::size_t best = 0;
+		Accum bestOverlap = std::numeric_limits<Accum>::max();
+
+		for (std::size_t c = 0; c < candidates; c++)
+		{
+			const Cost &cost = costs[c];
+			Accum overlap = 0;
+
+			if (!(cost.enlarged == cost.box))
+				for (std::size_t j = 0; j < n && overlap < bestOverlap; j++)
+				{
+					if (j == cost.index)
+						continue;
+
+					const BoundingBox &sibling = node->entries[j].bound;
+					overlap += cost.enlarged.overlap(sibling) - cost.box.overlap(sibling);
+				}
+
+			if (overlap < bestOverlap)
+			{
+				best = c;
+				bestOverlap = overlap;
+
+				if (overlap == 0)
+					break;
+			}
+		}
+
+		return costs[best].index;
+	}
+
+	template <typename Acceptor, typename LeafRemover>
+	bool RemoveAt(uint64_t page, const Acceptor &accept, LeafRemover &remove, bool isRoot, RemoveOutcome &out)
+	{
+		PageRef ref;
+		if (!Fetch(page, ref))
+			return false;
+
+		BranchPage * node = ref.template As<BranchPage>();
+		const uint32_t n = node->count;
+		uint32_t kept = 0;
+
+		out.changed = false;
+		out.dropped = false;
+
+		if (node->level == 0)
+		{
+			Leaf * leaves = ref.template As<LeafPage>()->entries;
+
+			for (uint32_t i = 0; i < n; i++)
+			{
+				if (accept(&leaves[i]) && remove(&leaves[i]))
+				{
+					m_size--;
+					out.changed = true;
+					continue;
+				}
+
+				if (kept != i)
+					leaves[kept] = leaves[i];
+				kept++;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < n; i++)
+			{
+				Branch &branch = node->entries[i];
+
+				if (accept(&branch))
+				{
+					RemoveOutcome child;
+					if (!RemoveAt(branch.page, accept, remove, false, child))
+						return false;
+
+					if (child.changed)
+					{
+						out.changed = true;
+						if (child.dropped)
+							continue;
+
+						branch.bound = child.bound;
+					}
+				}
+
+				if (kept != i)
+					node->entries[kept] = branch;
+				kept++;
+			}
+		}
+
+		if (!out.changed)
+			return true;
+
+		ref.dirty = true;
+		node->count = kept;
+		out.count = kept;
+		out.bound = node->level ? Cover(node) : Cover(ref.template As<LeafPage>());
+
+		if (!isRoot && kept < min_child_items)
+		{
+			ref.Release();
+			out.dropped = true;
+			return Collect(page);
+		}
+
+		return true;
+	}
+
+	// pasa las hojas del subarbol de page a m_orphans y libera sus paginas
+	bool Collect(uint64_t page)
+	{
+		PageRef ref;
+		if (!Fetch(page, ref))
+			return false;
+
+		const BranchPage * node = ref.template As<BranchPage>();
+
+		if (node->level == 0)
+		{
+			const LeafPage * leaves = ref.template As<LeafPage>();
+			m_orphans.insert(m_orphans.end(), leaves->entries, leaves->entries + leaves->count);
+		}
+		else
+			for (uint32_t i = 0; i < node->count; i++)
+				if (!Collect(node->entries[i].page))
+					return false;
+
+		ref.Release();
+		return FreePage(page);
+	}
+
+	// despues de un Remove: raiz vacia fuera, raiz con un solo hijo
+	// reemplazada por el hijo
+	bool Condense(const RemoveOutcome &out)
+	{
+		m_bound = out.bound;
+
+		if (out.count == 0)
+		{
+			if (!FreePage(m_root))
+				return false;
+
+			m_root = 0;
+			m_height = 0;
+			m_bound.reset();
+			return true;
+		}
+
+		while (m_height > 1)
+		{
+			PageRef ref;
+			if (!Fetch(m_root, ref))
+				return false;
+
+			const BranchPage * node = ref.template As<BranchPage>();
+			if (node->count != 1)
+				break;
+
+			const uint64_t child = node->entries[0].page;
+			ref.Release();
+
+			if (!FreePage(m_root))
+				return false;
+
+			m_root = child;
+			m_height--;
+		}
+
+		return true;
+	}
+
+	template <typename Acceptor, typename Visitor>
+	void Visit(uint64_t page, const Acceptor &accept, Visitor &visitor)
+	{
+		PageRef ref;
+		if (!Fetch(page, ref))
+			return;
+
+		const BranchPage * node = ref.template As<BranchPage>();
+
+		if (node->level == 0)
+		{
+			const LeafPage * leaves = ref.template As<LeafPage>();
+			for (uint32_t i = 0; i < leaves->count && visitor.ContinueVisiting; i++)
+				if (accept(&leaves->entries[i]))
+					visitor(&leaves->entries[i]);
+		}
+		else
+			for (uint32_t i = 0; i < node->count && visitor.ContinueVisiting; i++)
+				if (accept(&node->entries[i]))
+					Visit(node->entries[i].page, accept, visitor);
+	}
+
+	Pool m_pool;
+
+	uint64_t m_root;
+	std::size_t m_height;
+	uint64_t m_size;
+	uint64_t m_pageCount;
+	uint64_t m_freeHead;
+	BoundingBox m_bound;
+
+	bool m_failed;
+
+	// estado de un Insert: niveles que ya reinsertaron y lo que falta
+	// reinsertar; de un Remove, las hojas de los nodos liberados
+	std::vector<bool> m_reinserted;
+	std::vector<Leaf> m_pendingLeaves;
+	std::vector< std::pair<Branch, uint32_t> > m_pendingBranches;
+	std::vector<Leaf> m_orphans;
+};
+
+
+#endif
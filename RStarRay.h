@@ -0,0 +1,214 @@
+#ifndef RSTARRAY_H
+#define RSTARRAY_H
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "RStarBoundingBox.h"
+#include "RStarSIMD.h"
+
+// Rayo o segmento para RStarTree::QueryRay: los puntos origin + t * direction
+// con t en [tMin, tMax]. t mide en unidades de direction, asi que con
+// direction unitaria es la distancia al origen y en un Segment va de 0 a 1.
+template <std::size_t dimensions>
+struct RStarRay {
+
+	typedef RStarPoint<dimensions> Point;
+
+	double origin[dimensions];
+	double direction[dimensions];
+
+	// 1 / direction; un eje con direction 0 queda en +-inf
+	double inverse[dimensions];
+
+	double tMin, tMax;
+
+	RStarRay() : tMin(0), tMax(std::numeric_limits<double>::infinity()) {}
+
+	RStarRay(const Point &from, const Point &towards, double maxT = std::numeric_limits<double>::infinity()) :
+		tMin(0), tMax(maxT)
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			origin[axis]    = from.coords[axis];
+			direction[axis] = towards.coords[axis];
+			inverse[axis]   = 1.0 / direction[axis];
+		}
+	}
+
+	// de from a to, t en [0, 1]
+	static RStarRay Segment(const Point &from, const Point &to)
+	{
+		Point direction;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			direction.coords[axis] = to.coords[axis] - from.coords[axis];
+
+		return RStarRay(from, direction, 1);
+	}
+
+	// Slab test: true si el rayo pasa por bound con t en [tMin, limit] y
+	// enter recibe el t en que entra. Las cajas son cerradas.
+	template <typename BoundingBox>
+	bool Intersect(const BoundingBox &bound, double limit, double &enter) const
+	{
+		double entry = tMin, exit = limit;
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const double lo = (double)bound.edges[axis].first, hi = (double)bound.edges[axis].second;
+			const double tNear = ((inverse[axis] < 0 ? hi : lo) - origin[axis]) * inverse[axis];
+			const double tFar  = ((inverse[axis] < 0 ? lo : hi) - origin[axis]) * inverse[axis];
+
+			// con el origen en el borde de un eje paralelo sale NaN, que
+			// las comparaciones ignoran: el borde cuenta como adentro
+			if (tNear > entry)
+				entry = tNear;
+			if (tFar < exit)
+				exit = tFar;
+
+			if (entry > exit)
+				return false;
+		}
+
+		enter = entry;
+		return true;
+	}
+
+	template <typename BoundingBox>
+	bool Intersect(const BoundingBox &bound, double &enter) const
+	{
+		return Intersect(bound, tMax, enter);
+	}
+};
+
+
+// Hasta RSTAR_RAY_PACKET rayos en columnas para los kernels de slab de
+// RStarSIMD.h. Los carriles sin rayo tienen tMin > tMax y nunca pegan.
+template <std::size_t dimensions>
+struct RStarRayPacket {
+
+	enum { width = RSTAR_RAY_PACKET };
+
+	double origin[dimensions][width];
+	double inverse[dimensions][width];
+	double tMin[width], tMax[width];
+
+	std::size_t count;
+
+	RStarRayPacket() : count(0)
+	{
+		Set(NULL, 0);
+	}
+
+	RStarRayPacket(const RStarRay<dimensions> * rays, std::size_t n)
+	{
+		Set(rays, n);
+	}
+
+	void Set(const RStarRay<dimensions> * rays, std::size_t n)
+	{
+		count = std::min<std::size_t>(n, width);
+
+		for (std::size_t r = 0; r < width; r++)
+		{
+			for (std::size_t axis = 0; axis < dimensions; axis++)
+			{
+				origin[axis][r]  = r < count ? rays[r].origin[axis] : 0;
+				inverse[axis][r] = r < count ? rays[r].inverse[axis] : 0;
+			}
+
+			tMin[r] = r < count ? rays[r].tMin : std::numeric_limits<double>::infinity();
+			tMax[r] = r < count ? rays[r].tMax : -std::numeric_limits<double>::infinity();
+		}
+	}
+
+	unsigned Lanes() const { return (1u << count) - 1; }
+
+	// bit r: el rayo r pasa por bound con t en [tMin, tMax]; enter[r] es su t
+	// de entrada
+	template <typename BoundingBox>
+	unsigned Intersect(const RStarRayKernels::Kernel kernel, const BoundingBox &bound, double * enter) const
+	{
+		double lo[dimensions], hi[dimensions];
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			lo[axis] = (double)bound.edges[axis].first;
+			hi[axis] = (double)bound.edges[axis].second;
+		}
+
+		return kernel(&origin[0][0], &inverse[0][0], tMin, tMax, dimensions, lo, hi, enter);
+	}
+};
+
+
+// Memoria de trabajo de RStarTree::QueryRayPacket; como RStarNearestBuffer,
+// se puede reutilizar entre consultas.
+template <typename BoundedItem>
+struct RStarRayPacketBuffer {
+
+	struct Entry {
+		double enter;		// el menor t de entrada de los rayos de lanes
+		const BoundedItem * item;
+		unsigned lanes;		// rayos que pasan por item
+		bool isLeaf;		// las hojas van con un solo rayo
+	};
+
+	// cola por t de entrada (min-heap)
+	std::vector<Entry> queue;
+
+	// por rayo, los k menores t de hojas encoladas (max-heap)
+	std::vector<double> best[RSTAR_RAY_PACKET];
+
+	void clear()
+	{
+		queue.clear();
+		for (std::size_t r = 0; r < RSTAR_RAY_PACKET; r++)
+			best[r].clear();
+	}
+
+	void push(double enter, const BoundedItem * item, unsigned lanes, bool isLeaf)
+	{
+		Entry e = { enter, item, lanes, isLeaf };
+		queue.push_back(e);
+		std::push_heap(queue.begin(), queue.end(), CompareEntries);
+	}
+
+	Entry pop()
+	{
+		std::pop_heap(queue.begin(), queue.end(), CompareEntries);
+		Entry e = queue.back();
+		queue.pop_back();
+		return e;
+	}
+
+	// registra el t de una hoja del rayo r; devuelve el k-esimo menor t
+	// conocido del rayo, o infinity si aun no hay k
+	double addCandidate(std::size_t r, double enter, std::size_t k)
+	{
+		std::vector<double> &b = best[r];
+
+		if (b.size() < k)
+		{
+			b.push_back(enter);
+			std::push_heap(b.begin(), b.end());
+		}
+		else if (enter < b.front())
+		{
+			std::pop_heap(b.begin(), b.end());
+			b.back() = enter;
+			std::push_heap(b.begin(), b.end());
+		}
+
+		return b.size() < k ? std::numeric_limits<double>::infinity() : b.front();
+	}
+
+	static bool CompareEntries(const Entry &a, const Entry &b)
+	{
+		return a.enter > b.enter;
+	}
+};
+
+
+#endif
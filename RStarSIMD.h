@@ -0,0 +1,670 @@
+#ifndef RSTARSIMD_H
+#define RSTARSIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels que prueban una caja de consulta contra todos los hijos de un nodo
+// (RStarChildBounds) y dejan un bit por hijo. Se elige la version en tiempo
+// de ejecucion: AVX-512, AVX2, SSE4.2 o escalar. Hay versiones vectoriales
+// para coordenadas int, float y double; los demas tipos usan la escalar.
+// RSTAR_NO_SIMD fuerza la version escalar. Al final, el slab test de los
+// paquetes de rayos de RStarTree::QueryRayPacket.
+
+#if !defined(RSTAR_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define RSTAR_SIMD_X86
+	#include <immintrin.h>
+#endif
+
+template <typename Coord>
+struct RStarBoxKernels {
+
+	// first/second: arreglos [dimensions][stride]; words (en cero) recibe un
+	// bit por cada uno de los n hijos
+	typedef void (*Kernel)(const Coord * first, const Coord * second, std::size_t stride,
+		std::size_t dimensions, std::size_t n, const Coord * qfirst, const Coord * qsecond, uint64_t * words);
+
+	Kernel overlaps;	// q.first < second && first < q.second
+	Kernel enclosed;	// q.first <= first && second <= q.second
+	const char * name;
+};
+
+
+// apaga los bits de carriles de padding (>= n)
+inline void RStarTrimWords(uint64_t * words, std::size_t n, std::size_t lanes)
+{
+	const std::size_t total = (n + lanes - 1) / lanes * lanes;
+
+	if (n % 64)
+		words[n / 64] &= ((uint64_t)1 << (n % 64)) - 1;
+
+	for (std::size_t w = (n + 63) / 64; w < (total + 63) / 64; w++)
+		words[w] = 0;
+}
+
+
+template <typename Coord>
+inline void RStarOverlapsScalar(const Coord * first, const Coord * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const Coord * qfirst, const Coord * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i++)
+	{
+		bool hit = true;
+		for (std::size_t axis = 0; hit && axis < dimensions; axis++)
+			hit = qfirst[axis] < second[axis*stride + i] && first[axis*stride + i] < qsecond[axis];
+
+		if (hit)
+			words[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+}
+
+template <typename Coord>
+inline void RStarEnclosedScalar(const Coord * first, const Coord * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const Coord * qfirst, const Coord * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i++)
+	{
+		bool hit = true;
+		for (std::size_t axis = 0; hit && axis < dimensions; axis++)
+			hit = !(first[axis*stride + i] < qfirst[axis]) && !(qsecond[axis] < second[axis*stride + i]);
+
+		if (hit)
+			words[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+}
+
+
+#ifdef RSTAR_SIMD_X86
+
+__attribute__((target("sse4.2")))
+inline void RStarOverlapsSSE_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m128i m = _mm_set1_epi32(-1);
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128i f = _mm_loadu_si128((const __m128i*)(first + axis*stride + i));
+			const __m128i s = _mm_loadu_si128((const __m128i*)(second + axis*stride + i));
+
+			m = _mm_and_si128(m, _mm_cmpgt_epi32(s, _mm_set1_epi32(qfirst[axis])));
+			m = _mm_and_si128(m, _mm_cmpgt_epi32(_mm_set1_epi32(qsecond[axis]), f));
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(m)) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("sse4.2")))
+inline void RStarEnclosedSSE_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m128i m = _mm_set1_epi32(-1);
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128i f = _mm_loadu_si128((const __m128i*)(first + axis*stride + i));
+			const __m128i s = _mm_loadu_si128((const __m128i*)(second + axis*stride + i));
+
+			m = _mm_andnot_si128(_mm_cmpgt_epi32(_mm_set1_epi32(qfirst[axis]), f), m);
+			m = _mm_andnot_si128(_mm_cmpgt_epi32(s, _mm_set1_epi32(qsecond[axis])), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(m)) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("avx2")))
+inline void RStarOverlapsAVX2_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__m256i m = _mm256_set1_epi32(-1);
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256i f = _mm256_loadu_si256((const __m256i*)(first + axis*stride + i));
+			const __m256i s = _mm256_loadu_si256((const __m256i*)(second + axis*stride + i));
+
+			m = _mm256_and_si256(m, _mm256_cmpgt_epi32(s, _mm256_set1_epi32(qfirst[axis])));
+			m = _mm256_and_si256(m, _mm256_cmpgt_epi32(_mm256_set1_epi32(qsecond[axis]), f));
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+__attribute__((target("avx2")))
+inline void RStarEnclosedAVX2_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__m256i m = _mm256_set1_epi32(-1);
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256i f = _mm256_loadu_si256((const __m256i*)(first + axis*stride + i));
+			const __m256i s = _mm256_loadu_si256((const __m256i*)(second + axis*stride + i));
+
+			m = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(qfirst[axis]), f), m);
+			m = _mm256_andnot_si256(_mm256_cmpgt_epi32(s, _mm256_set1_epi32(qsecond[axis])), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(m)) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarOverlapsAVX512_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 16)
+	{
+		__mmask16 m = 0xFFFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512i f = _mm512_loadu_si512((const void*)(first + axis*stride + i));
+			const __m512i s = _mm512_loadu_si512((const void*)(second + axis*stride + i));
+
+			m = _mm512_mask_cmpgt_epi32_mask(m, s, _mm512_set1_epi32(qfirst[axis]));
+			m = _mm512_mask_cmplt_epi32_mask(m, f, _mm512_set1_epi32(qsecond[axis]));
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 16);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarEnclosedAVX512_i32(const int * first, const int * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const int * qfirst, const int * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 16)
+	{
+		__mmask16 m = 0xFFFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512i f = _mm512_loadu_si512((const void*)(first + axis*stride + i));
+			const __m512i s = _mm512_loadu_si512((const void*)(second + axis*stride + i));
+
+			m = _mm512_mask_cmpge_epi32_mask(m, f, _mm512_set1_epi32(qfirst[axis]));
+			m = _mm512_mask_cmple_epi32_mask(m, s, _mm512_set1_epi32(qsecond[axis]));
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 16);
+}
+
+__attribute__((target("sse4.2")))
+inline void RStarOverlapsSSE_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m128 m = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128 f = _mm_loadu_ps(first + axis*stride + i);
+			const __m128 s = _mm_loadu_ps(second + axis*stride + i);
+
+			m = _mm_and_ps(m, _mm_cmpgt_ps(s, _mm_set1_ps(qfirst[axis])));
+			m = _mm_and_ps(m, _mm_cmplt_ps(f, _mm_set1_ps(qsecond[axis])));
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_ps(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("sse4.2")))
+inline void RStarEnclosedSSE_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m128 m = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128 f = _mm_loadu_ps(first + axis*stride + i);
+			const __m128 s = _mm_loadu_ps(second + axis*stride + i);
+
+			m = _mm_andnot_ps(_mm_cmplt_ps(f, _mm_set1_ps(qfirst[axis])), m);
+			m = _mm_andnot_ps(_mm_cmplt_ps(_mm_set1_ps(qsecond[axis]), s), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_ps(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("avx2")))
+inline void RStarOverlapsAVX2_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__m256 m = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256 f = _mm256_loadu_ps(first + axis*stride + i);
+			const __m256 s = _mm256_loadu_ps(second + axis*stride + i);
+
+			m = _mm256_and_ps(m, _mm256_cmp_ps(s, _mm256_set1_ps(qfirst[axis]), _CMP_GT_OQ));
+			m = _mm256_and_ps(m, _mm256_cmp_ps(f, _mm256_set1_ps(qsecond[axis]), _CMP_LT_OQ));
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_ps(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+__attribute__((target("avx2")))
+inline void RStarEnclosedAVX2_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__m256 m = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256 f = _mm256_loadu_ps(first + axis*stride + i);
+			const __m256 s = _mm256_loadu_ps(second + axis*stride + i);
+
+			m = _mm256_andnot_ps(_mm256_cmp_ps(f, _mm256_set1_ps(qfirst[axis]), _CMP_LT_OQ), m);
+			m = _mm256_andnot_ps(_mm256_cmp_ps(_mm256_set1_ps(qsecond[axis]), s, _CMP_LT_OQ), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_ps(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarOverlapsAVX512_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 16)
+	{
+		__mmask16 m = 0xFFFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512 f = _mm512_loadu_ps(first + axis*stride + i);
+			const __m512 s = _mm512_loadu_ps(second + axis*stride + i);
+
+			m = _mm512_mask_cmp_ps_mask(m, s, _mm512_set1_ps(qfirst[axis]), _CMP_GT_OQ);
+			m = _mm512_mask_cmp_ps_mask(m, f, _mm512_set1_ps(qsecond[axis]), _CMP_LT_OQ);
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 16);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarEnclosedAVX512_f32(const float * first, const float * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const float * qfirst, const float * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 16)
+	{
+		__mmask16 m = 0xFFFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512 f = _mm512_loadu_ps(first + axis*stride + i);
+			const __m512 s = _mm512_loadu_ps(second + axis*stride + i);
+
+			m &= ~_mm512_cmp_ps_mask(f, _mm512_set1_ps(qfirst[axis]), _CMP_LT_OQ);
+			m &= ~_mm512_cmp_ps_mask(_mm512_set1_ps(qsecond[axis]), s, _CMP_LT_OQ);
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 16);
+}
+
+__attribute__((target("sse4.2")))
+inline void RStarOverlapsSSE_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 2)
+	{
+		__m128d m = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128d f = _mm_loadu_pd(first + axis*stride + i);
+			const __m128d s = _mm_loadu_pd(second + axis*stride + i);
+
+			m = _mm_and_pd(m, _mm_cmpgt_pd(s, _mm_set1_pd(qfirst[axis])));
+			m = _mm_and_pd(m, _mm_cmplt_pd(f, _mm_set1_pd(qsecond[axis])));
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_pd(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 2);
+}
+
+__attribute__((target("sse4.2")))
+inline void RStarEnclosedSSE_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 2)
+	{
+		__m128d m = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m128d f = _mm_loadu_pd(first + axis*stride + i);
+			const __m128d s = _mm_loadu_pd(second + axis*stride + i);
+
+			m = _mm_andnot_pd(_mm_cmplt_pd(f, _mm_set1_pd(qfirst[axis])), m);
+			m = _mm_andnot_pd(_mm_cmplt_pd(_mm_set1_pd(qsecond[axis]), s), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm_movemask_pd(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 2);
+}
+
+__attribute__((target("avx2")))
+inline void RStarOverlapsAVX2_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m256d m = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256d f = _mm256_loadu_pd(first + axis*stride + i);
+			const __m256d s = _mm256_loadu_pd(second + axis*stride + i);
+
+			m = _mm256_and_pd(m, _mm256_cmp_pd(s, _mm256_set1_pd(qfirst[axis]), _CMP_GT_OQ));
+			m = _mm256_and_pd(m, _mm256_cmp_pd(f, _mm256_set1_pd(qsecond[axis]), _CMP_LT_OQ));
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_pd(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("avx2")))
+inline void RStarEnclosedAVX2_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 4)
+	{
+		__m256d m = _mm256_castsi256_pd(_mm256_set1_epi32(-1));
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256d f = _mm256_loadu_pd(first + axis*stride + i);
+			const __m256d s = _mm256_loadu_pd(second + axis*stride + i);
+
+			m = _mm256_andnot_pd(_mm256_cmp_pd(f, _mm256_set1_pd(qfirst[axis]), _CMP_LT_OQ), m);
+			m = _mm256_andnot_pd(_mm256_cmp_pd(_mm256_set1_pd(qsecond[axis]), s, _CMP_LT_OQ), m);
+		}
+
+		words[i / 64] |= (uint64_t)_mm256_movemask_pd(m) << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 4);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarOverlapsAVX512_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = 0xFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512d f = _mm512_loadu_pd(first + axis*stride + i);
+			const __m512d s = _mm512_loadu_pd(second + axis*stride + i);
+
+			m = _mm512_mask_cmp_pd_mask(m, s, _mm512_set1_pd(qfirst[axis]), _CMP_GT_OQ);
+			m = _mm512_mask_cmp_pd_mask(m, f, _mm512_set1_pd(qsecond[axis]), _CMP_LT_OQ);
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+__attribute__((target("avx512f")))
+inline void RStarEnclosedAVX512_f64(const double * first, const double * second, std::size_t stride,
+	std::size_t dimensions, std::size_t n, const double * qfirst, const double * qsecond, uint64_t * words)
+{
+	for (std::size_t i = 0; i < n; i += 8)
+	{
+		__mmask8 m = 0xFF;
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m512d f = _mm512_loadu_pd(first + axis*stride + i);
+			const __m512d s = _mm512_loadu_pd(second + axis*stride + i);
+
+			m &= ~_mm512_cmp_pd_mask(f, _mm512_set1_pd(qfirst[axis]), _CMP_LT_OQ);
+			m &= ~_mm512_cmp_pd_mask(_mm512_set1_pd(qsecond[axis]), s, _CMP_LT_OQ);
+		}
+
+		words[i / 64] |= (uint64_t)m << (i % 64);
+	}
+
+	RStarTrimWords(words, n, 8);
+}
+
+#endif
+
+
+template <typename Coord>
+inline RStarBoxKernels<Coord> RStarDetectBoxKernels()
+{
+	RStarBoxKernels<Coord> k = { RStarOverlapsScalar<Coord>, RStarEnclosedScalar<Coord>, "scalar" };
+	return k;
+}
+
+#ifdef RSTAR_SIMD_X86
+
+#define RSTAR_DETECT_BOX_KERNELS(COORD, SUFFIX) \
+	template <> \
+	inline RStarBoxKernels<COORD> RStarDetectBoxKernels<COORD>() \
+	{ \
+		RStarBoxKernels<COORD> k = { RStarOverlapsScalar<COORD>, RStarEnclosedScalar<COORD>, "scalar" }; \
+		__builtin_cpu_init(); \
+		if (__builtin_cpu_supports("avx512f")) \
+		{ \
+			k.overlaps = RStarOverlapsAVX512_##SUFFIX; \
+			k.enclosed = RStarEnclosedAVX512_##SUFFIX; \
+			k.name = "avx512"; \
+		} \
+		else if (__builtin_cpu_supports("avx2")) \
+		{ \
+			k.overlaps = RStarOverlapsAVX2_##SUFFIX; \
+			k.enclosed = RStarEnclosedAVX2_##SUFFIX; \
+			k.name = "avx2"; \
+		} \
+		else if (__builtin_cpu_supports("sse4.2")) \
+		{ \
+			k.overlaps = RStarOverlapsSSE_##SUFFIX; \
+			k.enclosed = RStarEnclosedSSE_##SUFFIX; \
+			k.name = "sse4.2"; \
+		} \
+		return k; \
+	}
+
+RSTAR_DETECT_BOX_KERNELS(int, i32)
+RSTAR_DETECT_BOX_KERNELS(float, f32)
+RSTAR_DETECT_BOX_KERNELS(double, f64)
+
+#undef RSTAR_DETECT_BOX_KERNELS
+
+#endif
+
+// Slab test de una caja contra un paquete de RSTAR_RAY_PACKET rayos
+// (RStarRayPacket): origin e inverse son [dimensions][RSTAR_RAY_PACKET] y
+// lo/hi la caja en double. Devuelve un bit por rayo que entra a la caja
+// dentro de [tMin, tMax] y deja en enter el t de entrada de cada uno. Un
+// eje paralelo a la caja da 0 * inf = NaN cuando el origen esta justo en
+// el borde; max/min se quedan con el segundo operando y lo ignoran, asi
+// que el borde cuenta como adentro.
+#define RSTAR_RAY_PACKET 8
+
+struct RStarRayKernels {
+
+	typedef unsigned (*Kernel)(const double * origin, const double * inverse, const double * tMin, const double * tMax,
+		std::size_t dimensions, const double * lo, const double * hi, double * enter);
+
+	Kernel slab;
+	const char * name;
+};
+
+inline unsigned RStarSlabScalar(const double * origin, const double * inverse, const double * tMin, const double * tMax,
+	std::size_t dimensions, const double * lo, const double * hi, double * enter)
+{
+	unsigned mask = 0;
+
+	for (std::size_t r = 0; r < RSTAR_RAY_PACKET; r++)
+	{
+		double entry = tMin[r], exit = tMax[r];
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const double o = origin[axis*RSTAR_RAY_PACKET + r], inv = inverse[axis*RSTAR_RAY_PACKET + r];
+			const double tNear = ((inv < 0 ? hi[axis] : lo[axis]) - o) * inv;
+			const double tFar  = ((inv < 0 ? lo[axis] : hi[axis]) - o) * inv;
+
+			if (tNear > entry)
+				entry = tNear;
+			if (tFar < exit)
+				exit = tFar;
+		}
+
+		enter[r] = entry;
+		if (entry <= exit)
+			mask |= 1u << r;
+	}
+
+	return mask;
+}
+
+#ifdef RSTAR_SIMD_X86
+
+__attribute__((target("avx2")))
+inline unsigned RStarSlabAVX2(const double * origin, const double * inverse, const double * tMin, const double * tMax,
+	std::size_t dimensions, const double * lo, const double * hi, double * enter)
+{
+	unsigned mask = 0;
+
+	for (std::size_t r = 0; r < RSTAR_RAY_PACKET; r += 4)
+	{
+		__m256d entry = _mm256_loadu_pd(tMin + r);
+		__m256d exit  = _mm256_loadu_pd(tMax + r);
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const __m256d o   = _mm256_loadu_pd(origin + axis*RSTAR_RAY_PACKET + r);
+			const __m256d inv = _mm256_loadu_pd(inverse + axis*RSTAR_RAY_PACKET + r);
+			const __m256d l = _mm256_set1_pd(lo[axis]), h = _mm256_set1_pd(hi[axis]);
+			const __m256d negative = _mm256_cmp_pd(inv, _mm256_setzero_pd(), _CMP_LT_OQ);
+
+			const __m256d tNear = _mm256_mul_pd(_mm256_sub_pd(_mm256_blendv_pd(l, h, negative), o), inv);
+			const __m256d tFar  = _mm256_mul_pd(_mm256_sub_pd(_mm256_blendv_pd(h, l, negative), o), inv);
+
+			entry = _mm256_max_pd(tNear, entry);
+			exit  = _mm256_min_pd(tFar, exit);
+		}
+
+		_mm256_storeu_pd(enter + r, entry);
+		mask |= (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(entry, exit, _CMP_LE_OQ)) << r;
+	}
+
+	return mask;
+}
+
+__attribute__((target("avx512f")))
+inline unsigned RStarSlabAVX512(const double * origin, const double * inverse, const double * tMin, const double * tMax,
+	std::size_t dimensions, const double * lo, const double * hi, double * enter)
+{
+	__m512d entry = _mm512_loadu_pd(tMin);
+	__m512d exit  = _mm512_loadu_pd(tMax);
+
+	for (std::size_t axis = 0; axis < dimensions; axis++)
+	{
+		const __m512d o   = _mm512_loadu_pd(origin + axis*RSTAR_RAY_PACKET);
+		const __m512d inv = _mm512_loadu_pd(inverse + axis*RSTAR_RAY_PACKET);
+		const __m512d l = _mm512_set1_pd(lo[axis]), h = _mm512_set1_pd(hi[axis]);
+		const __mmask8 negative = _mm512_cmp_pd_mask(inv, _mm512_setzero_pd(), _CMP_LT_OQ);
+
+		const __m512d tNear = _mm512_mul_pd(_mm512_sub_pd(_mm512_mask_blend_pd(negative, l, h), o), inv);
+		const __m512d tFar  = _mm512_mul_pd(_mm512_sub_pd(_mm512_mask_blend_pd(negative, h, l), o), inv);
+
+		// las formas con mascara, con todos los carriles: _mm512_max_pd y
+		// _mm512_min_pd pasan un _mm512_undefined_pd como fuente y GCC 12
+		// avisa maybe-uninitialized
+		entry = _mm512_mask_max_pd(entry, 0xFF, tNear, entry);
+		exit  = _mm512_mask_min_pd(exit, 0xFF, tFar, exit);
+	}
+
+	_mm512_storeu_pd(enter, entry);
+	return (unsigned)_mm512_cmp_pd_mask(entry, exit, _CMP_LE_OQ);
+}
+
+#endif
+
+inline RStarRayKernels RStarDetectRayKernels()
+{
+	RStarRayKernels k = { RStarSlabScalar, "scalar" };
+
+#ifdef RSTAR_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		k.slab = RStarSlabAVX512;
+		k.name = "avx512";
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		k.slab = RStarSlabAVX2;
+		k.name = "avx2";
+	}
+#endif
+
+	return k;
+}
+
+inline const RStarRayKernels & RStarGetRayKernels()
+{
+	static const RStarRayKernels kernels = RStarDetectRayKernels();
+	return kernels;
+}
+
+
+// se detecta una sola vez por proceso
+template <typename Coord>
+inline const RStarBoxKernels<Coord> & RStarGetBoxKernels()
+{
+	static const RStarBoxKernels<Coord> kernels = RStarDetectBoxKernels<Coord>();
+	return kernels;
+}
+
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef RSTARSPLIT_H
+#define RSTARSPLIT_H
+
+#include <cstddef>
+#include <algorithm>
+
+#include "RStarBoundingBox.h"
+
+// Memoria de trabajo de RStarTree::Split. Copia los bounds de los hijos una
+// vez y trabaja sobre una permutacion de indices: los ordenamientos comparan
+// claves guardadas en un arreglo, y prefix/suffix dan en O(M) las cajas de
+// todas las distribuciones de un orden.
+template <typename BoundedItem, std::size_t capacity>
+struct RStarSplitSweep {
+
+	typedef typename BoundedItem::BoundingBox	BoundingBox;
+	typedef typename BoundingBox::coord_type	Coord;
+
+	struct Keyed {
+		Coord key;
+		std::size_t index;
+
+		bool operator<(const Keyed &k) const { return key < k.key; }
+	};
+
+	std::size_t n;
+	BoundingBox boxes[capacity];
+	std::size_t order[capacity];
+	Keyed keyed[capacity];
+
+	// prefix[j] encierra order[0, j); suffix[j] encierra order[j, n)
+	BoundingBox prefix[capacity + 1];
+	BoundingBox suffix[capacity + 1];
+
+	template <typename Items>
+	void Load(const Items &items)
+	{
+		n = items.size();
+
+		for (std::size_t i = 0; i < n; i++)
+		{
+			boxes[i] = items[i]->bound;
+			order[i] = i;
+		}
+	}
+
+	// Reordena como std::sort(items, SortBoundedItemsBy{First,Second}Edge(axis))
+	// aplicado al orden actual: std::sort toma las mismas decisiones con las
+	// mismas comparaciones, asi que los empates quedan igual
+	void Sort(std::size_t axis, std::size_t edge)
+	{
+		for (std::size_t i = 0; i < n; i++)
+		{
+			keyed[i].key = edge == 0 ? boxes[order[i]].edges[axis].first : boxes[order[i]].edges[axis].second;
+			keyed[i].index = order[i];
+		}
+
+		std::sort(keyed, keyed + n);
+
+		for (std::size_t i = 0; i < n; i++)
+			order[i] = keyed[i].index;
+	}
+
+	// llena prefix[low, high] y suffix[low+1, high+1], que es lo que usan
+	// las distribuciones; las cajas se acumulan sin recalcular
+	void Sweep(std::size_t low, std::size_t high)
+	{
+		BoundingBox box;
+
+		box.reset();
+		for (std::size_t j = 0; j <= high; j++)
+		{
+			if (j >= low)
+				prefix[j] = box;
+			if (j < n)
+				box.stretch(boxes[order[j]]);
+		}
+
+		box.reset();
+		for (std::size_t j = n; ; j--)
+		{
+			if (j <= high + 1)
+				suffix[j] = box;
+			if (j == low + 1)
+				break;
+			box.stretch(boxes[order[j-1]]);
+		}
+	}
+
+	// aplica el orden actual a items
+	template <typename Items>
+	void Apply(Items &items) const
+	{
+		BoundedItem * original[capacity];
+		std::copy(items.begin(), items.end(), original);
+
+		for (std::size_t i = 0; i < n; i++)
+			items[i] = original[order[i]];
+	}
+};
+
+
+#endif
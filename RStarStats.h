@@ -0,0 +1,122 @@
+#ifndef RSTARSTATS_H
+#define RSTARSTATS_H
+
+#include <cstddef>
+#include <vector>
+
+// intervalos del histograma de llenado: [0, 10%), [10%, 20%) ... [90%, 100%]
+#define RSTAR_STATS_FILL_BINS 10
+
+// Estado de un nivel del arbol (levels[0] es la raiz). Las areas son la
+// suma sobre los nodos del nivel.
+struct RStarLevelStats {
+	std::size_t nodes;
+	std::size_t children;
+	std::size_t fill[RSTAR_STATS_FILL_BINS];
+
+	double area;
+	// overlap entre cada par de hijos de un mismo nodo
+	double siblingOverlap;
+	// area del nodo que no cubre ningun hijo, estimada como area del nodo
+	// menos la suma de las de sus hijos (0 si los hijos se solapan de mas)
+	double deadSpace;
+
+	RStarLevelStats() : nodes(0), children(0), area(0), siblingOverlap(0), deadSpace(0)
+	{
+		for (std::size_t b = 0; b < RSTAR_STATS_FILL_BINS; b++)
+			fill[b] = 0;
+	}
+
+	double AverageOverlap() const { return nodes ? siblingOverlap / nodes : 0; }
+	double AverageChildren() const { return nodes ? (double)children / nodes : 0; }
+};
+
+// Resultado de RStarTree::Stats(); bytes cuenta nodos y hojas vivos, sin
+// lo retirado ni el espacio libre del allocator
+struct RStarTreeStats {
+	std::size_t height;
+	std::size_t nodes;
+	std::size_t leaves;
+	std::size_t bytes;
+
+	std::vector<RStarLevelStats> levels;
+
+	RStarTreeStats() : height(0), nodes(0), leaves(0), bytes(0) {}
+
+	double SiblingOverlap() const
+	{
+		double overlap = 0;
+		for (std::size_t l = 0; l < levels.size(); l++)
+			overlap += levels[l].siblingOverlap;
+		return overlap;
+	}
+
+	double DeadSpace() const
+	{
+		double dead = 0;
+		for (std::size_t l = 0; l < levels.size(); l++)
+			dead += levels[l].deadSpace;
+		return dead;
+	}
+};
+
+
+// Contadores de recorrido de las consultas de RStarTree (Query, Cursor,
+// QueryNearest, QueryBatch y los de Snapshot). Cada hilo suma en su propio
+// sink, Local(); sin RSTAR_ENABLE_QUERY_COUNTERS no se cuenta nada y las
+// macros no generan codigo. Para una consulta:
+//
+//   RStarQueryCounters before = RStarQueryCounters::Local();
+//   tree.Query(...);
+//   RStarQueryCounters used = RStarQueryCounters::Local() - before;
+//
+// Con QueryBatch cuentan los sinks de los hilos del pool.
+struct RStarQueryCounters {
+	std::size_t nodesVisited;
+	std::size_t leavesTested;
+	std::size_t acceptorCalls;
+	std::size_t acceptorHits;
+
+	RStarQueryCounters() : nodesVisited(0), leavesTested(0), acceptorCalls(0), acceptorHits(0) {}
+
+	void Reset() { *this = RStarQueryCounters(); }
+
+	RStarQueryCounters operator-(const RStarQueryCounters &c) const
+	{
+		RStarQueryCounters d;
+		d.nodesVisited  = nodesVisited - c.nodesVisited;
+		d.leavesTested  = leavesTested - c.leavesTested;
+		d.acceptorCalls = acceptorCalls - c.acceptorCalls;
+		d.acceptorHits  = acceptorHits - c.acceptorHits;
+		return d;
+	}
+
+	static RStarQueryCounters & Local()
+	{
+		static thread_local RStarQueryCounters counters;
+		return counters;
+	}
+};
+
+#ifdef RSTAR_ENABLE_QUERY_COUNTERS
+	// un nodo recorrido; si sus hijos son hojas, se prueban todas
+	#define RSTAR_COUNT_NODE(hasLeaves, children) \
+		do { \
+			RStarQueryCounters &c_ = RStarQueryCounters::Local(); \
+			c_.nodesVisited++; \
+			if (hasLeaves) c_.leavesTested += (children); \
+		} while (0)
+
+	#define RSTAR_COUNT_ACCEPT(calls, hits) \
+		do { \
+			RStarQueryCounters &c_ = RStarQueryCounters::Local(); \
+			c_.acceptorCalls += (calls); \
+			c_.acceptorHits  += (hits); \
+		} while (0)
+#else
+	#define RSTAR_COUNT_NODE(hasLeaves, children)	((void)0)
+	#define RSTAR_COUNT_ACCEPT(calls, hits)			((void)0)
+#endif
+
+
+#endif
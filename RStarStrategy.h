@@ -0,0 +1,553 @@
+#ifndef RSTARSTRATEGY_H
+#define RSTARSTRATEGY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+#include "RStarBoundingBox.h"
+#include "RStarSplit.h"
+#include "RStarBulkLoad.h"
+#include "RStarVisitor.h"
+
+// Politicas de insercion de RStarTree: en que hijo se baja, como se parte
+// un nodo desbordado y si antes de partirlo se reinsertan hijos. Son structs
+// con funciones estaticas que el arbol llama directamente, sin virtuales.
+// La lineal es la mas barata de construir y R* la que da consultas mas
+// baratas; cuadratica, Hilbert y R* sin reinsercion quedan en el medio.
+//
+// Interfaz:
+//   ChooseSubtree(node, bound)  indice del hijo de node (interno) donde
+//                               insertar bound
+//   Split<min_child_items>(node)
+//                               reordena los max_child_items+1 hijos de node
+//                               y devuelve donde empieza el grupo que pasa al
+//                               nodo nuevo, en [min_child_items, n - min_child_items]
+//   Reinsert(node)              en el primer desborde de una insercion, fuera
+//                               de la raiz: cuantos hijos reinsertar en vez de
+//                               partir, dejandolos al final de node->items.
+//                               0 es partir
+//
+// Ninguna toca bounds ni childBounds de node; eso lo hace el arbol.
+
+
+// costo de bajar por un hijo, para ChooseSubtree
+template <typename BoundingBox>
+struct RStarChooseCost {
+	typedef typename BoundingBox::accum_type	Accum;
+
+	BoundingBox box, enlarged;
+	Accum area, enlargement;
+	std::size_t index;
+
+	void Set(std::size_t i, const BoundingBox &child, const BoundingBox &bound)
+	{
+		index = i;
+		box = child;
+		enlarged = child;
+		enlarged.stretch(bound);
+		area = box.area();
+		enlargement = enlarged.area() - area;
+	}
+
+	static bool ByEnlargement(const RStarChooseCost &a, const RStarChooseCost &b)
+	{
+		return a.enlargement < b.enlargement || (a.enlargement == b.enlargement && a.area < b.area);
+	}
+};
+
+
+// R* (Beckmann et al. 1990). reinsert_percent de los hijos se reinsertan en
+// el primer desborde (0 lo desactiva); choose_subtree_p es cuantos
+// candidatos se miran por overlap sobre nodos con hojas.
+template <unsigned reinsert_percent = 30, std::size_t choose_subtree_p = 32>
+struct RStarStrategyRStar {
+
+	// Si los hijos tienen hojas, el de menor ampliacion de overlap con sus
+	// hermanos, buscando solo entre los choose_subtree_p de menor ampliacion
+	// de area; si no, el de menor ampliacion de area. Los empates se
+	// resuelven por ampliacion de area y luego por area. Cada costo se
+	// calcula una vez, en un arreglo aparte: node->items no se reordena.
+	template <typename Node, typename BoundingBox>
+	static std::size_t ChooseSubtree(const Node * node, const BoundingBox &bound)
+	{
+		typedef RStarChooseCost<BoundingBox>	Cost;
+		typedef typename Cost::Accum			Accum;
+		typedef typename BoundingBox::coord_type	Coord;
+
+		const std::size_t n = node->items.size();
+		Cost costs[Node::node_capacity];
+
+		for (std::size_t i = 0; i < n; i++)
+			costs[i].Set(i, node->items[i]->bound, bound);
+
+		if (!static_cast<const Node*>(node->items[0])->hasLeaves)
+			return std::min_element(costs, costs + n, Cost::ByEnlargement)->index;
+
+		// en orden de ampliacion de area: con el mismo overlap gana el primero.
+		// El corte en choose_subtree_p, como siempre, solo con max_child_items
+		// mayor que 2/3 de choose_subtree_p
+		std::size_t candidates = n;
+		if ((std::size_t)Node::node_capacity - 1 > (choose_subtree_p*2)/3 && n > choose_subtree_p)
+		{
+			std::partial_sort(costs, costs + choose_subtree_p, costs + n, Cost::ByEnlargement);
+			candidates = choose_subtree_p;
+		}
+		else
+			std::sort(costs, costs + n, Cost::ByEnlargement);
+
+		const typename RStarBoxKernels<Coord>::Kernel overlaps = RStarGetBoxKernels<Coord>().overlaps;
+
+		std::size_t best = 0;
+		Accum bestOverlap = std::numeric_limits<Accum>::max();
+
+		for (std::size_t c = 0; c < candidates; c++)
+		{
+			const Cost &cost = costs[c];
+			Accum overlap = 0;
+
+			// si ya contiene a bound no agrega overlap; si no, solo
+			// cuentan los hermanos que toca la caja ampliada. Cada termino
+			// es >= 0, asi que se corta al alcanzar al mejor
+			if (!(cost.enlarged == cost.box))
+			{
+				typename Node::HitMask hits;
+				RStarScanChildren(overlaps, cost.enlarged, node, hits);
+
+				for (std::size_t j = hits.next(0); j < n && overlap < bestOverlap; j = hits.next(j+1))
+				{
+					if (j == cost.index)
+						continue;
+
+					const BoundingBox sibling = node->childBounds.get(j);
+					overlap += cost.enlarged.overlap(sibling) - cost.box.overlap(sibling);
+				}
+			}
+
+			if (overlap < bestOverlap)
+			{
+				best = c;
+				bestOverlap = overlap;
+
+				if (overlap == 0)
+					break;
+			}
+		}
+
+		return costs[best].index;
+	}
+
+	// Elige eje, borde e indice como el R* original; las cajas de cada
+	// distribucion salen de prefix/suffix en vez de recalcularse
+	template <std::size_t min_child_items, typename Node>
+	static std::size_t Split(Node * node)
+	{
+		typedef typename Node::BoundingBox			BoundingBox;
+		typedef typename BoundingBox::accum_type	Accum;
+		const std::size_t dimensions = Node::node_dimensions;
+
+		const std::size_t n_items = node->items.size();
+		const std::size_t distribution_count = n_items - 2*min_child_items + 1;
+
+		std::size_t split_axis = dimensions+1, split_edge = 0, split_index = 0;
+		Accum split_margin = 0;
+
+		assert(distribution_count > 0);
+		assert(min_child_items + distribution_count-1 <= n_items);
+
+		RStarSplitSweep<typename Node::item_type, Node::node_capacity> sweep;
+		sweep.Load(node->items);
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			Accum margin = 0;
+			Accum overlap = 0, dist_area, dist_overlap;
+			std::size_t dist_edge = 0, dist_index = 0;
+
+			dist_area = dist_overlap = std::numeric_limits<Accum>::max();
+
+			for (std::size_t edge = 0; edge < 2; edge++)
+			{
+				sweep.Sort(axis, edge);
+				sweep.Sweep(min_child_items, min_child_items + distribution_count - 1);
+
+				for (std::size_t k = 0; k < distribution_count; k++)
+				{
+					Accum area = 0;
+
+					// R2 empieza en min_child_items+k+1, como siempre lo hizo
+					const BoundingBox &R1 = sweep.prefix[min_child_items+k];
+					const BoundingBox &R2 = sweep.suffix[min_child_items+k+1];
+
+					margin 	+= R1.edgeDeltas() + R2.edgeDeltas();
+					area 	+= R1.area() + R2.area();
+					overlap =  R1.overlap(R2);
+
+					if (overlap < dist_overlap || (overlap == dist_overlap && area < dist_area))
+					{
+						dist_edge = 	edge;
+						dist_index = 	min_child_items+k;
+						dist_overlap = 	overlap;
+						dist_area = 	area;
+					}
+				}
+			}
+
+			if (split_axis == dimensions+1 || split_margin > margin )
+			{
+				split_axis 		= axis;
+				split_margin 	= margin;
+				split_edge 		= dist_edge;
+				split_index 	= dist_index;
+			}
+		}
+
+		if (split_edge == 0)
+			sweep.Sort(split_axis, 0);
+
+		else if (split_axis != dimensions-1)
+			sweep.Sort(split_axis, 1);
+
+		sweep.Apply(node->items);
+		return split_index;
+	}
+
+	// los hijos cuyo centro esta mas lejos del centro del nodo
+	template <typename Node>
+	static std::size_t Reinsert(Node * node)
+	{
+		if (!reinsert_percent)
+			return 0;
+
+		const std::size_t n_items = node->items.size();
+		const std::size_t share = (std::size_t)((double)n_items * (reinsert_percent / 100.0));
+		const std::size_t p = share > 0 ? share : 1;
+
+		std::partial_sort(node->items.begin(), node->items.end() - p, node->items.end(),
+			SortBoundedItemsByDistanceFromCenter<typename Node::item_type>(&node->bound));
+
+		return p;
+	}
+};
+
+
+// Reparto de Guttman (1984): dos semillas y el resto de los hijos uno a uno
+// al grupo que menos se amplia. Comun a los splits lineal y cuadratico.
+template <typename Node>
+struct RStarGuttmanSplit {
+
+	typedef typename Node::BoundingBox			BoundingBox;
+	typedef typename BoundingBox::accum_type	Accum;
+
+	std::size_t n;
+	BoundingBox boxes[Node::node_capacity];
+	unsigned char group[Node::node_capacity];
+
+	explicit RStarGuttmanSplit(const Node * node) : n(node->items.size())
+	{
+		for (std::size_t i = 0; i < n; i++)
+		{
+			boxes[i] = node->items[i]->bound;
+			group[i] = 0;
+		}
+	}
+
+	static Accum Enlargement(const BoundingBox &cover, const BoundingBox &box)
+	{
+		BoundingBox enlarged = cover;
+		enlarged.stretch(box);
+		return enlarged.area() - cover.area();
+	}
+
+	// el par que mas area desperdicia juntos
+	void QuadraticSeeds(std::size_t &s1, std::size_t &s2) const
+	{
+		Accum worst = -std::numeric_limits<Accum>::max();
+		s1 = 0, s2 = 1;
+
+		for (std::size_t i = 0; i < n; i++)
+		{
+			const Accum area = boxes[i].area();
+
+			for (std::size_t j = i + 1; j < n; j++)
+			{
+				BoundingBox joined = boxes[i];
+				joined.stretch(boxes[j]);
+
+				const Accum waste = joined.area() - area - boxes[j].area();
+				if (waste > worst)
+				{
+					worst = waste;
+					s1 = i, s2 = j;
+				}
+			}
+		}
+	}
+
+	// el par mas separado en algun eje, relativo al ancho de todos: el de
+	// mayor borde inferior y, entre los demas, el de menor borde superior
+	void LinearSeeds(std::size_t &s1, std::size_t &s2) const
+	{
+		const std::size_t dimensions = Node::node_dimensions;
+		Accum best = -std::numeric_limits<Accum>::max();
+		s1 = 0, s2 = 1;
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			std::size_t high = 0;
+			Accum lowest = boxes[0].edges[axis].first, highest = boxes[0].edges[axis].second;
+
+			for (std::size_t i = 1; i < n; i++)
+			{
+				if (boxes[i].edges[axis].first > boxes[high].edges[axis].first)
+					high = i;
+				lowest  = std::min<Accum>(lowest, boxes[i].edges[axis].first);
+				highest = std::max<Accum>(highest, boxes[i].edges[axis].second);
+			}
+
+			std::size_t low = high == 0 ? 1 : 0;
+			for (std::size_t i = 0; i < n; i++)
+				if (i != high && boxes[i].edges[axis].second < boxes[low].edges[axis].second)
+					low = i;
+
+			Accum separation = (Accum)boxes[high].edges[axis].first - (Accum)boxes[low].edges[axis].second;
+			if (highest > lowest)
+				separation /= highest - lowest;
+
+			if (separation > best)
+			{
+				best = separation;
+				s1 = low, s2 = high;
+			}
+		}
+	}
+
+	// reparte desde las semillas; con pickNext (cuadratico) va primero el
+	// hijo con mas preferencia por un grupo, si no en orden. Un grupo que
+	// necesita todos los que quedan para llegar a min_child_items se los
+	// lleva. Deja el grupo 1 al principio de node->items
+	std::size_t Distribute(Node * node, std::size_t min_child_items, std::size_t s1, std::size_t s2, bool pickNext)
+	{
+		BoundingBox cover[2] = { boxes[s1], boxes[s2] };
+		std::size_t count[2] = { 1, 1 };
+
+		group[s1] = 1;
+		group[s2] = 2;
+
+		for (std::size_t remaining = n - 2; remaining > 0; remaining--)
+		{
+			std::size_t g;
+
+			if (count[0] + remaining == min_child_items)
+				g = 0;
+			else if (count[1] + remaining == min_child_items)
+				g = 1;
+			else
+			{
+				std::size_t next = n;
+				Accum d[2] = { 0, 0 }, preference = -1;
+
+				for (std::size_t i = 0; i < n; i++)
+				{
+					if (group[i])
+						continue;
+
+					const Accum d0 = Enlargement(cover[0], boxes[i]);
+					const Accum d1 = Enlargement(cover[1], boxes[i]);
+					const Accum diff = d0 > d1 ? d0 - d1 : d1 - d0;
+
+					if (diff > preference)
+					{
+						next = i;
+						d[0] = d0, d[1] = d1;
+						preference = diff;
+					}
+
+					if (!pickNext)
+						break;
+				}
+
+				// menor ampliacion, luego menor area, luego menos hijos
+				if (d[0] != d[1])
+					g = d[0] < d[1] ? 0 : 1;
+				else if (cover[0].area() != cover[1].area())
+					g = cover[0].area() < cover[1].area() ? 0 : 1;
+				else
+					g = count[0] <= count[1] ? 0 : 1;
+
+				group[next] = (unsigned char)(g + 1);
+				cover[g].stretch(boxes[next]);
+				count[g]++;
+				continue;
+			}
+
+			// el resto al grupo g
+			for (std::size_t i = 0; i < n; i++)
+				if (!group[i])
+				{
+					group[i] = (unsigned char)(g + 1);
+					count[g]++;
+				}
+			break;
+		}
+
+		typename Node::item_type * items[Node::node_capacity];
+		std::size_t first = 0, second = count[0];
+
+		for (std::size_t i = 0; i < n; i++)
+			items[group[i] == 1 ? first++ : second++] = node->items[i];
+
+		std::copy(items, items + n, node->items.begin());
+		return count[0];
+	}
+};
+
+// Guttman: hijo de menor ampliacion de area (empates por area), sin
+// reinsercion
+struct RStarStrategyGuttman {
+
+	template <typename Node, typename BoundingBox>
+	static std::size_t ChooseSubtree(const Node * node, const BoundingBox &bound)
+	{
+		typedef RStarChooseCost<BoundingBox> Cost;
+
+		Cost best, cost;
+		best.Set(0, node->items[0]->bound, bound);
+
+		for (std::size_t i = 1; i < node->items.size(); i++)
+		{
+			cost.Set(i, node->items[i]->bound, bound);
+			if (Cost::ByEnlargement(cost, best))
+				best = cost;
+		}
+
+		return best.index;
+	}
+
+	template <typename Node>
+	static std::size_t Reinsert(Node *)
+	{
+		return 0;
+	}
+};
+
+// Split cuadratico de Guttman: O(M^2) por split
+struct RStarStrategyQuadratic : RStarStrategyGuttman {
+
+	template <std::size_t min_child_items, typename Node>
+	static std::size_t Split(Node * node)
+	{
+		RStarGuttmanSplit<Node> split(node);
+		std::size_t s1, s2;
+
+		split.QuadraticSeeds(s1, s2);
+		return split.Distribute(node, min_child_items, s1, s2, true);
+	}
+};
+
+// Split lineal de Guttman: O(M) por split, el mas barato de construir
+struct RStarStrategyLinear : RStarStrategyGuttman {
+
+	template <std::size_t min_child_items, typename Node>
+	static std::size_t Split(Node * node)
+	{
+		RStarGuttmanSplit<Node> split(node);
+		std::size_t s1, s2;
+
+		split.LinearSeeds(s1, s2);
+		return split.Distribute(node, min_child_items, s1, s2, false);
+	}
+};
+
+
+// Clave de Hilbert del centro de una caja en una grilla sobre frame
+template <typename BoundingBox, std::size_t dimensions>
+struct RStarHilbertGrid {
+
+	double low[dimensions], scale[dimensions];
+	unsigned bits;
+
+	explicit RStarHilbertGrid(const BoundingBox &frame)
+	{
+		bits = (unsigned)std::max<std::size_t>(1, std::min<std::size_t>(32, 64 / dimensions));
+		const double cells = std::ldexp(1.0, bits) - 1.0;
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const double lo = (double)frame.edges[axis].first, hi = (double)frame.edges[axis].second;
+			low[axis] = lo;
+			scale[axis] = hi > lo ? cells / (hi - lo) : 0.0;
+		}
+	}
+
+	uint64_t Key(const BoundingBox &box) const
+	{
+		uint32_t x[dimensions];
+
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+		{
+			const double center = ((double)box.edges[axis].first + (double)box.edges[axis].second) / 2.0;
+			x[axis] = (uint32_t)((center - low[axis]) * scale[axis]);
+		}
+
+		return RStarHilbertKey<dimensions>(x, bits);
+	}
+};
+
+// Orden de Hilbert de los centros, en una grilla sobre el bound del nodo:
+// el split corta la secuencia ordenada donde los dos grupos suman menos
+// margen (cortar donde menos se solapan da nodos alargados). Se baja como
+// en Guttman y no hay reinsercion.
+struct RStarStrategyHilbert : RStarStrategyGuttman {
+
+	template <std::size_t min_child_items, typename Node>
+	static std::size_t Split(Node * node)
+	{
+		typedef typename Node::BoundingBox			BoundingBox;
+		typedef typename BoundingBox::accum_type	Accum;
+		typedef std::pair<uint64_t, std::size_t>	Keyed;
+
+		const std::size_t n = node->items.size();
+		RStarSplitSweep<typename Node::item_type, Node::node_capacity> sweep;
+		sweep.Load(node->items);
+
+		const RStarHilbertGrid<BoundingBox, Node::node_dimensions> grid(node->bound);
+		Keyed keyed[Node::node_capacity];
+
+		for (std::size_t i = 0; i < n; i++)
+			keyed[i] = Keyed(grid.Key(sweep.boxes[i]), i);
+
+		std::sort(keyed, keyed + n);
+
+		for (std::size_t i = 0; i < n; i++)
+			sweep.order[i] = keyed[i].second;
+
+		// prefix[j] y suffix[j] son los dos grupos cortando en j
+		sweep.Sweep(min_child_items - 1, n - min_child_items);
+
+		std::size_t split_index = min_child_items;
+		Accum best_margin = std::numeric_limits<Accum>::max(), best_overlap = best_margin;
+
+		for (std::size_t j = min_child_items; j <= n - min_child_items; j++)
+		{
+			const Accum margin = sweep.prefix[j].edgeDeltas() + sweep.suffix[j].edgeDeltas();
+			const Accum overlap = sweep.prefix[j].overlap(sweep.suffix[j]);
+
+			if (margin < best_margin || (margin == best_margin && overlap < best_overlap))
+			{
+				split_index = j;
+				best_margin = margin;
+				best_overlap = overlap;
+			}
+		}
+
+		sweep.Apply(node->items);
+		return split_index;
+	}
+};
+
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef RSTARTHREADPOOL_H
+#define RSTARTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+// Pool de hilos reutilizable con robo de trabajo. ParallelFor reparte
+// [0, n) en un rango por hilo; cada hilo consume su rango de a `grain`
+// indices y, al vaciarse, roba la mitad del rango mas grande que quede.
+// El hilo que llama participa como worker 0. Una llamada a la vez.
+class RStarThreadPool {
+public:
+
+	// threads == 0 usa todos los cores
+	explicit RStarThreadPool(unsigned threads = 0) :
+		m_generation(0), m_running(0), m_stop(false)
+	{
+		if (!threads)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		m_ranges = std::vector<Range>(threads);
+
+		for (unsigned w = 1; w < threads; w++)
+			m_threads.push_back(std::thread(&RStarThreadPool::Loop, this, w));
+	}
+
+	~RStarThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+
+		for (std::size_t i = 0; i < m_threads.size(); i++)
+			m_threads[i].join();
+	}
+
+	// numero de workers, contando al hilo que llama
+	unsigned GetThreadCount() const
+	{
+		return (unsigned)m_ranges.size();
+	}
+
+	// llama a function(begin, end, worker) sobre trozos disjuntos de [0, n);
+	// worker < GetThreadCount() identifica al hilo
+	template <typename Function>
+	void ParallelFor(std::size_t n, std::size_t grain, Function function)
+	{
+		std::lock_guard<std::mutex> call(m_call);
+
+		const std::size_t workers = m_ranges.size();
+		m_grain = grain ? grain : 1;
+		m_job = function;
+
+		for (std::size_t w = 0; w < workers; w++)
+		{
+			m_ranges[w].begin = n * w / workers;
+			m_ranges[w].end   = n * (w+1) / workers;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_running = (unsigned)workers - 1;
+			m_generation++;
+		}
+		m_wake.notify_all();
+
+		Work(0);
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		while (m_running)
+			m_done.wait(lock);
+
+		m_job = Job();
+	}
+
+	// pool compartido para quien no quiera crear el suyo
+	static RStarThreadPool & Default()
+	{
+		static RStarThreadPool pool;
+		return pool;
+	}
+
+private:
+
+	typedef std::function<void (std::size_t, std::size_t, unsigned)> Job;
+
+	// un rango por linea de cache
+	struct Range {
+		std::mutex lock;
+		std::size_t begin, end;
+		char padding[64];
+
+		Range() : begin(0), end(0) {}
+		Range(const Range &) : begin(0), end(0) {}
+		Range & operator=(const Range &) { return *this; }
+	};
+
+	RStarThreadPool(const RStarThreadPool &);
+	RStarThreadPool & operator=(const RStarThreadPool &);
+
+	void Loop(unsigned worker)
+	{
+		unsigned long seen = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_lock);
+				while (!m_stop && m_generation == seen)
+					m_wake.wait(lock);
+
+				if (m_stop)
+					return;
+
+				seen = m_generation;
+			}
+
+			Work(worker);
+
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (--m_running == 0)
+				m_done.notify_one();
+		}
+	}
+
+	void Work(unsigned worker)
+	{
+		std::size_t begin, end;
+
+		while (Take(worker, begin, end) || Steal(worker, begin, end))
+			m_job(begin, end, worker);
+	}
+
+	bool Take(unsigned worker, std::size_t &begin, std::size_t &end)
+	{
+		Range &range = m_ranges[worker];
+		std::lock_guard<std::mutex> lock(range.lock);
+
+		if (range.begin == range.end)
+			return false;
+
+		begin = range.begin;
+		end = std::min(range.end, begin + m_grain);
+		range.begin = end;
+		return true;
+	}
+
+	// toma la mitad final del rango mas grande de otro worker; lo que no
+	// cabe en un trozo queda en el rango propio para que otros lo roben
+	bool Steal(unsigned worker, std::size_t &begin, std::size_t &end)
+	{
+		const std::size_t workers = m_ranges.size();
+
+		for (;;)
+		{
+			std::size_t victim = workers, largest = 0;
+
+			for (std::size_t i = 1; i < workers; i++)
+			{
+				const std::size_t w = (worker + i) % workers;
+				std::lock_guard<std::mutex> lock(m_ranges[w].lock);
+
+				if (m_ranges[w].end - m_ranges[w].begin > largest)
+				{
+					largest = m_ranges[w].end - m_ranges[w].begin;
+					victim = w;
+				}
+			}
+
+			if (victim == workers)
+				return false;
+
+			{
+				Range &range = m_ranges[victim];
+				std::lock_guard<std::mutex> lock(range.lock);
+
+				// pudo vaciarse entre medias
+				if (range.begin == range.end)
+					continue;
+
+				begin = range.begin + (range.end - range.begin) / 2;
+				end = range.end;
+				range.end = begin;
+			}
+
+			if (end - begin > m_grain)
+			{
+				Range &own = m_ranges[worker];
+				std::lock_guard<std::mutex> lock(own.lock);
+				own.begin = begin + m_grain;
+				own.end = end;
+				end = own.begin;
+			}
+
+			return true;
+		}
+	}
+
+	std::vector<Range> m_ranges;
+	std::vector<std::thread> m_threads;
+
+	Job m_job;
+	std::size_t m_grain;
+
+	std::mutex m_call;
+	std::mutex m_lock;
+	std::condition_variable m_wake, m_done;
+	unsigned long m_generation;
+	unsigned m_running;
+	bool m_stop;
+};
+
+
+#endif
@@ -7,435 +7,1562 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <type_traits>
+#include <iterator>
+#include <cstddef>
 
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 
 #include "RStarBoundingBox.h"
+#include "RStarNode.h"
+#include "RStarAllocator.h"
+#include "RStarBulkLoad.h"
+#include "RStarNearest.h"
+#include "RStarRay.h"
+#include "RStarEpoch.h"
+#include "RStarThreadPool.h"
+#include "RStarFile.h"
+#include "RStarStrategy.h"
+#include "RStarLocator.h"
+#include "RStarJoin.h"
+#include "RStarStats.h"
 
-// R* tree parametros
-#define RTREE_REINSERT_P 0.30
-#define RTREE_CHOOSE_SUBTREE_P 32
+// consultas que toma cada worker de QueryBatch de una vez
+#define RSTAR_BATCH_GRAIN 16
 
 #define RSTAR_TEMPLATE 
 
-template <typename BoundedItem, typename LeafType>
-struct RStarLeaf : BoundedItem {
-	
-	typedef LeafType leaf_type;
-	LeafType leaf;
-};
-
-template <typename BoundedItem>
-struct RStarNode : BoundedItem {
-	std::vector< BoundedItem* > items;
-	bool hasLeaves;
-};
-
 #include "RStarVisitor.h"
 
 template <
 	typename LeafType, 
-	std::size_t dimensions, std::size_t min_child_items, std::size_t max_child_items
+	std::size_t dimensions, std::size_t min_child_items, std::size_t max_child_items,
+	typename Coord = int,
+	template <typename, typename> class Allocator = RStarPoolAllocator,
+	template <typename, typename> class Locator = RStarNoLocator,
+	typename Strategy = RStarStrategyRStar<>,
+	typename Aggregate = RStarNoAggregate
 >
 class RStarTree {
 public:
 
-	typedef RStarBoundedItem<dimensions>		BoundedItem;
+	typedef RStarBoundedItem<dimensions, Coord>	BoundedItem;
 	typedef typename BoundedItem::BoundingBox	BoundingBox;
+	typedef typename BoundingBox::accum_type	Accum;
+	typedef RStarPoint<dimensions>				Point;
+	
+	typedef typename Aggregate::value_type		AggregateValue;
 	
-	typedef RStarNode<BoundedItem> 				Node;
+	typedef RStarNode<BoundedItem, dimensions, max_child_items + 1, AggregateValue>	Node;
 	typedef RStarLeaf<BoundedItem, LeafType> 	Leaf;
 	
+	typedef Allocator<Node, Leaf>				NodeAllocator;
+	typedef Locator<LeafType, Leaf>				LeafLocator;
+	
 	typedef RStarAcceptOverlapping<Node, Leaf>	AcceptOverlapping;
 	typedef RStarAcceptEnclosing<Node, Leaf>	AcceptEnclosing;
 	typedef RStarAcceptAny<Node, Leaf>			AcceptAny;
+	typedef RStarAcceptContaining<Node, Leaf>	AcceptContaining;
 
 	typedef RStarRemoveLeaf<Leaf>				RemoveLeaf;
 	typedef RStarRemoveSpecificLeaf<Leaf>		RemoveSpecificLeaf;
+	typedef RStarRemoveThisLeaf<Leaf>			RemoveThisLeaf;
+	
+	typedef RStarNearestBuffer<BoundedItem>		NearestBuffer;
 	
-	RStarTree() : m_root(NULL), m_size(0)
+	typedef RStarRay<dimensions>				Ray;
+	typedef RStarRayPacket<dimensions>			RayPacket;
+	typedef RStarRayPacketBuffer<BoundedItem>	RayPacketBuffer;
+	
+	RStarTree() : m_root(NULL), m_size(0), m_published(NULL), m_version(0), m_tagged(0), m_shared(false), m_autoPublish(true)
+	{
+		assert(1 <= min_child_items && min_child_items <= max_child_items/2);
+	}
+	
+	template <typename Iterator>
+	RStarTree(Iterator first, Iterator last, double fill = 1.0) : m_root(NULL), m_size(0), m_published(NULL), m_version(0), m_tagged(0), m_shared(false), m_autoPublish(true)
 	{
 		assert(1 <= min_child_items && min_child_items <= max_child_items/2);
+		BulkLoad(first, last, fill);
 	}
 	
+	// no debe quedar ningun Snapshot vivo
     ~RStarTree() {
-		Remove(
-			AcceptAny(), 
-			RemoveLeaf()
-		);
+		for (std::size_t i = 0; i < m_retired.size(); i++)
+			Free(m_retired[i]);
+		
+		m_retired.clear();
+		m_shared = false;
+		Clear();
+	}
+	
+	// libera todos los nodos y hojas; con un allocator de slabs y tipos
+	// triviales no hace falta recorrer el arbol
+	void Clear()
+	{
+		Discard();
+		Modified();
 	}
 	
 	void Insert(LeafType leaf, const BoundingBox &bound)
 	{
 
-		Leaf * newLeaf = new Leaf();
+		Leaf * newLeaf = m_allocator.NewLeaf();
 		newLeaf->bound = bound;
 		newLeaf->leaf  = leaf;
+		m_locator.Add(newLeaf);
 
 		if (!m_root)
 		{
-			m_root = new Node();
+			m_root = NewNode();
 			m_root->hasLeaves = true;
 			
 			m_root->items.reserve(min_child_items);
 			m_root->items.push_back(newLeaf);
 			m_root->bound = bound;
+			m_root->Sync();
+			Summarize(m_root);
 		}
 		else
+		{
+			m_root = Writable(m_root);
 			InsertInternal(newLeaf, m_root);
+		}
 			
 		m_size += 1;
+		Modified();
 	}
 
-	template <typename Acceptor, typename Visitor>
-	Visitor Query(const Acceptor &accept, Visitor visitor)
+	// Construye un arbol empaquetado a partir de [first, last), que recorre
+	// pares (LeafType, BoundingBox). Reemplaza el contenido actual. Los nodos
+	// se llenan hasta fill * max_child_items, sin bajar de min_child_items
+	// fuera de la raiz; threads == 0 usa todos los cores.
+	template <typename Iterator>
+	void BulkLoad(Iterator first, Iterator last, double fill = 1.0,
+		RStarBulkOrder order = RSTAR_BULK_STR, unsigned threads = 0)
 	{
-		if (m_root)
-		{	
-			QueryFunctor<Acceptor, Visitor> query(accept, visitor);
-			query(m_root);
+		Discard();
+		
+		std::vector< BoundedItem* > items;
+		for (; first != last; ++first)
+		{
+			Leaf * newLeaf = m_allocator.NewLeaf();
+			newLeaf->bound = first->second;
+			newLeaf->leaf  = first->first;
+			m_locator.Add(newLeaf);
+			items.push_back(newLeaf);
 		}
 		
-		return visitor;
+		if (items.empty())
+		{
+			Modified();
+			return;
+		}
+		
+		m_size = items.size();
+		
+		std::size_t height;
+		m_root = Pack(items, fill, order, threads, height);
+		Modified();
 	}
-
-	template <typename Acceptor, typename LeafRemover>
-	void Remove( const Acceptor &accept, LeafRemover leafRemover)
+	
+	// Agrega [first, last) sin insertar uno a uno: empaqueta el lote como
+	// BulkLoad y cuelga los subarboles resultantes al nivel que les toca,
+	// eligiendo el padre por ampliacion como ChooseSubtree. Solo se parten
+	// los nodos del camino de cada injerto; no hay reinserciones.
+	template <typename Iterator>
+	void InsertBatch(Iterator first, Iterator last, double fill = 1.0,
+		RStarBulkOrder order = RSTAR_BULK_STR, unsigned threads = 0)
 	{
-		std::list<Leaf*> itemsToReinsert;
-
-		if (!m_root)
+		if (!m_size)
+		{
+			BulkLoad(first, last, fill, order, threads);
 			return;
+		}
 		
-		RemoveFunctor<Acceptor, LeafRemover> remove(accept, leafRemover, &itemsToReinsert, &m_size);
-		remove(m_root, true);
-		
-		if (!itemsToReinsert.empty())
+		std::vector< BoundedItem* > items;
+		for (; first != last; ++first)
 		{
-			typename std::list< Leaf* >::iterator it = itemsToReinsert.begin();
-			typename std::list< Leaf* >::iterator end = itemsToReinsert.end();
+			Leaf * newLeaf = m_allocator.NewLeaf();
+			newLeaf->bound = first->second;
+			newLeaf->leaf  = first->first;
+			m_locator.Add(newLeaf);
+			items.push_back(newLeaf);
+		}
 		
-			for(;it != end; it++)
-				InsertInternal(*it, m_root);
+		if (!items.empty())
+		{
+			m_size += items.size();
+			
+			std::size_t height;
+			Node * batch = Pack(items, fill, order, threads, height);
+			Graft(batch, height);
 		}
+		
+		Modified();
 	}
 	
-	void RemoveBoundedArea( const BoundingBox &bound )
+	// Mueve todo el contenido de other a este arbol injertandolo como en
+	// InsertBatch; los nodos se reutilizan, no se copian. other queda vacio
+	// y no debe tener lectores.
+	void Merge(RStarTree &&other)
 	{
-		Remove(AcceptEnclosing(bound), RemoveLeaf());
+		if (&other == this)
+			return;
+		
+		for (std::size_t i = 0; i < other.m_retired.size(); i++)
+			other.Free(other.m_retired[i]);
+		
+		other.m_retired.clear();
+		other.m_tagged = 0;
+		
+		Node * root = other.m_root;
+		const std::size_t size = other.m_size;
+		
+		other.m_root = NULL;
+		other.m_size = 0;
+		other.m_published.store(NULL);
+		
+		// si este arbol esta vacio se descarta antes de recibir los slabs
+		// de other: Discard libera todo lo del allocator
+		if (!m_size)
+			Discard();
+		
+		m_allocator.Adopt(other.m_allocator);
+		m_locator.Adopt(other.m_locator);
+		
+		if (!size)
+		{
+			if (root)
+				DisposeNode(root);
+		}
+		else
+		{
+			// las versiones de other no significan nada aqui
+			Restamp(root);
+			
+			if (!m_root)
+				m_root = root;
+			else
+				Graft(root, Height(root));
+			
+			m_size += size;
+		}
+		
+		Modified();
 	}
-	
-	void RemoveItem( const LeafType &item, bool removeDuplicates = true )
+
+	template <typename Acceptor, typename Visitor>
+	Visitor Query(const Acceptor &accept, Visitor visitor)
 	{
-		Remove( AcceptAny(), RemoveSpecificLeaf(item, removeDuplicates));
+		return QueryInternal(m_root, accept, visitor);
+	}
+
+	// k vecinos mas cercanos a point, best-first por MINDIST. El visitor se
+	// llama como visitor(leaf, distancia al cuadrado) en orden creciente de
+	// distancia, hasta k hojas o hasta que ContinueVisiting sea false.
+	template <typename Visitor>
+	Visitor QueryNearest(const Point &point, std::size_t k, Visitor visitor, NearestBuffer &buffer)
+	{
+		return QueryNearestInternal(m_root, point, k, visitor, buffer);
 	}
 	
+	template <typename Visitor>
+	Visitor QueryNearest(const Point &point, std::size_t k, Visitor visitor)
+	{
+		NearestBuffer buffer;
+		return QueryNearest(point, k, visitor, buffer);
+	}
 	
-	std::size_t GetSize() const { return m_size; }
-	std::size_t GetDimensions() const { return dimensions; }
-	
-	
-protected:
-	
-	Node * ChooseSubtree(Node * node, const BoundingBox * bound)
+	// Hojas cuya caja corta ray (o un Ray::Segment), de adelante hacia
+	// atras: el visitor se llama como visitor(leaf, t de entrada) en orden
+	// creciente de t, hasta k hojas o hasta que ContinueVisiting sea false.
+	// Con k = 1 es el primer hit y poda todo lo que esta detras. Solo se
+	// prueban las cajas; la geometria exacta queda para el visitor, que
+	// puede seguir hasta encontrar un hit real.
+	template <typename Visitor>
+	Visitor QueryRay(const Ray &ray, std::size_t k, Visitor visitor, NearestBuffer &buffer)
 	{
-		if (static_cast<Node*>(node->items[0])->hasLeaves)
-		{
-			if (max_child_items > (RTREE_CHOOSE_SUBTREE_P*2)/3  && node->items.size() > RTREE_CHOOSE_SUBTREE_P)
-			{
-				std::partial_sort( node->items.begin(), node->items.begin() + RTREE_CHOOSE_SUBTREE_P, node->items.end(),
-					SortBoundedItemsByAreaEnlargement<BoundedItem>(bound));
-				
-				return static_cast<Node*>(* std::min_element(node->items.begin(), node->items.begin() + RTREE_CHOOSE_SUBTREE_P,
-					SortBoundedItemsByOverlapEnlargement<BoundedItem>(bound)));
-			}
-			
-			return static_cast<Node*>(* std::min_element(node->items.begin(), node->items.end(),
-				SortBoundedItemsByOverlapEnlargement<BoundedItem>(bound)));	
-		}
-
-		return static_cast<Node*>(*	std::min_element( node->items.begin(), node->items.end(),
-				SortBoundedItemsByAreaEnlargement<BoundedItem>(bound)));
+		return QueryRayInternal(m_root, ray, k, visitor, buffer);
 	}
 	
-    Node * InsertInternal(Leaf * leaf, Node * node, bool firstInsert = true)
+	template <typename Visitor>
+	Visitor QueryRay(const Ray &ray, std::size_t k, Visitor visitor)
 	{
-		node->bound.stretch(leaf->bound);
+		NearestBuffer buffer;
+		return QueryRay(ray, k, visitor, buffer);
+	}
 	
-        if (node->hasLeaves)
-		{
-			node->items.push_back(leaf);
-		}else{
-            Node * tmp_node = InsertInternal( leaf, ChooseSubtree(node, &leaf->bound), firstInsert );
-			
-			if (!tmp_node)
-				return NULL;
-				
-			node->items.push_back(tmp_node);
-		}
-
-        if (node->items.size() > max_child_items )
-		{
-			
-			return OverflowTreatment(node, firstInsert);
-		}
-			
-		return NULL;
+	// QueryRay de count rayos que recorren el arbol juntos, de a
+	// RSTAR_RAY_PACKET, con el slab test de cada caja hecho para todo el
+	// paquete con SIMD. Conviene para rayos coherentes (mismo origen o
+	// direcciones parecidas), que bajan por los mismos nodos. El visitor se
+	// llama como visitor(indice del rayo, leaf, t); cada rayo ve sus hojas
+	// en orden creciente de t, hasta k, y ContinueVisiting en false corta
+	// todos.
+	template <typename Visitor>
+	Visitor QueryRayPacket(const Ray * rays, std::size_t count, std::size_t k, Visitor visitor, RayPacketBuffer &buffer)
+	{
+		return QueryRayPacketInternal(m_root, rays, count, k, visitor, buffer);
 	}
 	
-	Node * OverflowTreatment(Node * level, bool firstInsert)
+	template <typename Visitor>
+	Visitor QueryRayPacket(const Ray * rays, std::size_t count, std::size_t k, Visitor visitor)
 	{
+		RayPacketBuffer buffer;
+		return QueryRayPacket(rays, count, k, visitor, buffer);
+	}
 
-		if (level != m_root && firstInsert)
-		{
-			Reinsert(level);
-			return NULL;
-		}
+	// Consulta perezosa: produce las hojas aceptadas de a una, con una pila
+	// explicita, sin reservar memoria despues de construirse. Para despues
+	// de `limit` hojas; Resume(n) habilita las n siguientes, para paginar.
+	// El Acceptor se guarda por copia, pero la caja a la que apunta debe
+	// seguir viva, y el arbol no debe cambiar mientras se usa el cursor.
+	template <typename Acceptor>
+	class Cursor {
+	public:
 		
-		Node * splitItem = Split(level);
+		class iterator {
+		public:
+			typedef std::input_iterator_tag	iterator_category;
+			typedef const Leaf *			value_type;
+			typedef std::ptrdiff_t			difference_type;
+			typedef const Leaf * const *	pointer;
+			typedef const Leaf * const &	reference;
+			
+			iterator() : m_cursor(NULL), m_leaf(NULL) {}
+			explicit iterator(Cursor * cursor) : m_cursor(cursor), m_leaf(cursor->Next()) {}
+			
+			const Leaf * operator*() const { return m_leaf; }
+			const Leaf * operator->() const { return m_leaf; }
+			
+			iterator & operator++()
+			{
+				m_leaf = m_cursor->Next();
+				return *this;
+			}
+			
+			bool operator==(const iterator &it) const { return m_leaf == it.m_leaf; }
+			bool operator!=(const iterator &it) const { return m_leaf != it.m_leaf; }
+			
+		private:
+			Cursor * m_cursor;
+			const Leaf * m_leaf;
+		};
 		
-		if (level == m_root)
+		Cursor(const Node * root, const Acceptor &accept, std::size_t limit = std::numeric_limits<std::size_t>::max()) :
+			m_accept(accept), m_produced(0), m_limit(limit)
 		{
-			Node * newRoot = new Node();
-			newRoot->hasLeaves = false;
+			if (!root)
+				return;
 			
-			newRoot->items.reserve(min_child_items);
-			newRoot->items.push_back(m_root);
-			newRoot->items.push_back(splitItem);
+			m_stack.reserve(Height(root));
 			
-			newRoot->bound.reset();
-			for_each(newRoot->items.begin(), newRoot->items.end(), StretchBoundingBox<BoundedItem>(&newRoot->bound));
+			const bool accepted = accept(root);
+			RSTAR_COUNT_ACCEPT(1, accepted);
 			
-			m_root = newRoot;
-			return NULL;
+			if (accepted)
+				Push(root);
 		}
-		return splitItem;
-	}
-
-	Node * Split(Node * node)
-	{
-		Node * newNode = new Node();
-		newNode->hasLeaves = node->hasLeaves;
-
-		const std::size_t n_items = node->items.size();
-		const std::size_t distribution_count = n_items - 2*min_child_items + 1;
-		
-		std::size_t split_axis = dimensions+1, split_edge = 0, split_index = 0;
-		int split_margin = 0;
 		
-		BoundingBox R1, R2;
-
-		assert(n_items == max_child_items + 1);
-		assert(distribution_count > 0);
-		assert(min_child_items + distribution_count-1 <= n_items);
-		
-		for (std::size_t axis = 0; axis < dimensions; axis++)
+		// siguiente hoja, o NULL si no quedan o se llego al limite
+		const Leaf * Next()
 		{
-			int margin = 0;
-			double overlap = 0, dist_area, dist_overlap;
-			std::size_t dist_edge = 0, dist_index = 0;
-		
-			dist_area = dist_overlap = std::numeric_limits<double>::max();
+			if (m_produced >= m_limit)
+				return NULL;
 			
-			for (std::size_t edge = 0; edge < 2; edge++)
+			while (!m_stack.empty())
 			{
-				if (edge == 0)
-					std::sort(node->items.begin(), node->items.end(), SortBoundedItemsByFirstEdge<BoundedItem>(axis));
-				else
-					std::sort(node->items.begin(), node->items.end(), SortBoundedItemsBySecondEdge<BoundedItem>(axis));
-
-				for (std::size_t k = 0; k < distribution_count; k++)
-		        {
-					double area = 0;
+				Frame &top = m_stack.back();
+				const std::size_t i = top.hits.next(top.next);
 				
-					R1.reset();
-					for_each(node->items.begin(), node->items.begin()+(min_child_items+k), StretchBoundingBox<BoundedItem>(&R1));
-							
-					R2.reset();
-					for_each(node->items.begin()+(min_child_items+k+1), node->items.end(), StretchBoundingBox<BoundedItem>(&R2));
-
-                    margin 	+= R1.edgeDeltas() + R2.edgeDeltas();
-					area 	+= R1.area() + R2.area();
-					overlap =  R1.overlap(R2);
-					
-
-					if (overlap < dist_overlap || (overlap == dist_overlap && area < dist_area))
-					{
-						dist_edge = 	edge;
-						dist_index = 	min_child_items+k;
-						dist_overlap = 	overlap;
-						dist_area = 	area;
-					}		
+				if (i >= top.node->items.size())
+				{
+					m_stack.pop_back();
+					continue;
+				}
+				
+				top.next = i + 1;
+				
+				if (top.node->hasLeaves)
+				{
+					m_produced++;
+					return static_cast<const Leaf*>(top.node->items[i]);
 				}
+				
+				Push(static_cast<const Node*>(top.node->items[i]));
 			}
 			
-			if (split_axis == dimensions+1 || split_margin > margin )
-			{
-				split_axis 		= axis;
-				split_margin 	= margin;
-				split_edge 		= dist_edge;
-				split_index 	= dist_index;
-			}
+			return NULL;
 		}
-	
-		if (split_edge == 0)
-			std::sort(node->items.begin(), node->items.end(), SortBoundedItemsByFirstEdge<BoundedItem>(split_axis));
-
-		else if (split_axis != dimensions-1)
-			std::sort(node->items.begin(), node->items.end(), SortBoundedItemsBySecondEdge<BoundedItem>(split_axis));	
 		
-		newNode->items.assign(node->items.begin() + split_index, node->items.end());
-		node->items.erase(node->items.begin() + split_index, node->items.end());
+		// permite `limit` hojas mas a partir de la posicion actual
+		void Resume(std::size_t limit)
+		{
+			m_limit = limit > std::numeric_limits<std::size_t>::max() - m_produced ? 
+				std::numeric_limits<std::size_t>::max() : m_produced + limit;
+		}
 		
-		node->bound.reset();
-		std::for_each(node->items.begin(), node->items.end(), StretchBoundingBox<BoundedItem>(&node->bound));
+		bool Done() const { return m_stack.empty(); }
+		std::size_t GetProduced() const { return m_produced; }
 		
-		newNode->bound.reset();
-		std::for_each(newNode->items.begin(), newNode->items.end(), StretchBoundingBox<BoundedItem>(&newNode->bound));
+		iterator begin() { return iterator(this); }
+		iterator end() { return iterator(); }
 		
-		return newNode;
-	}
-
-	void Reinsert(Node * node)
-	{
-		std::vector< BoundedItem* > removed_items;
-
-		const std::size_t n_items = node->items.size();
-		const std::size_t p = (std::size_t)((double)n_items * RTREE_REINSERT_P) > 0 ? (std::size_t)((double)n_items * RTREE_REINSERT_P) : 1;
+	private:
 		
-		assert(n_items == max_child_items + 1);
+		struct Frame {
+			const Node * node;
+			typename Node::HitMask hits;
+			std::size_t next;
+		};
 		
-		std::partial_sort(node->items.begin(), node->items.end() - p, node->items.end(), 
-			SortBoundedItemsByDistanceFromCenter<BoundedItem>(&node->bound));
+		void Push(const Node * node)
+		{
+			Frame frame;
+			frame.node = node;
+			frame.next = 0;
+			RStarChildFilter<Acceptor, Node, Leaf>::Scan(m_accept, node, frame.hits);
 			
-		removed_items.assign(node->items.end() - p, node->items.end());
-		node->items.erase(node->items.end() - p, node->items.end());
-		
-		node->bound.reset();
-		for_each(node->items.begin(), node->items.end(), StretchBoundingBox<BoundedItem>(&node->bound));
+			RSTAR_COUNT_NODE(node->hasLeaves, node->items.size());
+			RSTAR_COUNT_ACCEPT(node->items.size(), frame.hits.count());
+			
+			m_stack.push_back(frame);
+		}
 		
-		for (typename std::vector< BoundedItem* >::iterator it = removed_items.begin(); it != removed_items.end(); it++)
-			InsertInternal( static_cast<Leaf*>(*it), m_root, false);
+		Acceptor m_accept;
+		std::vector<Frame> m_stack;
+		std::size_t m_produced, m_limit;
+	};
+	
+	template <typename Acceptor>
+	Cursor<Acceptor> QueryCursor(const Acceptor &accept, std::size_t limit = std::numeric_limits<std::size_t>::max()) const
+	{
+		return Cursor<Acceptor>(m_root, accept, limit);
+	}
+
+	// Una consulta por caja de bounds[0, count), repartidas en pool. Los
+	// resultados quedan en formato CSR: los de la consulta q son
+	// ids[offsets[q], offsets[q+1]). El arbol no debe modificarse mientras
+	// tanto (o usar Snapshot::QueryBatch).
+	template <typename Acceptor>
+	void QueryBatch(const BoundingBox * bounds, std::size_t count,
+		std::vector<std::size_t> &offsets, std::vector<LeafType> &ids,
+		RStarThreadPool &pool = RStarThreadPool::Default())
+	{
+		QueryBatchInternal<Acceptor>(m_root, bounds, count, offsets, ids, pool);
+	}
+	
+	void QueryBatch(const BoundingBox * bounds, std::size_t count,
+		std::vector<std::size_t> &offsets, std::vector<LeafType> &ids,
+		RStarThreadPool &pool = RStarThreadPool::Default())
+	{
+		QueryBatchInternal<AcceptOverlapping>(m_root, bounds, count, offsets, ids, pool);
 	}
 	
+	// Variante con visitors: cada worker recibe una copia de visitor y la
+	// usa para todas sus consultas; se devuelve una por worker para que el
+	// llamador las combine
 	template <typename Acceptor, typename Visitor>
-	struct VisitFunctor : std::unary_function< const BoundingBox *, void > {
+	std::vector<Visitor> QueryBatch(const BoundingBox * bounds, std::size_t count, Visitor visitor,
+		RStarThreadPool &pool = RStarThreadPool::Default())
+	{
+		return QueryBatchInternal<Acceptor>(m_root, bounds, count, visitor, pool);
+	}
 	
-		const Acceptor &accept;
-		Visitor &visit;
-		
-		explicit VisitFunctor(const Acceptor &a, Visitor &v) : accept(a), visit(v) {}
+	// Agregado de las hojas que accept acepta, sin visitarlas: los
+	// subarboles que accept.Covers da por cubiertos se toman enteros y solo
+	// se baja por los que se cruzan con el borde. Requiere una politica
+	// Aggregate.
+	template <typename Acceptor>
+	AggregateValue QueryAggregate(const Acceptor &accept) const
+	{
+		return QueryAggregateInternal(m_root, accept);
+	}
 	
-		void operator()( BoundedItem * item ) 
+	// las que se solapan con bound, como Query(AcceptOverlapping(bound))
+	AggregateValue QueryAggregate(const BoundingBox &bound) const
+	{
+		return QueryAggregateInternal(m_root, AcceptOverlapping(bound));
+	}
+
+	template <typename Acceptor, typename LeafRemover>
+	void Remove( const Acceptor &accept, LeafRemover leafRemover)
+	{
+		std::list<Leaf*> itemsToReinsert;
+
+		if (!m_root)
+			return;
+		
+		RemoveFunctor<Acceptor, LeafRemover> remove(this, accept, leafRemover, &itemsToReinsert);
+		m_root = remove(m_root, true);
+		
+		if (!itemsToReinsert.empty())
 		{
-			Leaf * leaf = static_cast<Leaf*>(item);
+			typename std::list< Leaf* >::iterator it = itemsToReinsert.begin();
+			typename std::list< Leaf* >::iterator end = itemsToReinsert.end();
 		
-			if (accept(leaf))
-				visit(leaf);
+			m_root = Writable(m_root);
+			for(;it != end; it++)
+				InsertInternal(*it, m_root);
 		}
-	};
-	
-    template <typename Acceptor, typename Visitor>
-	struct QueryFunctor : std::unary_function< const BoundedItem, void > {
-		const Acceptor &accept;
-		Visitor &visitor;
 		
-		explicit QueryFunctor(const Acceptor &a, Visitor &v) : accept(a), visitor(v) {}
+		Modified();
+	}
 	
-		void operator()(BoundedItem * item)
+	void RemoveBoundedArea( const BoundingBox &bound )
+	{
+		Remove(AcceptEnclosing(bound), RemoveLeaf());
+	}
+	
+	// Sin Locator recorre todo el arbol; con uno va a las hojas del item y
+	// solo toca sus caminos
+	void RemoveItem( const LeafType &item, bool removeDuplicates = true )
+	{
+		if (!LeafLocator::enabled)
 		{
-			Node * node = static_cast<Node*>(item);
-		
-			if (visitor.ContinueVisiting && accept(node))
-			{
-				if (node->hasLeaves)
-					for_each(node->items.begin(), node->items.end(), VisitFunctor<Acceptor, Visitor>(accept, visitor));
-				else
-					for_each(node->items.begin(), node->items.end(), *this);
-			}
+			Remove( AcceptAny(), RemoveSpecificLeaf(item, removeDuplicates));
+			return;
 		}
-	};
+		
+		std::vector<Leaf*> leaves;
+		m_locator.Find(item, leaves);
+		
+		if (!removeDuplicates && leaves.size() > 1)
+			leaves.resize(1);
+		
+		for (std::size_t i = 0; i < leaves.size(); i++)
+			Remove( AcceptContaining(leaves[i]->bound), RemoveThisLeaf(leaves[i]));
+	}
 	
-	template <typename Acceptor, typename LeafRemover>
-	struct RemoveLeafFunctor : 
-		std::unary_function< const BoundingBox *, bool > 
+	// bound tiene que ser el que se uso en Insert: solo se baja por los
+	// nodos que lo encierran, sin necesidad de un Locator
+	void RemoveItem( const LeafType &item, const BoundingBox &bound, bool removeDuplicates = true )
 	{
-		const Acceptor &accept;
-		LeafRemover &remove;
-		std::size_t * size;
-		
-		explicit RemoveLeafFunctor(const Acceptor &a, LeafRemover &r, std::size_t * s) :
-			accept(a), remove(r), size(s) {}
+		Remove( AcceptContaining(bound), RemoveSpecificLeaf(item, removeDuplicates));
+	}
 	
-		bool operator()(BoundedItem * item ) const {
-			Leaf * leaf = static_cast<Leaf *>(item);
-			
-			if (accept(leaf) && remove(leaf))
-			{
-				--(*size);
-				delete leaf;
-				return true;
+	// Mueve item de oldBound a newBound de abajo hacia arriba, como el
+	// LUR-tree. Si newBound cabe en el nodo hoja, agrandado slack por lado,
+	// se cambia en sitio; si no, la hoja sale de su nodo, se sube solo hasta
+	// el primer ancestro que encierra newBound ajustando los bounds del
+	// camino, y se reinserta desde ahi sin reinserciones forzadas. Si el
+	// nodo quedaria por debajo del minimo se hace Remove + Insert.
+	// false si item no esta con bound oldBound.
+	bool Update(const LeafType &item, const BoundingBox &oldBound, const BoundingBox &newBound, Coord slack = 0)
+	{
+		m_path.clear();
+		
+		if (!m_root || !FindLeaf(m_root, item, oldBound))
+			return false;
+		
+		const std::size_t depth = m_path.size() - 1;
+		Node * node = m_path[depth].node;
+		const std::size_t index = m_path[depth].index;
+		
+		if (!Fits(node->bound, newBound, slack) && depth && node->items.size() <= min_child_items)
+		{
+			Remove( AcceptContaining(oldBound), RemoveThisLeaf(static_cast<Leaf*>(node->items[index])));
+			Insert(item, newBound);
+			return true;
+		}
+		
+		// el camino se vuelve modificable de arriba abajo
+		m_root = Writable(m_root);
+		m_path[0].node = m_root;
+		for (std::size_t d = 1; d <= depth; d++)
+			m_path[d].node = WritableChild(m_path[d-1].node, m_path[d-1].index);
+		
+		node = m_path[depth].node;
+		Leaf * leaf = WritableLeaf(node, index);
+		
+		if (Fits(node->bound, newBound, slack))
+		{
+			leaf->bound = newBound;
+			node->SyncChild(index);
+			
+			// con slack el nodo puede crecer: se estiran los ancestros que no
+			// lo encierren
+			for (std::size_t d = depth + 1; d-- > 0 && !m_path[d].node->bound.encloses(newBound); )
+			{
+				m_path[d].node->bound.stretch(newBound);
+				if (d)
+					m_path[d-1].node->SyncChild(m_path[d-1].index);
+			}
+		}
+		else
+		{
+			// ancestro mas bajo que encierra newBound, o la raiz
+			std::size_t top = depth;
+			while (top && !m_path[top].node->bound.encloses(newBound))
+				top--;
+			
+			node->items.erase(node->items.begin() + index);
+			node->Sync();
+			
+			// los nodos debajo de top perdieron la hoja: bounds ajustados
+			for (std::size_t d = depth; d > top; d--)
+			{
+				Node * lower = m_path[d].node;
+				lower->bound.reset();
+				for (std::size_t i = 0; i < lower->items.size(); i++)
+					lower->bound.stretch(lower->items[i]->bound);
+				Summarize(lower);
+				
+				m_path[d-1].node->SyncChild(m_path[d-1].index);
+			}
+			
+			leaf->bound = newBound;
+			Node * split = InsertInternal(leaf, m_path[top].node, false);
+			
+			// los splits suben por el camino hasta que alguno no desborda
+			for (std::size_t d = top; d > 0; d--)
+			{
+				Node * parent = m_path[d-1].node;
+				parent->SyncChild(m_path[d].node, m_path[d-1].index);
+				
+				if (split)
+				{
+					parent->items.push_back(split);
+					parent->SyncChild(parent->items.size() - 1);
+					split = parent->items.size() > max_child_items ? OverflowTreatment(parent, false) : NULL;
+				}
 			}
+		}
+		
+		Modified();
+		return true;
+	}
+	
+	
+	// Escribe el arbol en el formato de RStarFile.h, para abrirlo con
+	// RStarMappedTree. Las hojas se copian byte a byte, asi que LeafType
+	// tiene que ser trivialmente copiable. Se escribe a un temporal y se
+	// renombra, para no cambiar el archivo bajo quien lo tenga mapeado.
+	bool Save(const char * fileName) const
+	{
+		static_assert(std::is_trivially_copyable<LeafType>::value, "RStarTree::Save requiere un LeafType trivialmente copiable");
+		
+		typedef RStarFileNode<dimensions, Coord>			FileNode;
+		typedef RStarFileLeaf<dimensions, Coord, LeafType>	FileLeaf;
+		
+		static_assert(std::is_trivially_copyable<FileNode>::value && std::is_trivially_copyable<FileLeaf>::value,
+			"RStarTree::Save escribe registros trivialmente copiables");
+		
+		std::vector<const Node*> nodes;
+		if (m_root && m_size)
+			nodes.push_back(m_root);
+		
+		uint64_t leafCount = 0;
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			if (nodes[i]->hasLeaves)
+				leafCount += nodes[i]->items.size();
+			else
+				for (std::size_t j = 0; j < nodes[i]->items.size(); j++)
+					nodes.push_back(static_cast<const Node*>(nodes[i]->items[j]));
+		}
+		
+		RStarFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, RSTAR_FILE_MAGIC, sizeof(header.magic));
+		header.version    = RSTAR_FILE_VERSION;
+		header.byteOrder  = 0x01020304;
+		header.dimensions = dimensions;
+		header.coordSize  = sizeof(Coord);
+		header.coordKind  = RStarFileHeader::CoordKind<Coord>();
+		header.height     = nodes.empty() ? 0 : (uint32_t)Height(m_root);
+		header.nodeSize   = sizeof(FileNode);
+		header.leafSize   = sizeof(FileLeaf);
+		header.payloadSize = sizeof(LeafType);
+		header.nodeCount  = nodes.size();
+		header.leafCount  = leafCount;
+		header.nodeOffset = RStarFileAlign(sizeof(header));
+		header.leafOffset = RStarFileAlign(header.nodeOffset + header.nodeCount * sizeof(FileNode));
+		header.fileSize   = header.leafOffset + header.leafCount * sizeof(FileLeaf);
+		
+		const std::string tmpName = std::string(fileName) + ".tmp";
+		std::ofstream out(tmpName.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		
+		const char padding[RSTAR_FILE_ALIGN] = {0};
+		
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(padding, header.nodeOffset - sizeof(header));
+		
+		uint64_t nextNode = 1, nextLeaf = 0;
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			FileNode record = FileNode();
+			record.bound     = nodes[i]->bound;
+			record.count     = (uint32_t)nodes[i]->items.size();
+			record.hasLeaves = nodes[i]->hasLeaves;
+			record.first     = nodes[i]->hasLeaves ? nextLeaf : nextNode;
+			
+			(nodes[i]->hasLeaves ? nextLeaf : nextNode) += record.count;
+			out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		
+		out.write(padding, header.leafOffset - (header.nodeOffset + header.nodeCount * sizeof(FileNode)));
+		
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			if (!nodes[i]->hasLeaves)
+				continue;
+			
+			for (std::size_t j = 0; j < nodes[i]->items.size(); j++)
+			{
+				const Leaf * leaf = static_cast<const Leaf*>(nodes[i]->items[j]);
+				
+				FileLeaf record = FileLeaf();
+				record.bound = leaf->bound;
+				record.leaf  = leaf->leaf;
+				out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+			}
+		}
+		
+		out.close();
+		
+		if (!out || std::rename(tmpName.c_str(), fileName) != 0)
+		{
+			std::remove(tmpName.c_str());
+			return false;
+		}
+		
+		return true;
+	}
+	
+	// Reemplaza el contenido por el de un archivo escrito con Save, con los
+	// mismos nodos y en el mismo orden, sin volver a insertar. false si el
+	// archivo no es valido o tiene nodos de mas de max_child_items hijos;
+	// en ese caso el arbol no cambia.
+	bool Load(const char * fileName)
+	{
+		typedef RStarMappedTree<LeafType, dimensions, Coord>	MappedTree;
+		
+		MappedTree mapped;
+		if (!mapped.Open(fileName))
+			return false;
+		
+		const typename MappedTree::Node * nodes = mapped.GetNodes();
+		for (std::size_t i = 0; i < mapped.GetNodeCount(); i++)
+			if (nodes[i].count == 0 || nodes[i].count > max_child_items)
+				return false;
+		
+		Discard();
+		
+		if (mapped.GetSize() && mapped.GetNodeCount())
+		{
+			m_root = LoadNode(mapped, nodes[0]);
+			m_size = mapped.GetSize();
+		}
+		
+		Modified();
+		return true;
+	}
+	
+	std::size_t GetSize() const { return m_size; }
+	std::size_t GetDimensions() const { return dimensions; }
+	
+	// Recorre todo el arbol: altura, nodos e hijos por nivel, histograma de
+	// llenado, overlap entre hermanos, espacio muerto y memoria. Para ver
+	// cuando el arbol se degrada y conviene reconstruirlo.
+	RStarTreeStats Stats() const
+	{
+		RStarTreeStats stats;
+		
+		if (m_root)
+		{
+			stats.height = Height(m_root);
+			stats.levels.resize(stats.height);
+			CollectStats(m_root, 0, stats);
+		}
+		
+		stats.bytes = stats.nodes * sizeof(Node) + stats.leaves * sizeof(Leaf);
+		return stats;
+	}
+	
+	// raiz para recorridos externos como RStarJoin; NULL si esta vacio
+	const Node * GetRoot() const { return m_root; }
+	
+	
+	// Lectores concurrentes: a partir de aqui el escritor (un solo hilo)
+	// copia los nodos publicados antes de modificarlos y los retira por
+	// epocas, y otros hilos consultan a traves de Snapshot sin locks. Con
+	// autoPublish cada Insert/Remove/BulkLoad/Clear publica al terminar; si
+	// no, los cambios se ven al llamar a Publish().
+	void EnableConcurrentReaders(bool autoPublish = true)
+	{
+		m_shared = true;
+		m_autoPublish = autoPublish;
+		Publish();
+	}
+	
+	void Publish()
+	{
+		if (!m_shared)
+			return;
+		
+		m_published.store(m_root, std::memory_order_seq_cst);
+		
+		const unsigned long epoch = m_epochs.GetEpoch();
+		for (; m_tagged < m_retired.size(); m_tagged++)
+			m_retired[m_tagged].epoch = epoch;
+		
+		m_epochs.Advance();
+		m_version++;
+		
+		Reclaim();
+	}
+	
+	// Vista de solo lectura del ultimo arbol publicado. Mientras viva, sus
+	// nodos no se liberan, asi que varias consultas ven el mismo estado.
+	// Conviene que dure poco: retiene la memoria que el escritor retira.
+	class Snapshot {
+	public:
+		explicit Snapshot(const RStarTree &tree) :
+			m_tree(tree), m_slot(tree.m_epochs.Enter()), m_root(tree.m_published.load(std::memory_order_seq_cst)) {}
+		
+		~Snapshot() {
+			m_tree.m_epochs.Exit(m_slot);
+		}
+		
+		template <typename Acceptor, typename Visitor>
+		Visitor Query(const Acceptor &accept, Visitor visitor) const
+		{
+			return QueryInternal(m_root, accept, visitor);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryNearest(const Point &point, std::size_t k, Visitor visitor, NearestBuffer &buffer) const
+		{
+			return QueryNearestInternal(m_root, point, k, visitor, buffer);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryNearest(const Point &point, std::size_t k, Visitor visitor) const
+		{
+			NearestBuffer buffer;
+			return QueryNearestInternal(m_root, point, k, visitor, buffer);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryRay(const Ray &ray, std::size_t k, Visitor visitor, NearestBuffer &buffer) const
+		{
+			return QueryRayInternal(m_root, ray, k, visitor, buffer);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryRay(const Ray &ray, std::size_t k, Visitor visitor) const
+		{
+			NearestBuffer buffer;
+			return QueryRayInternal(m_root, ray, k, visitor, buffer);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryRayPacket(const Ray * rays, std::size_t count, std::size_t k, Visitor visitor, RayPacketBuffer &buffer) const
+		{
+			return QueryRayPacketInternal(m_root, rays, count, k, visitor, buffer);
+		}
+		
+		template <typename Visitor>
+		Visitor QueryRayPacket(const Ray * rays, std::size_t count, std::size_t k, Visitor visitor) const
+		{
+			RayPacketBuffer buffer;
+			return QueryRayPacketInternal(m_root, rays, count, k, visitor, buffer);
+		}
+		
+		template <typename Acceptor>
+		Cursor<Acceptor> QueryCursor(const Acceptor &accept, std::size_t limit = std::numeric_limits<std::size_t>::max()) const
+		{
+			return Cursor<Acceptor>(m_root, accept, limit);
+		}
+		
+		template <typename Acceptor>
+		void QueryBatch(const BoundingBox * bounds, std::size_t count,
+			std::vector<std::size_t> &offsets, std::vector<LeafType> &ids,
+			RStarThreadPool &pool = RStarThreadPool::Default()) const
+		{
+			QueryBatchInternal<Acceptor>(m_root, bounds, count, offsets, ids, pool);
+		}
+		
+		void QueryBatch(const BoundingBox * bounds, std::size_t count,
+			std::vector<std::size_t> &offsets, std::vector<LeafType> &ids,
+			RStarThreadPool &pool = RStarThreadPool::Default()) const
+		{
+			QueryBatchInternal<AcceptOverlapping>(m_root, bounds, count, offsets, ids, pool);
+		}
+		
+		template <typename Acceptor, typename Visitor>
+		std::vector<Visitor> QueryBatch(const BoundingBox * bounds, std::size_t count, Visitor visitor,
+			RStarThreadPool &pool = RStarThreadPool::Default()) const
+		{
+			return QueryBatchInternal<Acceptor>(m_root, bounds, count, visitor, pool);
+		}
+		
+		template <typename Acceptor>
+		AggregateValue QueryAggregate(const Acceptor &accept) const
+		{
+			return QueryAggregateInternal(m_root, accept);
+		}
+		
+		AggregateValue QueryAggregate(const BoundingBox &bound) const
+		{
+			return QueryAggregateInternal(m_root, AcceptOverlapping(bound));
+		}
+		
+	private:
+		Snapshot(const Snapshot &);
+		Snapshot & operator=(const Snapshot &);
+		
+		const RStarTree & m_tree;
+		const std::size_t m_slot;
+		Node * const m_root;
+	};
+	
+	
+protected:
+	
+	template <typename Acceptor, typename Visitor>
+	static Visitor QueryInternal(Node * root, const Acceptor &accept, Visitor visitor)
+	{
+		if (root)
+		{	
+			QueryFunctor<Acceptor, Visitor> query(accept, visitor);
+			query(root);
+		}
+		
+		return visitor;
+	}
+	
+	template <typename Visitor>
+	static Visitor QueryNearestInternal(const Node * root, const Point &point, std::size_t k, Visitor visitor, NearestBuffer &buffer)
+	{
+		buffer.clear();
+		
+		if (!root || !k)
+			return visitor;
+		
+		double prune = std::numeric_limits<double>::max();
+		std::size_t found = 0;
+		
+		buffer.push(root->bound.minDistance(point), root, false);
+		
+		while (!buffer.queue.empty() && found < k && visitor.ContinueVisiting)
+		{
+			const typename NearestBuffer::Entry entry = buffer.pop();
+			
+			if (entry.distance > prune)
+				break;
+			
+			if (entry.isLeaf)
+			{
+				visitor(static_cast<const Leaf*>(entry.item), entry.distance);
+				found++;
+				continue;
+			}
+			
+			const Node * node = static_cast<const Node*>(entry.item);
+			RSTAR_COUNT_NODE(node->hasLeaves, node->items.size());
+			
+			for (std::size_t i = 0; i < node->items.size(); i++)
+			{
+				const BoundingBox bound = node->childBounds.get(i);
+				const double distance = bound.minDistance(point);
+				
+				if (distance > prune)
+					continue;
+				
+				buffer.push(distance, node->items[i], node->hasLeaves);
+				
+				if (node->hasLeaves)
+					prune = std::min(prune, buffer.addCandidate(distance, k));
+			}
+		}
+		
+		return visitor;
+	}
+	
+	// como QueryNearestInternal, con el t de entrada como distancia y el t
+	// de la k-esima hoja encolada como limite del rayo
+	template <typename Visitor>
+	static Visitor QueryRayInternal(const Node * root, const Ray &ray, std::size_t k, Visitor visitor, NearestBuffer &buffer)
+	{
+		buffer.clear();
+		
+		double enter;
+		if (!root || !k || !ray.Intersect(root->bound, enter))
+			return visitor;
+		
+		double prune = ray.tMax;
+		std::size_t found = 0;
+		
+		buffer.push(enter, root, false);
+		
+		while (!buffer.queue.empty() && found < k && visitor.ContinueVisiting)
+		{
+			const typename NearestBuffer::Entry entry = buffer.pop();
+			
+			if (entry.distance > prune)
+				break;
+			
+			if (entry.isLeaf)
+			{
+				visitor(static_cast<const Leaf*>(entry.item), entry.distance);
+				found++;
+				continue;
+			}
+			
+			const Node * node = static_cast<const Node*>(entry.item);
+			RSTAR_COUNT_NODE(node->hasLeaves, node->items.size());
+			
+			for (std::size_t i = 0; i < node->items.size(); i++)
+			{
+				if (!ray.Intersect(node->childBounds.get(i), prune, enter))
+					continue;
+				
+				buffer.push(enter, node->items[i], node->hasLeaves);
+				
+				if (node->hasLeaves)
+					prune = std::min(prune, buffer.addCandidate(enter, k));
+			}
+		}
+		
+		return visitor;
+	}
+	
+	template <typename Visitor>
+	static Visitor QueryRayPacketInternal(const Node * root, const Ray * rays, std::size_t count, std::size_t k, Visitor visitor, RayPacketBuffer &buffer)
+	{
+		for (std::size_t first = 0; first < count && visitor.ContinueVisiting; first += RayPacket::width)
+		{
+			RayPacket packet(rays + first, count - first);
+			visitor = QueryPacket(root, packet, first, k, visitor, buffer);
+		}
+		
+		return visitor;
+	}
+	
+	// Una sola cola para todo el paquete: los nodos van con los rayos que
+	// los cortan y el menor t de entrada de ellos, que acota por debajo el t
+	// de cualquier hoja del subarbol para cada rayo; las hojas van de a un
+	// rayo. Asi cada rayo recibe sus hojas en orden. packet.tMax de cada
+	// rayo baja al t de su k-esima hoja encolada, y un rayo con k hojas
+	// visitadas sale de active.
+	template <typename Visitor>
+	static Visitor QueryPacket(const Node * root, RayPacket &packet, std::size_t offset, std::size_t k, Visitor visitor, RayPacketBuffer &buffer)
+	{
+		buffer.clear();
+		
+		const RStarRayKernels::Kernel slab = RStarGetRayKernels().slab;
+		
+		unsigned active = packet.Lanes();
+		std::size_t found[RayPacket::width] = { 0 };
+		double enter[RayPacket::width];
+		
+		if (!root || !k)
+			return visitor;
+		
+		const unsigned lanes = packet.Intersect(slab, root->bound, enter) & active;
+		if (lanes)
+			buffer.push(MinEnter(enter, lanes), root, lanes, false);
+		
+		while (!buffer.queue.empty() && active && visitor.ContinueVisiting)
+		{
+			const typename RayPacketBuffer::Entry entry = buffer.pop();
+			const unsigned live = entry.lanes & active;
+			
+			if (!live)
+				continue;
+			
+			if (entry.isLeaf)
+			{
+				const unsigned r = __builtin_ctz(live);
+				
+				if (entry.enter > packet.tMax[r])
+					continue;
+				
+				visitor(offset + r, static_cast<const Leaf*>(entry.item), entry.enter);
+				
+				if (++found[r] == k)
+					active &= ~(1u << r);
+				continue;
+			}
+			
+			const Node * node = static_cast<const Node*>(entry.item);
+			RSTAR_COUNT_NODE(node->hasLeaves, node->items.size());
+			
+			for (std::size_t i = 0; i < node->items.size(); i++)
+			{
+				const unsigned hit = packet.Intersect(slab, node->childBounds.get(i), enter) & live;
+				if (!hit)
+					continue;
+				
+				if (!node->hasLeaves)
+				{
+					buffer.push(MinEnter(enter, hit), node->items[i], hit, false);
+					continue;
+				}
+				
+				for (unsigned bits = hit; bits; bits &= bits - 1)
+				{
+					const unsigned r = __builtin_ctz(bits);
+					buffer.push(enter[r], node->items[i], 1u << r, true);
+					packet.tMax[r] = std::min(packet.tMax[r], buffer.addCandidate(r, enter[r], k));
+				}
+			}
+		}
+		
+		return visitor;
+	}
+	
+	static double MinEnter(const double * enter, unsigned lanes)
+	{
+		double t = std::numeric_limits<double>::infinity();
+		for (; lanes; lanes &= lanes - 1)
+			t = std::min(t, enter[__builtin_ctz(lanes)]);
+		return t;
+	}
+	
+	// visitor que copia los LeafType al buffer del worker
+	struct CollectLeaves {
+		std::vector<LeafType> * ids;
+		bool ContinueVisiting;
+		
+		explicit CollectLeaves(std::vector<LeafType> * i) : ids(i), ContinueVisiting(true) {}
+		
+		void operator()(const Leaf * leaf) { ids->push_back(leaf->leaf); }
+	};
+	
+	// primera pasada: cada worker acumula en su buffer y anota donde empieza
+	// cada consulta; offsets[q+1] guarda de momento el numero de resultados
+	template <typename Acceptor>
+	struct BatchQueryJob {
+		Node * root;
+		const BoundingBox * bounds;
+		std::vector< std::vector<LeafType> > * local;
+		std::vector<std::size_t> * start;
+		std::vector<unsigned> * owner;
+		std::vector<std::size_t> * offsets;
+		
+		void operator()(std::size_t begin, std::size_t end, unsigned worker) const
+		{
+			std::vector<LeafType> &ids = (*local)[worker];
+			
+			for (std::size_t q = begin; q < end; q++)
+			{
+				(*start)[q] = ids.size();
+				(*owner)[q] = worker;
+				
+				QueryInternal(root, Acceptor(bounds[q]), CollectLeaves(&ids));
+				(*offsets)[q+1] = ids.size() - (*start)[q];
+			}
+		}
+	};
+	
+	// segunda pasada: de los buffers de los workers a su lugar en ids
+	struct BatchCopyJob {
+		const std::vector< std::vector<LeafType> > * local;
+		const std::vector<std::size_t> * start;
+		const std::vector<unsigned> * owner;
+		const std::vector<std::size_t> * offsets;
+		std::vector<LeafType> * ids;
+		
+		void operator()(std::size_t begin, std::size_t end, unsigned) const
+		{
+			for (std::size_t q = begin; q < end; q++)
+			{
+				const std::vector<LeafType> &from = (*local)[(*owner)[q]];
+				std::copy(from.begin() + (*start)[q], from.begin() + (*start)[q] + ((*offsets)[q+1] - (*offsets)[q]),
+					ids->begin() + (*offsets)[q]);
+			}
+		}
+	};
+	
+	template <typename Acceptor>
+	static void QueryBatchInternal(Node * root, const BoundingBox * bounds, std::size_t count,
+		std::vector<std::size_t> &offsets, std::vector<LeafType> &ids, RStarThreadPool &pool)
+	{
+		std::vector< std::vector<LeafType> > local(pool.GetThreadCount());
+		std::vector<std::size_t> start(count);
+		std::vector<unsigned> owner(count);
+		
+		offsets.assign(count + 1, 0);
+		
+		BatchQueryJob<Acceptor> query = { root, bounds, &local, &start, &owner, &offsets };
+		pool.ParallelFor(count, RSTAR_BATCH_GRAIN, query);
+		
+		for (std::size_t q = 0; q < count; q++)
+			offsets[q+1] += offsets[q];
+		
+		ids.resize(offsets[count]);
+		
+		BatchCopyJob copy = { &local, &start, &owner, &offsets, &ids };
+		pool.ParallelFor(count, RSTAR_BATCH_GRAIN * 16, copy);
+	}
+	
+	template <typename Acceptor, typename Visitor>
+	struct BatchVisitJob {
+		Node * root;
+		const BoundingBox * bounds;
+		std::vector<Visitor> * visitors;
+		
+		void operator()(std::size_t begin, std::size_t end, unsigned worker) const
+		{
+			for (std::size_t q = begin; q < end; q++)
+				(*visitors)[worker] = QueryInternal(root, Acceptor(bounds[q]), (*visitors)[worker]);
+		}
+	};
+	
+	template <typename Acceptor, typename Visitor>
+	static std::vector<Visitor> QueryBatchInternal(Node * root, const BoundingBox * bounds, std::size_t count,
+		const Visitor &visitor, RStarThreadPool &pool)
+	{
+		std::vector<Visitor> visitors(pool.GetThreadCount(), visitor);
+		
+		BatchVisitJob<Acceptor, Visitor> visit = { root, bounds, &visitors };
+		pool.ParallelFor(count, RSTAR_BATCH_GRAIN, visit);
+		
+		return visitors;
+	}
+	
+	template <typename Acceptor>
+	static AggregateValue QueryAggregateInternal(const Node * root, const Acceptor &accept)
+	{
+		static_assert(Aggregate::enabled, "RStarTree::QueryAggregate requiere una politica Aggregate");
+		
+		AggregateValue total = Aggregate::Identity();
+		
+		if (root)
+		{
+			if (accept.Covers(root))
+				return root->aggregate;
+			
+			if (accept(root))
+				AggregateNode(root, accept, total);
+		}
+		
+		return total;
+	}
+	
+	template <typename Acceptor>
+	static void AggregateNode(const Node * node, const Acceptor &accept, AggregateValue &total)
+	{
+		typename Node::HitMask hits;
+		RStarChildFilter<Acceptor, Node, Leaf>::Scan(accept, node, hits);
+		
+		const std::size_t n = node->items.size();
+		RSTAR_COUNT_NODE(node->hasLeaves, n);
+		RSTAR_COUNT_ACCEPT(n, hits.count());
+		
+		if (node->hasLeaves)
+		{
+			for (std::size_t i = hits.next(0); i < n; i = hits.next(i+1))
+				Aggregate::Combine(total, Aggregate::Leaf(static_cast<const Leaf*>(node->items[i])->leaf));
+		}
+		else
+			for (std::size_t i = hits.next(0); i < n; i = hits.next(i+1))
+			{
+				const Node * child = static_cast<const Node*>(node->items[i]);
+				
+				if (accept.Covers(child))
+					Aggregate::Combine(total, child->aggregate);
+				else
+					AggregateNode(child, accept, total);
+			}
+	}
+	
+	// recalcula el agregado de node desde sus hijos; se llama despues de
+	// cada cambio en los hijos de un nodo, de abajo hacia arriba
+	static void Summarize(Node * node)
+	{
+		if (!Aggregate::enabled)
+			return;
+		
+		AggregateValue total = Aggregate::Identity();
+		
+		if (node->hasLeaves)
+			for (std::size_t i = 0; i < node->items.size(); i++)
+				Aggregate::Combine(total, Aggregate::Leaf(static_cast<const Leaf*>(node->items[i])->leaf));
+		else
+			for (std::size_t i = 0; i < node->items.size(); i++)
+				Aggregate::Combine(total, static_cast<const Node*>(node->items[i])->aggregate);
+		
+		node->aggregate = total;
+	}
+	
+	// hijo de node donde bajar bound, segun Strategy
+	std::size_t ChooseSubtree(const Node * node, const BoundingBox &bound) const
+	{
+		return Strategy::ChooseSubtree(node, bound);
+	}
+	
+    Node * InsertInternal(Leaf * leaf, Node * node, bool firstInsert = true)
+	{
+		node->bound.stretch(leaf->bound);
+	
+        if (node->hasLeaves)
+		{
+			node->items.push_back(leaf);
+			node->SyncChild(node->items.size() - 1);
+		}else{
+			const std::size_t i = ChooseSubtree(node, leaf->bound);
+			Node * child = WritableChild(node, i);
+			
+            Node * tmp_node = InsertInternal( leaf, child, firstInsert );
+			
+			// solo cambio el bound de child, salvo que una reinsercion
+			// haya reorganizado este nodo
+			node->SyncChild(child, i);
+			
+			if (tmp_node)
+			{
+				node->items.push_back(tmp_node);
+				node->SyncChild(node->items.size() - 1);
+			}
+		}
+		
+		Summarize(node);
+
+        if (node->items.size() > max_child_items )
+		{
+			
+			return OverflowTreatment(node, firstInsert);
+		}
+			
+		return NULL;
+	}
+	
+	Node * OverflowTreatment(Node * level, bool firstInsert)
+	{
+
+		if (level != m_root && firstInsert)
+		{
+			const std::size_t p = Strategy::Reinsert(level);
+			if (p)
+			{
+				Reinsert(level, p);
+				return NULL;
+			}
+		}
+		
+		Node * splitItem = Split(level);
+		
+		if (level == m_root)
+		{
+			Node * newRoot = NewNode();
+			newRoot->hasLeaves = false;
+			
+			newRoot->items.reserve(min_child_items);
+			newRoot->items.push_back(m_root);
+			newRoot->items.push_back(splitItem);
+			
+			newRoot->bound.reset();
+			for_each(newRoot->items.begin(), newRoot->items.end(), StretchBoundingBox<BoundedItem>(&newRoot->bound));
+			newRoot->Sync();
+			Summarize(newRoot);
+			
+			m_root = newRoot;
+			return NULL;
+		}
+		return splitItem;
+	}
+
+	// Strategy reordena los hijos y dice desde donde pasan al nodo nuevo
+	Node * Split(Node * node)
+	{
+		Node * newNode = NewNode();
+		newNode->hasLeaves = node->hasLeaves;
+		
+		assert(node->items.size() == max_child_items + 1);
+		
+		const std::size_t split_index = Strategy::template Split<min_child_items>(node);
+		
+		assert(min_child_items <= split_index && split_index <= node->items.size() - min_child_items);
+		
+		newNode->items.assign(node->items.begin() + split_index, node->items.end());
+		node->items.erase(node->items.begin() + split_index, node->items.end());
+		
+		node->bound.reset();
+		std::for_each(node->items.begin(), node->items.end(), StretchBoundingBox<BoundedItem>(&node->bound));
+		
+		newNode->bound.reset();
+		std::for_each(newNode->items.begin(), newNode->items.end(), StretchBoundingBox<BoundedItem>(&newNode->bound));
+		
+		node->Sync();
+		newNode->Sync();
+		
+		Summarize(node);
+		Summarize(newNode);
+		
+		return newNode;
+	}
+
+	// reinserta desde la raiz los ultimos p hijos de node
+	void Reinsert(Node * node, std::size_t p)
+	{
+		std::vector< BoundedItem* > removed_items;
+		
+		removed_items.assign(node->items.end() - p, node->items.end());
+		node->items.erase(node->items.end() - p, node->items.end());
+		
+		node->bound.reset();
+		for_each(node->items.begin(), node->items.end(), StretchBoundingBox<BoundedItem>(&node->bound));
+		node->Sync();
+		Summarize(node);
+		
+		for (typename std::vector< BoundedItem* >::iterator it = removed_items.begin(); it != removed_items.end(); it++)
+			InsertInternal( static_cast<Leaf*>(*it), m_root, false);
+	}
+	
+    template <typename Acceptor, typename Visitor>
+	struct QueryFunctor : std::unary_function< const BoundedItem, void > {
+		const Acceptor &accept;
+		Visitor &visitor;
+		
+		explicit QueryFunctor(const Acceptor &a, Visitor &v) : accept(a), visitor(v) {}
+	
+		void operator()(BoundedItem * item)
+		{
+			Node * node = static_cast<Node*>(item);
 			
-			return false;
+			if (!visitor.ContinueVisiting)
+				return;
+			
+			const bool accepted = accept(node);
+			RSTAR_COUNT_ACCEPT(1, accepted);
+			
+			if (accepted)
+				Visit(node);
+		}
+		
+		// los hijos se filtran con childBounds; solo se baja a los aceptados
+		void Visit(Node * node)
+		{
+			typename Node::HitMask hits;
+			RStarChildFilter<Acceptor, Node, Leaf>::Scan(accept, node, hits);
+			
+			const std::size_t n = node->items.size();
+			RSTAR_COUNT_NODE(node->hasLeaves, n);
+			RSTAR_COUNT_ACCEPT(n, hits.count());
+			
+			if (node->hasLeaves)
+			{
+				for (std::size_t i = hits.next(0); i < n && visitor.ContinueVisiting; i = hits.next(i+1))
+					visitor(static_cast<Leaf*>(node->items[i]));
+			}
+			else
+				for (std::size_t i = hits.next(0); i < n && visitor.ContinueVisiting; i = hits.next(i+1))
+					Visit(static_cast<Node*>(node->items[i]));
 		}
 	};
 	
-	
+	// Devuelve el nodo que debe quedar en el padre: el mismo, su copia si
+	// hubo que modificarlo, o NULL si se vacio o quedo por debajo del minimo
 	template <typename Acceptor, typename LeafRemover>
-	struct RemoveFunctor :
-		std::unary_function< const BoundedItem *, bool > 
-	{
+	struct RemoveFunctor {
+		RStarTree * tree;
 		const Acceptor &accept;
 		LeafRemover &remove;
 		
 		std::list<Leaf*> * itemsToReinsert;
-		std::size_t * m_size;
 	
-		explicit RemoveFunctor(const Acceptor &na, LeafRemover &lr, std::list<Leaf*>* ir, std::size_t * size)
-			: accept(na), remove(lr), itemsToReinsert(ir), m_size(size) {}
+		explicit RemoveFunctor(RStarTree * t, const Acceptor &na, LeafRemover &lr, std::list<Leaf*>* ir)
+			: tree(t), accept(na), remove(lr), itemsToReinsert(ir) {}
 	
-		bool operator()(BoundedItem * item, bool isRoot = false)
+		Node * operator()(Node * node, bool isRoot = false)
 		{
-			Node * node = static_cast<Node*>(item);
-		
-			if (accept(node))
-			{	
+			if (!accept(node))
+				return node;
+			
+			// node no se toca hasta el primer cambio; desde ahi se escribe
+			// en writable, que es node o una copia privada
+			Node * writable = node;
+			bool changed = false;
+			
+			const std::size_t n = node->items.size();
+			const std::size_t size = tree->m_size;
+			std::size_t out = 0;
+			
+			for (std::size_t i = 0; i < n; i++)
+			{
+				BoundedItem * item = node->items[i], * keep;
+				
 				if (node->hasLeaves)
-					node->items.erase(std::remove_if(node->items.begin(), node->items.end(), RemoveLeafFunctor<Acceptor, LeafRemover>(accept, remove, m_size)), node->items.end());
+				{
+					Leaf * leaf = static_cast<Leaf *>(item);
+					keep = accept(leaf) && remove(leaf) ? NULL : item;
+				}
 				else
-					node->items.erase(std::remove_if(node->items.begin(), node->items.end(), *this), node->items.end() );
+					keep = (*this)(static_cast<Node*>(item));
+				
+				if (keep != item && !changed)
+				{
+					writable = tree->Writable(node);
+					changed = true;
+				}
+				
+				if (!keep && node->hasLeaves)
+				{
+					--tree->m_size;
+					tree->m_locator.Remove(static_cast<Leaf *>(item));
+					tree->DisposeLeaf(static_cast<Leaf *>(item));
+				}
+				
+				if (keep)
+				{
+					if (changed)
+						writable->items[out] = keep;
+					out++;
+				}
+			}
+			
+			// sin lectores los hijos se modifican en sitio: node no cambia,
+			// pero su agregado si
+			if (!changed && Aggregate::enabled && tree->m_size != size)
+			{
+				writable = tree->Writable(node);
+				changed = true;
+			}
+			
+			if (!changed)
+				return node;
+			
+			writable->items.erase(writable->items.begin() + out, writable->items.end());
+			writable->Sync();
+			Summarize(writable);
 
-				if (!isRoot)
+			if (!isRoot)
+			{
+				if (writable->items.empty())
 				{
-					if (node->items.empty())
-					{
-						delete node;
-						return true;
-					}
-					else if (node->items.size() < min_child_items)
-					{
-						QueueItemsToReinsert(node);
-						return true;
-					}
+					tree->DisposeNode(writable);
+					return NULL;
 				}
-				else if (node->items.empty())
+				else if (writable->items.size() < min_child_items)
 				{
-					node->hasLeaves = true;
-					node->bound.reset();
+					QueueItemsToReinsert(writable);
+					return NULL;
 				}
-			}			
+			}
+			else if (writable->items.empty())
+			{
+				writable->hasLeaves = true;
+				writable->bound.reset();
+			}
 
-			return false;
-			
+			return writable;
 		}
 
 		void QueueItemsToReinsert(Node * node)
 		{
-			typename std::vector< BoundedItem* >::iterator it = node->items.begin();
-			typename std::vector< BoundedItem* >::iterator end = node->items.end();
+			typename Node::Items::iterator it = node->items.begin();
+			typename Node::Items::iterator end = node->items.end();
 		
 			if (node->hasLeaves)
 			{
@@ -446,22 +1573,442 @@ protected:
 				for (; it != end; it++)
 					QueueItemsToReinsert(static_cast<Node*>(*it));
 					
-			delete node;
+			tree->DisposeNode(node);
+		}
+	};
+	
+
+	static void CollectStats(const Node * node, std::size_t depth, RStarTreeStats &stats)
+	{
+		RStarLevelStats &level = stats.levels[depth];
+		const std::size_t n = node->items.size();
+		
+		const double area = (double)node->bound.area();
+		double covered = 0, overlap = 0;
+		
+		for (std::size_t i = 0; i < n; i++)
+		{
+			const BoundingBox bound = node->childBounds.get(i);
+			covered += (double)bound.area();
+			
+			for (std::size_t j = i + 1; j < n; j++)
+				overlap += (double)bound.overlap(node->childBounds.get(j));
+		}
+		
+		stats.nodes++;
+		level.nodes++;
+		level.children += n;
+		level.fill[std::min<std::size_t>(RSTAR_STATS_FILL_BINS - 1, n * RSTAR_STATS_FILL_BINS / max_child_items)]++;
+		level.area += area;
+		level.siblingOverlap += overlap;
+		level.deadSpace += std::max(0.0, area - covered);
+		
+		if (node->hasLeaves)
+			stats.leaves += n;
+		else
+			for (std::size_t i = 0; i < n; i++)
+				CollectStats(static_cast<const Node*>(node->items[i]), depth + 1, stats);
+	}
+	
+	// paso del camino de Update: el nodo y el indice del hijo por el que sigue
+	struct PathStep {
+		Node * node;
+		std::size_t index;
+	};
+	
+	// deja en m_path el camino de node a la hoja item con bound exacto; solo
+	// se baja por los hijos que encierran bound
+	bool FindLeaf(Node * node, const LeafType &item, const BoundingBox &bound)
+	{
+		const std::size_t depth = m_path.size();
+		const PathStep step = { node, 0 };
+		m_path.push_back(step);
+		
+		for (std::size_t i = 0; i < node->items.size(); i++)
+		{
+			if (!node->childBounds.encloses(i, bound))
+				continue;
+			
+			const bool found = node->hasLeaves ?
+				node->items[i]->bound == bound && static_cast<Leaf*>(node->items[i])->leaf == item :
+				FindLeaf(static_cast<Node*>(node->items[i]), item, bound);
+			
+			if (found)
+			{
+				m_path[depth].index = i;
+				return true;
+			}
+		}
+		
+		m_path.pop_back();
+		return false;
+	}
+	
+	static bool Fits(const BoundingBox &bound, const BoundingBox &item, Coord slack)
+	{
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			if (item.edges[axis].first + slack < bound.edges[axis].first || bound.edges[axis].second + slack < item.edges[axis].second)
+				return false;
+		
+		return true;
+	}
+	
+	// hoja i de node, que ya es modificable; con lectores concurrentes se
+	// cambia por una copia, porque las hojas publicadas no se tocan
+	Leaf * WritableLeaf(Node * node, std::size_t i)
+	{
+		Leaf * leaf = static_cast<Leaf*>(node->items[i]);
+		
+		if (!m_shared)
+			return leaf;
+		
+		Leaf * copy = m_allocator.NewLeaf();
+		*copy = *leaf;
+		
+		m_locator.Remove(leaf);
+		m_locator.Add(copy);
+		DisposeLeaf(leaf);
+		
+		node->items[i] = copy;
+		return copy;
+	}
+
+	void DeleteSubtree(Node * node)
+	{
+		if (node->hasLeaves)
+		{
+			for (std::size_t i = 0; i < node->items.size(); i++)
+				DisposeLeaf(static_cast<Leaf*>(node->items[i]));
+		}
+		else
+			for (std::size_t i = 0; i < node->items.size(); i++)
+				DeleteSubtree(static_cast<Node*>(node->items[i]));
+		
+		DisposeNode(node);
+	}
+	
+	// Arma un arbol empaquetado sobre items (hojas); height recibe el
+	// numero de niveles de nodos, 1 si la raiz tiene hojas
+	Node * Pack(std::vector< BoundedItem* > &items, double fill, RStarBulkOrder order, unsigned threads, std::size_t &height)
+	{
+		std::size_t capacity = (std::size_t)(fill * (double)max_child_items);
+		capacity = std::min(max_child_items, std::max(capacity, std::max<std::size_t>(min_child_items, 2)));
+		
+		if (!threads)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		
+		RStarBulkPacker<BoundedItem, dimensions> packer(capacity, min_child_items, order, threads);
+		std::vector<std::size_t> groups;
+		bool hasLeaves = true;
+		height = 0;
+		
+		do
+		{
+			packer.Pack(items, groups);
+			
+			std::vector< BoundedItem* > nodes;
+			nodes.reserve(groups.size());
+			
+			typename std::vector< BoundedItem* >::iterator it = items.begin();
+			for (std::size_t g = 0; g < groups.size(); g++)
+			{
+				Node * node = NewNode();
+				node->hasLeaves = hasLeaves;
+				node->items.assign(it, it + groups[g]);
+				
+				node->bound.reset();
+				for_each(node->items.begin(), node->items.end(), StretchBoundingBox<BoundedItem>(&node->bound));
+				node->Sync();
+				Summarize(node);
+				
+				nodes.push_back(node);
+				it += groups[g];
+			}
+			
+			items.swap(nodes);
+			hasLeaves = false;
+			height++;
+		}
+		while (items.size() > 1);
+		
+		return static_cast<Node*>(items[0]);
+	}
+	
+	// copia record y su subarbol de un archivo de Save
+	template <typename MappedTree>
+	Node * LoadNode(const MappedTree &mapped, const typename MappedTree::Node &record)
+	{
+		Node * node = NewNode();
+		node->hasLeaves = record.hasLeaves != 0;
+		node->bound = record.bound;
+		
+		for (uint32_t i = 0; i < record.count; i++)
+		{
+			if (node->hasLeaves)
+			{
+				const typename MappedTree::Leaf &stored = mapped.GetLeaves()[record.first + i];
+				
+				Leaf * leaf = m_allocator.NewLeaf();
+				leaf->bound = stored.bound;
+				leaf->leaf  = stored.leaf;
+				m_locator.Add(leaf);
+				node->items.push_back(leaf);
+			}
+			else
+				node->items.push_back(LoadNode(mapped, mapped.GetNodes()[record.first + i]));
+		}
+		
+		node->Sync();
+		Summarize(node);
+		return node;
+	}
+	
+	static std::size_t Height(const Node * node)
+	{
+		std::size_t height = 1;
+		for (; !node->hasLeaves; node = static_cast<const Node*>(node->items[0]))
+			height++;
+		
+		return height;
+	}
+	
+	void Restamp(Node * node)
+	{
+		node->version = m_version;
+		
+		if (!node->hasLeaves)
+			for (std::size_t i = 0; i < node->items.size(); i++)
+				Restamp(static_cast<Node*>(node->items[i]));
+	}
+	
+	// Junta el subarbol subtree (height niveles) con el arbol. El mas bajo
+	// se cuelga dentro del mas alto; si su raiz tiene menos de
+	// min_child_items se cuelgan sus hijos, o se insertan sus hojas.
+	void Graft(Node * subtree, std::size_t height)
+	{
+		// con la misma altura la raiz pasaria a ser un hijo mas; si tiene
+		// menos de min_child_items se reparte ella en vez de subtree
+		if (height > Height(m_root) || (height == Height(m_root) && m_root->items.size() < min_child_items))
+		{
+			std::swap(m_root, subtree);
+			height = Height(subtree);
+		}
+		
+		if (subtree->items.size() >= min_child_items)
+			GraftNode(subtree, height);
+		
+		else
+		{
+			for (std::size_t i = 0; i < subtree->items.size(); i++)
+			{
+				if (subtree->hasLeaves)
+				{
+					m_root = Writable(m_root);
+					InsertInternal(static_cast<Leaf*>(subtree->items[i]), m_root);
+				}
+				else
+					GraftNode(static_cast<Node*>(subtree->items[i]), height - 1);
+			}
+			
+			DisposeNode(subtree);
+		}
+	}
+	
+	void GraftNode(Node * subtree, std::size_t height)
+	{
+		std::size_t rootHeight = Height(m_root);
+		
+		// misma altura: hace falta un nivel mas por encima
+		if (height == rootHeight)
+		{
+			Node * newRoot = NewNode();
+			newRoot->hasLeaves = false;
+			newRoot->items.push_back(m_root);
+			newRoot->bound = m_root->bound;
+			newRoot->Sync();
+			Summarize(newRoot);
+			
+			m_root = newRoot;
+			rootHeight++;
+		}
+		
+		m_root = Writable(m_root);
+		GraftInternal(subtree, m_root, rootHeight - height - 1);
+	}
+	
+	// como InsertInternal, pero baja solo depth niveles y nunca reinserta
+	Node * GraftInternal(Node * subtree, Node * node, std::size_t depth)
+	{
+		node->bound.stretch(subtree->bound);
+		
+		if (!depth)
+		{
+			node->items.push_back(subtree);
+			node->SyncChild(node->items.size() - 1);
+		}
+		else
+		{
+			const std::size_t i = ChooseSubtree(node, subtree->bound);
+			Node * child = WritableChild(node, i);
+			
+			Node * tmp_node = GraftInternal(subtree, child, depth - 1);
+			node->SyncChild(child, i);
+			
+			if (tmp_node)
+			{
+				node->items.push_back(tmp_node);
+				node->SyncChild(node->items.size() - 1);
+			}
+		}
+		
+		Summarize(node);
+		
+		if (node->items.size() > max_child_items)
+			return OverflowTreatment(node, false);
+		
+		return NULL;
+	}
+	
+	// vacia el arbol sin publicar; lo publicado se retira en vez de liberarse
+	void Discard()
+	{
+		const bool trivial = std::is_trivially_destructible<Node>::value && std::is_trivially_destructible<Leaf>::value;
+		
+		if (m_shared)
+		{
+			if (m_root)
+				DeleteSubtree(m_root);
+		}
+		else
+		{
+			if (m_root && !(NodeAllocator::bulk_release && trivial))
+				DeleteSubtree(m_root);
+			
+			m_allocator.ReleaseAll();
 		}
+		
+		m_locator.Clear();
+		m_root = NULL;
+		m_size = 0;
+	}
+	
+	void Modified()
+	{
+		if (m_autoPublish)
+			Publish();
+	}
+	
+	Node * NewNode()
+	{
+		Node * node = m_allocator.NewNode();
+		node->version = m_version;
+		return node;
+	}
+	
+	// nodo que el escritor puede modificar: el mismo si no se publico
+	// todavia, si no una copia; el original se retira
+	Node * Writable(Node * node)
+	{
+		if (!m_shared || node->version == m_version)
+			return node;
+		
+		Node * copy = m_allocator.NewNode();
+		*copy = *node;
+		copy->version = m_version;
+		
+		Retire(node, false);
+		return copy;
+	}
+	
+	// parent ya es modificable; si el hijo i se copia, parent apunta a la copia
+	Node * WritableChild(Node * parent, std::size_t i)
+	{
+		Node * copy = Writable(static_cast<Node*>(parent->items[i]));
+		parent->items[i] = copy;
+		return copy;
+	}
+	
+	void DisposeNode(Node * node)
+	{
+		if (m_shared && node->version != m_version)
+			Retire(node, false);
+		else
+			m_allocator.DeleteNode(node);
+	}
+	
+	// no se sabe si una hoja ya se publico
+	void DisposeLeaf(Leaf * leaf)
+	{
+		if (m_shared)
+			Retire(leaf, true);
+		else
+			m_allocator.DeleteLeaf(leaf);
+	}
+	
+	struct Retired {
+		BoundedItem * item;
+		bool isLeaf;
+		unsigned long epoch;
 	};
 	
+	void Retire(BoundedItem * item, bool isLeaf)
+	{
+		Retired retired = { item, isLeaf, 0 };
+		m_retired.push_back(retired);
+	}
+	
+	void Free(const Retired &retired)
+	{
+		if (retired.isLeaf)
+			m_allocator.DeleteLeaf(static_cast<Leaf*>(retired.item));
+		else
+			m_allocator.DeleteNode(static_cast<Node*>(retired.item));
+	}
+	
+	// libera lo retirado que ningun lector puede estar viendo; las epocas
+	// de m_retired van en orden creciente
+	void Reclaim()
+	{
+		const unsigned long safe = m_epochs.SafeEpoch();
+		
+		std::size_t n = 0;
+		for (; n < m_tagged && m_retired[n].epoch < safe; n++)
+			Free(m_retired[n]);
+		
+		m_retired.erase(m_retired.begin(), m_retired.begin() + n);
+		m_tagged -= n;
+	}
 
 private:
+	RStarTree(const RStarTree &);
+	RStarTree & operator=(const RStarTree &);
+
 	Node * m_root;
 	
 	std::size_t m_size;
+	
+	NodeAllocator m_allocator;
+	LeafLocator m_locator;
+	
+	// camino de trabajo de Update, reutilizado entre llamadas
+	std::vector<PathStep> m_path;
+	
+	// estado para lectores concurrentes, ver EnableConcurrentReaders
+	std::atomic<Node*> m_published;
+	mutable RStarEpochManager m_epochs;
+	
+	unsigned long m_version;
+	std::vector<Retired> m_retired;
+	std::size_t m_tagged;
+	
+	bool m_shared;
+	bool m_autoPublish;
 };
 
 #undef RSTAR_TEMPLATE
 
+#undef RSTAR_BATCH_GRAIN
 #undef RTREE_SPLIT_M
-#undef RTREE_REINSERT_P
-#undef RTREE_CHOOSE_SUBTREE_P
 
 
 
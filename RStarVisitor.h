@@ -2,6 +2,7 @@
  #define RSTARVISITOR_H
  
  #include "RStarBoundingBox.h"
+ #include "RStarSIMD.h"
  
 template <typename Node, typename Leaf>
 struct RStarAcceptOverlapping
@@ -19,6 +20,20 @@ struct RStarAcceptOverlapping
 		return m_bound.overlaps(leaf->bound); 
 	}
 	
+	// Covers(node): acepta todas las hojas de node sin mirarlas, para
+	// QueryAggregate. overlaps es estricto, asi que node tiene que quedar
+	// en el interior: una hoja degenerada en el borde no se solapa
+	bool Covers(const Node * const node) const
+	{
+		const std::size_t dimensions = sizeof(m_bound.edges) / sizeof(m_bound.edges[0]);
+		
+		for (std::size_t axis = 0; axis < dimensions; axis++)
+			if (!(m_bound.edges[axis].first < node->bound.edges[axis].first) || !(node->bound.edges[axis].second < m_bound.edges[axis].second))
+				return false;
+		
+		return true;
+	}
+	
 	private: RStarAcceptOverlapping(){}
 };
 
@@ -39,6 +54,11 @@ struct RStarAcceptEnclosing
 		return m_bound.encloses(leaf->bound); 
 	}
 	
+	bool Covers(const Node * const node) const
+	{
+		return m_bound.encloses(node->bound);
+	}
+	
 	private: RStarAcceptEnclosing(){}
 };
 
@@ -48,6 +68,102 @@ struct RStarAcceptAny
 {
 	bool operator()(const Node * const node) const { return true; }
 	bool operator()(const Leaf * const leaf) const { return true; }
+	bool Covers(const Node * const) const { return true; }
+};
+
+// Solo el camino hasta las hojas de bound exacto: baja por los nodos que lo
+// encierran. Guarda una copia de bound, que puede ser el de una hoja que se
+// libera durante el Remove.
+template <typename Node, typename Leaf>
+struct RStarAcceptContaining
+{
+	const typename Node::BoundingBox m_bound;
+	explicit RStarAcceptContaining(const typename Node::BoundingBox &bound) : m_bound(bound) {}
+	
+	bool operator()(const Node * const node) const 
+	{ 
+		return node->bound.encloses(m_bound);
+	}
+	
+	bool operator()(const Leaf * const leaf) const 
+	{ 
+		return leaf->bound == m_bound; 
+	}
+	
+	private: RStarAcceptContaining(){}
+};
+
+// Marca en hits los hijos de node que acepta el Acceptor. La version
+// generica llama al Acceptor con cada hijo; las especializaciones de abajo
+// prueban todos los hijos a la vez con los kernels de RStarSIMD.h.
+template <typename Acceptor, typename Node, typename Leaf>
+struct RStarChildFilter
+{
+	static void Scan(const Acceptor &accept, const Node * const node, typename Node::HitMask &hits)
+	{
+		hits.clear();
+		
+		for (std::size_t i = 0; i < node->items.size(); i++)
+		{
+			const bool accepted = node->hasLeaves ? 
+				accept(static_cast<const Leaf*>(node->items[i])) : 
+				accept(static_cast<const Node*>(node->items[i]));
+			
+			if (accepted)
+				hits.set(i);
+		}
+	}
+};
+
+template <typename BoundingBox, typename Node>
+inline void RStarScanChildren(typename RStarBoxKernels<typename BoundingBox::coord_type>::Kernel kernel,
+	const BoundingBox &bound, const Node * const node, typename Node::HitMask &hits)
+{
+	const std::size_t dimensions = sizeof(bound.edges) / sizeof(bound.edges[0]);
+	typename BoundingBox::coord_type qfirst[dimensions], qsecond[dimensions];
+	
+	for (std::size_t axis = 0; axis < dimensions; axis++)
+	{
+		qfirst[axis]  = bound.edges[axis].first;
+		qsecond[axis] = bound.edges[axis].second;
+	}
+	
+	hits.clear();
+	kernel(&node->childBounds.first[0][0], &node->childBounds.second[0][0], Node::ChildBounds::stride,
+		dimensions, node->items.size(), qfirst, qsecond, hits.words);
+}
+
+template <typename Node, typename Leaf>
+struct RStarChildFilter< RStarAcceptOverlapping<Node, Leaf>, Node, Leaf >
+{
+	static void Scan(const RStarAcceptOverlapping<Node, Leaf> &accept, const Node * const node, typename Node::HitMask &hits)
+	{
+		typedef typename Node::BoundingBox::coord_type Coord;
+		RStarScanChildren(RStarGetBoxKernels<Coord>().overlaps, accept.m_bound, node, hits);
+	}
+};
+
+template <typename Node, typename Leaf>
+struct RStarChildFilter< RStarAcceptEnclosing<Node, Leaf>, Node, Leaf >
+{
+	static void Scan(const RStarAcceptEnclosing<Node, Leaf> &accept, const Node * const node, typename Node::HitMask &hits)
+	{
+		typedef typename Node::BoundingBox::coord_type Coord;
+		const RStarBoxKernels<Coord> &kernels = RStarGetBoxKernels<Coord>();
+		RStarScanChildren(node->hasLeaves ? kernels.enclosed : kernels.overlaps, accept.m_bound, node, hits);
+	}
+};
+
+template <typename Node, typename Leaf>
+struct RStarChildFilter< RStarAcceptAny<Node, Leaf>, Node, Leaf >
+{
+	static void Scan(const RStarAcceptAny<Node, Leaf> &, const Node * const node, typename Node::HitMask &hits)
+	{
+		hits.clear();
+		
+		for (std::size_t i = 0; i < node->items.size(); i++)
+			hits.set(i);
+	}
 };
 
 template <typename Leaf>
@@ -62,6 +178,23 @@ struct RStarRemoveLeaf{
 	}
 };
 
+// la hoja target y ninguna otra
+template <typename Leaf>
+struct RStarRemoveThisLeaf
+{
+	const bool ContinueVisiting;
+	const Leaf * const m_target;
+	
+	explicit RStarRemoveThisLeaf(const Leaf * const target) : ContinueVisiting(true), m_target(target) {}
+	
+	bool operator()(const Leaf * const leaf) const
+	{
+		return leaf == m_target;
+	}
+	
+	private: RStarRemoveThisLeaf(){}
+};
+
 template <typename Leaf>
 struct RStarRemoveSpecificLeaf
 {
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <string.h>
 
+const Point3D Point3D::ZERO = {0, 0, 0};
+
 void SSTree::initNode(int node, int level){
     if (level < 0){
         int lev;
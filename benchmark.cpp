@@ -0,0 +1,867 @@
+// Benchmark reproducible de RStarTree y SSTree. Genera los datos con una
+// semilla fija, mide cada operacion y escribe los resultados en JSON para
+// comparar builds y parametros.
+//
+//   g++ -O2 -std=c++11 -pthread benchmark.cpp SSTree.cpp -o benchmark
+//   ./benchmark --dataset clustered --n 1000000 --queries 10000 --out run.json
+//
+// Opciones:
+//   --dataset uniform|clustered|zipf|points|msd	(uniform)
+//   --n N				numero de cajas (100000)
+//   --queries Q		consultas por prueba de range/knn/ray/delete/split (10000)
+//   --seed S			semilla de los generadores (1)
+//   --msd archivo		YearPredictionMSD.txt para --dataset msd; la lectura
+//						con RStarCSVLoader sale como "load"
+//   --ops lista		insert,bulk,range,knn,ray,delete,split,sstree (todas) y log
+//   --sstree D,L		grado y niveles del SSTree (8,7)
+//   --out archivo		JSON a un archivo en vez de stdout
+//   --log prefijo		archivos de la prueba log, que se borran (benchmark-log)
+//
+// Los parametros del arbol se eligen al compilar: RSTAR_BENCH_MIN,
+// RSTAR_BENCH_MAX, RSTAR_BENCH_COORD y RSTAR_BENCH_STRATEGY (p.ej.
+// -DRSTAR_BENCH_STRATEGY=RStarStrategyLinear). Las visitas a nodos salen de los
+// contadores de RStarStats.h; con RSTAR_BENCH_NO_COUNTERS no se cuentan.
+
+#ifndef RSTAR_BENCH_NO_COUNTERS
+	#define RSTAR_ENABLE_QUERY_COUNTERS
+#endif
+
+#include "RStarTree.h"
+#include "RStarLog.h"
+#include "RStarCSV.h"
+#include "SSTree.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+
+#include <sys/resource.h>
+
+#ifndef RSTAR_BENCH_MIN
+	#define RSTAR_BENCH_MIN 8
+#endif
+#ifndef RSTAR_BENCH_MAX
+	#define RSTAR_BENCH_MAX 32
+#endif
+#ifndef RSTAR_BENCH_COORD
+	#define RSTAR_BENCH_COORD double
+#endif
+#ifndef RSTAR_BENCH_STRATEGY
+	#define RSTAR_BENCH_STRATEGY RStarStrategyRStar<>
+#endif
+
+#define RSTAR_BENCH_STRING2(x) #x
+#define RSTAR_BENCH_STRING(x) RSTAR_BENCH_STRING2(x)
+
+// los datos sinteticos caen en [0, BENCH_SIDE)^2
+#define BENCH_SIDE 1000000.0
+
+typedef RStarTree<int, 2, RSTAR_BENCH_MIN, RSTAR_BENCH_MAX, RSTAR_BENCH_COORD,
+	RStarPoolAllocator, RStarNoLocator, RSTAR_BENCH_STRATEGY>	BenchTree;
+typedef BenchTree::BoundingBox	BoundingBox;
+typedef BenchTree::Leaf			Leaf;
+
+typedef std::mt19937_64 Random;
+
+
+struct Options {
+	std::string dataset, msdPath, ops, out, logPrefix;
+	std::size_t n, queries;
+	unsigned long seed;
+	int sstreeDegree, sstreeLevels;
+
+	Options() : dataset("uniform"), msdPath("YearPredictionMSD.txt"), ops("insert,bulk,range,knn,ray,delete,split,sstree"), logPrefix("benchmark-log"),
+		n(100000), queries(10000), seed(1), sstreeDegree(8), sstreeLevels(7) {}
+
+	bool Runs(const char * op) const
+	{
+		return ("," + ops + ",").find(std::string(",") + op + ",") != std::string::npos;
+	}
+};
+
+
+BoundingBox Box(double x, double y, double w, double h)
+{
+	BoundingBox bb;
+
+	bb.edges[0].first  = (RSTAR_BENCH_COORD)x;
+	bb.edges[0].second = (RSTAR_BENCH_COORD)(x + w);
+
+	bb.edges[1].first  = (RSTAR_BENCH_COORD)y;
+	bb.edges[1].second = (RSTAR_BENCH_COORD)(y + h);
+
+	return bb;
+}
+
+// lado medio de las cajas: cada una toca unas pocas vecinas
+double Extent(std::size_t n)
+{
+	return BENCH_SIDE / std::sqrt((double)std::max<std::size_t>(n, 1));
+}
+
+void GenerateUniform(std::size_t n, Random &random, std::vector<BoundingBox> &boxes)
+{
+	std::uniform_real_distribution<double> position(0, BENCH_SIDE), size(0, Extent(n));
+
+	for (std::size_t i = 0; i < n; i++)
+		boxes.push_back(Box(position(random), position(random), size(random), size(random)));
+}
+
+// nubes gaussianas alrededor de centros uniformes
+void GenerateClustered(std::size_t n, Random &random, std::vector<BoundingBox> &boxes)
+{
+	const std::size_t clusters = 16 + n / 50000;
+	const double sigma = BENCH_SIDE / (8 * std::sqrt((double)clusters));
+
+	std::uniform_real_distribution<double> position(0, BENCH_SIDE), size(0, Extent(n) / 4);
+	std::vector<double> cx(clusters), cy(clusters);
+
+	for (std::size_t c = 0; c < clusters; c++)
+	{
+		cx[c] = position(random);
+		cy[c] = position(random);
+	}
+
+	std::uniform_int_distribution<std::size_t> pick(0, clusters - 1);
+	std::normal_distribution<double> offset(0, sigma);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const std::size_t c = pick(random);
+		const double x = std::min(std::max(cx[c] + offset(random), 0.0), BENCH_SIDE);
+		const double y = std::min(std::max(cy[c] + offset(random), 0.0), BENCH_SIDE);
+		boxes.push_back(Box(x, y, size(random), size(random)));
+	}
+}
+
+// cada eje se parte en celdas; la celda de rango r sale con probabilidad
+// proporcional a 1/r, asi que los datos se amontonan cerca del origen
+void GenerateZipf(std::size_t n, Random &random, std::vector<BoundingBox> &boxes)
+{
+	const std::size_t cells = 1024;
+	std::vector<double> cdf(cells);
+
+	double total = 0;
+	for (std::size_t r = 0; r < cells; r++)
+		cdf[r] = total += 1.0 / (double)(r + 1);
+
+	std::uniform_real_distribution<double> unit(0, 1), size(0, Extent(n) / 4);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		double coords[2];
+		for (std::size_t axis = 0; axis < 2; axis++)
+		{
+			const std::size_t cell = std::lower_bound(cdf.begin(), cdf.end(), unit(random) * total) - cdf.begin();
+			coords[axis] = ((double)std::min(cell, cells - 1) + unit(random)) * BENCH_SIDE / cells;
+		}
+
+		boxes.push_back(Box(coords[0], coords[1], size(random), size(random)));
+	}
+}
+
+// cajas de area cero
+void GeneratePoints(std::size_t n, Random &random, std::vector<BoundingBox> &boxes)
+{
+	std::uniform_real_distribution<double> position(0, BENCH_SIDE);
+
+	for (std::size_t i = 0; i < n; i++)
+		boxes.push_back(Box(position(random), position(random), 0, 0));
+}
+
+// Como main.cpp: atributos 1-4 de cada linea son x, y, ancho y alto. Los
+// anchos negativos se toman en valor absoluto para que la caja sea valida.
+// stats recibe filas y bytes por segundo de RStarCSVLoader.
+bool LoadMSD(const std::string &path, std::size_t n, std::vector<BoundingBox> &boxes, RStarCSVStats &stats)
+{
+	RStarCSVLayout<2> layout;
+	layout.extent = true;
+	layout.Set(0, 1, 3).Set(1, 2, 4);
+
+	RStarCSVLoader<2, RSTAR_BENCH_COORD> loader(layout);
+	loader.SetLimit(n);
+
+	std::vector<RStarCSVLoader<2, RSTAR_BENCH_COORD>::Item> items;
+	if (!loader.ReadAll(path.c_str(), items))
+		return false;
+
+	stats = loader.GetStats();
+
+	for (std::size_t i = 0; i < items.size(); i++)
+		boxes.push_back(items[i].second);
+
+	return !boxes.empty();
+}
+
+bool Generate(const Options &options, std::vector<BoundingBox> &boxes, RStarCSVStats &load)
+{
+	Random random(options.seed);
+	boxes.reserve(options.n);
+
+	if (options.dataset == "uniform")
+		GenerateUniform(options.n, random, boxes);
+	else if (options.dataset == "clustered")
+		GenerateClustered(options.n, random, boxes);
+	else if (options.dataset == "zipf")
+		GenerateZipf(options.n, random, boxes);
+	else if (options.dataset == "points")
+		GeneratePoints(options.n, random, boxes);
+	else if (options.dataset == "msd")
+		return LoadMSD(options.msdPath, options.n, boxes, load);
+	else
+		return false;
+
+	return true;
+}
+
+
+// ---- medicion ----
+
+typedef std::chrono::steady_clock Clock;
+
+double Nanoseconds(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+long PeakRSS()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;		// KB en Linux
+}
+
+// Una fila del JSON. Los campos que no aplican quedan en -1 y no se escriben.
+struct Result {
+	std::string name, tree;
+	double parameter;
+	std::size_t ops;
+	double seconds;
+
+	// latencias por operacion (ns)
+	std::vector<double> latencies;
+
+	double hits, nodesVisited, leavesTested;
+	double bytesPerSecond;
+	long rss;
+
+	Result(const std::string &n, const std::string &t = "", double p = -1) :
+		name(n), tree(t), parameter(p), ops(0), seconds(0), hits(-1), nodesVisited(-1), leavesTested(-1), bytesPerSecond(-1), rss(0) {}
+
+	double Percentile(double p) const
+	{
+		if (latencies.empty())
+			return -1;
+
+		const std::size_t i = std::min(latencies.size() - 1, (std::size_t)(p * (double)latencies.size()));
+		return latencies[i];
+	}
+
+	void Finish(const RStarQueryCounters &before)
+	{
+		std::sort(latencies.begin(), latencies.end());
+
+		if (ops)
+		{
+			double total = 0;
+			for (std::size_t i = 0; i < latencies.size(); i++)
+				total += latencies[i];
+
+			if (!latencies.empty())
+				seconds = total * 1e-9;
+
+#ifdef RSTAR_ENABLE_QUERY_COUNTERS
+			const RStarQueryCounters used = RStarQueryCounters::Local() - before;
+			if (used.nodesVisited)
+			{
+				nodesVisited = (double)used.nodesVisited / ops;
+				leavesTested = (double)used.leavesTested / ops;
+			}
+#else
+			(void)before;
+#endif
+		}
+
+		rss = PeakRSS();
+	}
+};
+
+struct CountHits {
+	bool ContinueVisiting;
+	std::size_t hits;
+
+	CountHits() : ContinueVisiting(true), hits(0) {}
+
+	void operator()(const Leaf * const) { hits++; }
+	void operator()(const Leaf * const, double) { hits++; }
+	void operator()(std::size_t, const Leaf * const, double) { hits++; }
+};
+
+
+void RunInsert(const std::vector<BoundingBox> &boxes, BenchTree &tree, std::vector<Result> &results)
+{
+	Result result("insert", "insert");
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+
+	result.latencies.reserve(boxes.size());
+	for (std::size_t i = 0; i < boxes.size(); i++)
+	{
+		const Clock::time_point start = Clock::now();
+		tree.Insert((int)i, boxes[i]);
+		result.latencies.push_back(Nanoseconds(start, Clock::now()));
+	}
+
+	result.ops = boxes.size();
+	result.Finish(before);
+	results.push_back(result);
+}
+
+void RunBulk(const std::vector<BoundingBox> &boxes, BenchTree &tree, std::vector<Result> &results)
+{
+	std::vector< std::pair<int, BoundingBox> > items;
+	items.reserve(boxes.size());
+	for (std::size_t i = 0; i < boxes.size(); i++)
+		items.push_back(std::make_pair((int)i, boxes[i]));
+
+	Result result("bulk", "bulk");
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+
+	const Clock::time_point start = Clock::now();
+	tree.BulkLoad(items.begin(), items.end());
+	result.seconds = Nanoseconds(start, Clock::now()) * 1e-9;
+
+	result.ops = boxes.size();
+	result.Finish(before);
+	results.push_back(result);
+}
+
+// cajas cuadradas de area selectivity * BENCH_SIDE^2 centradas en datos
+void RunRange(const std::vector<BoundingBox> &boxes, const Options &options, const char * name, BenchTree &tree,
+	std::vector<Result> &results)
+{
+	const double selectivities[] = { 0.00001, 0.0001, 0.001, 0.01 };
+
+	for (std::size_t s = 0; s < sizeof(selectivities) / sizeof(selectivities[0]); s++)
+	{
+		Random random(options.seed + 1);
+		std::uniform_int_distribution<std::size_t> pick(0, boxes.size() - 1);
+		const double side = std::sqrt(selectivities[s]) * BENCH_SIDE;
+
+		Result result("range", name, selectivities[s]);
+		std::size_t hits = 0;
+
+		const RStarQueryCounters before = RStarQueryCounters::Local();
+		result.latencies.reserve(options.queries);
+
+		for (std::size_t q = 0; q < options.queries; q++)
+		{
+			const BoundingBox &center = boxes[pick(random)];
+			const BoundingBox query = Box((double)center.edges[0].first - side / 2, (double)center.edges[1].first - side / 2, side, side);
+
+			const Clock::time_point start = Clock::now();
+			hits += tree.Query(BenchTree::AcceptOverlapping(query), CountHits()).hits;
+			result.latencies.push_back(Nanoseconds(start, Clock::now()));
+		}
+
+		result.ops = options.queries;
+		result.hits = (double)hits / options.queries;
+		result.Finish(before);
+		results.push_back(result);
+	}
+}
+
+void RunNearest(const Options &options, const char * name, BenchTree &tree, std::vector<Result> &results)
+{
+	const std::size_t ks[] = { 1, 10, 100 };
+	BenchTree::NearestBuffer buffer;
+
+	for (std::size_t k = 0; k < sizeof(ks) / sizeof(ks[0]); k++)
+	{
+		Random random(options.seed + 2);
+		std::uniform_real_distribution<double> position(0, BENCH_SIDE);
+
+		Result result("knn", name, (double)ks[k]);
+		std::size_t hits = 0;
+
+		const RStarQueryCounters before = RStarQueryCounters::Local();
+		result.latencies.reserve(options.queries);
+
+		for (std::size_t q = 0; q < options.queries; q++)
+		{
+			RStarPoint<2> point;
+			point.coords[0] = position(random);
+			point.coords[1] = position(random);
+
+			const Clock::time_point start = Clock::now();
+			hits += tree.QueryNearest(point, ks[k], CountHits(), buffer).hits;
+			result.latencies.push_back(Nanoseconds(start, Clock::now()));
+		}
+
+		result.ops = options.queries;
+		result.hits = (double)hits / options.queries;
+		result.Finish(before);
+		results.push_back(result);
+	}
+}
+
+// Segmentos de 10 * Extent desde puntos al azar, en grupos de
+// RSTAR_RAY_PACKET con el mismo origen y direcciones en un cono de 0.1 rad,
+// como los rayos de picking o de un frustum. ray los consulta de a uno y
+// ray_packet de a un paquete; en ray_packet las latencias son por paquete.
+void RunRay(const std::vector<BoundingBox> &boxes, const Options &options, const char * name, BenchTree &tree,
+	std::vector<Result> &results)
+{
+	const std::size_t ks[] = { 1, 16 };
+	const std::size_t width = BenchTree::RayPacket::width;
+	const double length = 10 * Extent(boxes.size());
+
+	Random random(options.seed + 4);
+	std::uniform_real_distribution<double> position(0, BENCH_SIDE), angle(0, 2 * std::acos(-1.0)), spread(-0.05, 0.05);
+
+	std::vector<BenchTree::Ray> rays(options.queries);
+	for (std::size_t q = 0; q < rays.size(); q += width)
+	{
+		RStarPoint<2> from;
+		from.coords[0] = position(random);
+		from.coords[1] = position(random);
+
+		const double heading = angle(random);
+
+		for (std::size_t r = q; r < std::min(q + width, rays.size()); r++)
+		{
+			const double a = heading + spread(random);
+
+			RStarPoint<2> to;
+			to.coords[0] = from.coords[0] + length * std::cos(a);
+			to.coords[1] = from.coords[1] + length * std::sin(a);
+
+			rays[r] = BenchTree::Ray::Segment(from, to);
+		}
+	}
+
+	BenchTree::NearestBuffer buffer;
+	BenchTree::RayPacketBuffer packetBuffer;
+
+	for (std::size_t k = 0; k < sizeof(ks) / sizeof(ks[0]); k++)
+	{
+		Result result("ray", name, (double)ks[k]);
+		std::size_t hits = 0;
+
+		RStarQueryCounters before = RStarQueryCounters::Local();
+		result.latencies.reserve(rays.size());
+
+		for (std::size_t q = 0; q < rays.size(); q++)
+		{
+			const Clock::time_point start = Clock::now();
+			hits += tree.QueryRay(rays[q], ks[k], CountHits(), buffer).hits;
+			result.latencies.push_back(Nanoseconds(start, Clock::now()));
+		}
+
+		result.ops = rays.size();
+		result.hits = (double)hits / rays.size();
+		result.Finish(before);
+		results.push_back(result);
+
+		Result packet("ray_packet", name, (double)ks[k]);
+		hits = 0;
+
+		before = RStarQueryCounters::Local();
+		packet.latencies.reserve(rays.size() / width + 1);
+
+		for (std::size_t q = 0; q < rays.size(); q += width)
+		{
+			const Clock::time_point start = Clock::now();
+			hits += tree.QueryRayPacket(&rays[q], std::min(width, rays.size() - q), ks[k], CountHits(), packetBuffer).hits;
+			packet.latencies.push_back(Nanoseconds(start, Clock::now()));
+		}
+
+		packet.ops = rays.size();
+		packet.hits = (double)hits / rays.size();
+		packet.Finish(before);
+		results.push_back(packet);
+	}
+}
+
+// RemoveItem con el bound conocido, sin repetir items
+void RunDelete(const std::vector<BoundingBox> &boxes, const Options &options, BenchTree &tree, std::vector<Result> &results)
+{
+	std::vector<std::size_t> order(boxes.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	Random random(options.seed + 3);
+	std::shuffle(order.begin(), order.end(), random);
+	order.resize(std::min(order.size(), options.queries));
+
+	Result result("delete", "insert");
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+	result.latencies.reserve(order.size());
+
+	for (std::size_t i = 0; i < order.size(); i++)
+	{
+		const Clock::time_point start = Clock::now();
+		tree.RemoveItem((int)order[i], boxes[order[i]]);
+		result.latencies.push_back(Nanoseconds(start, Clock::now()));
+	}
+
+	result.ops = order.size();
+	result.Finish(before);
+	results.push_back(result);
+}
+
+// Solo el Split de RSTAR_BENCH_STRATEGY, sobre nodos hoja de max + 1 cajas
+// consecutivas del dataset tomadas al azar; las latencias son por split.
+// Sirve para comparar el costo por split entre builds o estrategias.
+void RunSplit(const std::vector<BoundingBox> &boxes, const Options &options, std::vector<Result> &results)
+{
+	typedef BenchTree::Node Node;
+	const std::size_t n = RSTAR_BENCH_MAX + 1;
+
+	if (boxes.size() < n)
+		return;
+
+	Random random(options.seed + 5);
+	std::uniform_int_distribution<std::size_t> pick(0, boxes.size() - n);
+
+	std::vector<Leaf> leaves(n);
+	Node node;
+	node.hasLeaves = true;
+
+	Result result("split", "node", (double)n);
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+	result.latencies.reserve(options.queries);
+
+	for (std::size_t q = 0; q < options.queries; q++)
+	{
+		const std::size_t first = pick(random);
+
+		node.items.clear();
+		for (std::size_t i = 0; i < n; i++)
+		{
+			leaves[i].bound = boxes[first + i];
+			leaves[i].leaf = (int)(first + i);
+			node.items.push_back(&leaves[i]);
+		}
+		node.Sync();
+
+		const Clock::time_point start = Clock::now();
+		RSTAR_BENCH_STRATEGY::Split<RSTAR_BENCH_MIN>(&node);
+		result.latencies.push_back(Nanoseconds(start, Clock::now()));
+	}
+
+	result.ops = options.queries;
+	result.Finish(before);
+	results.push_back(result);
+}
+
+// RStarLoggedTree con los valores por omision (group commit y fdatasync):
+// insert con log, arranque reaplicando todo el log, checkpoint y arranque
+// desde el checkpoint. Los archivos quedan en --log y se borran al final.
+typedef RStarLoggedTree<BenchTree> LoggedTree;
+
+bool RunLog(const std::vector<BoundingBox> &boxes, const Options &options, std::vector<Result> &results)
+{
+	const char * prefix = options.logPrefix.c_str();
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+	LoggedTree::Destroy(prefix);
+
+	{
+		LoggedTree tree;
+		if (!tree.Open(prefix))
+			return false;
+
+		Result result("log_insert", "logged");
+		result.latencies.reserve(boxes.size());
+
+		for (std::size_t i = 0; i < boxes.size(); i++)
+		{
+			const Clock::time_point start = Clock::now();
+			tree.Insert((int)i, boxes[i]);
+			result.latencies.push_back(Nanoseconds(start, Clock::now()));
+		}
+
+		if (!tree.Close())
+			return false;
+
+		result.ops = boxes.size();
+		result.Finish(before);
+		results.push_back(result);
+	}
+
+	LoggedTree tree;
+
+	Result replay("log_replay", "logged");
+	Clock::time_point start = Clock::now();
+	if (!tree.Open(prefix))
+		return false;
+	replay.seconds = Nanoseconds(start, Clock::now()) * 1e-9;
+	replay.ops = tree.GetStats().replayed;
+	replay.Finish(before);
+	results.push_back(replay);
+
+	Result checkpoint("checkpoint", "logged");
+	start = Clock::now();
+	if (!tree.Checkpoint())
+		return false;
+	checkpoint.seconds = Nanoseconds(start, Clock::now()) * 1e-9;
+	checkpoint.ops = tree.GetSize();
+	checkpoint.Finish(before);
+	results.push_back(checkpoint);
+
+	if (!tree.Close())
+		return false;
+
+	Result load("checkpoint_load", "logged");
+	start = Clock::now();
+	if (!tree.Open(prefix))
+		return false;
+	load.seconds = Nanoseconds(start, Clock::now()) * 1e-9;
+	load.ops = tree.GetStats().loadedLeaves;
+	load.Finish(before);
+	results.push_back(load);
+
+	tree.Close();
+	return LoggedTree::Destroy(prefix);
+}
+
+// setupTree deja todas las esferas invalidas (r < 0); se llenan con las
+// cajas del dataset, centro y media diagonal, para que getLevel copie algo
+void RunSSTree(const std::vector<BoundingBox> &boxes, const Options &options, std::vector<Result> &results)
+{
+	const RStarQueryCounters before = RStarQueryCounters::Local();
+	SSTree tree;
+
+	Result setup("sstree_setup", "sstree", options.sstreeDegree);
+	const Clock::time_point start = Clock::now();
+	tree.setupTree(options.sstreeDegree, options.sstreeLevels);
+	setup.seconds = Nanoseconds(start, Clock::now()) * 1e-9;
+	setup.ops = tree.nodes.getSize();
+	setup.Finish(before);
+	results.push_back(setup);
+
+	for (int i = 0; i < tree.nodes.getSize(); i++)
+	{
+		const BoundingBox &box = boxes[i % boxes.size()];
+		const double w = (double)box.edges[0].second - (double)box.edges[0].first;
+		const double h = (double)box.edges[1].second - (double)box.edges[1].first;
+
+		STSphere &sphere = tree.nodes.index(i);
+		sphere.c.x = (double)box.edges[0].first + w / 2;
+		sphere.c.y = (double)box.edges[1].first + h / 2;
+		sphere.c.z = 0;
+		sphere.r = std::max(std::sqrt(w*w + h*h) / 2, 1e-6);
+	}
+
+	for (int level = 0; level < options.sstreeLevels; level++)
+	{
+		Array<Sphere> spheres;
+		Result result("sstree_level", "sstree", level);
+
+		const Clock::time_point levelStart = Clock::now();
+		tree.getLevel(&spheres, level);
+		result.latencies.push_back(Nanoseconds(levelStart, Clock::now()));
+
+		result.ops = 1;
+		result.hits = spheres.getSize();
+		result.Finish(before);
+		results.push_back(result);
+	}
+}
+
+
+// ---- salida ----
+
+void WriteNumber(FILE * f, const char * key, double value)
+{
+	if (value >= 0)
+		fprintf(f, ", \"%s\": %.6g", key, value);
+}
+
+void WriteJSON(FILE * f, const Options &options, std::size_t loaded, const std::vector<Result> &results)
+{
+	fprintf(f, "{\n");
+	fprintf(f, "  \"dataset\": \"%s\", \"n\": %lu, \"queries\": %lu, \"seed\": %lu,\n",
+		options.dataset.c_str(), (unsigned long)loaded, (unsigned long)options.queries, options.seed);
+	fprintf(f, "  \"config\": {\"min_child_items\": %d, \"max_child_items\": %d, \"coord\": \"%s\", \"strategy\": \"%s\", \"simd\": \"%s\", \"counters\": %s},\n",
+		RSTAR_BENCH_MIN, RSTAR_BENCH_MAX, RSTAR_BENCH_STRING(RSTAR_BENCH_COORD), RSTAR_BENCH_STRING(RSTAR_BENCH_STRATEGY),
+		RStarGetBoxKernels<RSTAR_BENCH_COORD>().name,
+#ifdef RSTAR_ENABLE_QUERY_COUNTERS
+		"true"
+#else
+		"false"
+#endif
+		);
+	fprintf(f, "  \"results\": [\n");
+
+	for (std::size_t r = 0; r < results.size(); r++)
+	{
+		const Result &result = results[r];
+
+		fprintf(f, "    {\"name\": \"%s\", \"tree\": \"%s\"", result.name.c_str(), result.tree.c_str());
+		WriteNumber(f, "parameter", result.parameter);
+		fprintf(f, ", \"ops\": %lu, \"seconds\": %.6g", (unsigned long)result.ops, result.seconds);
+		WriteNumber(f, "ops_per_second", result.seconds > 0 ? result.ops / result.seconds : -1);
+
+		if (result.latencies.size() > 1)
+		{
+			WriteNumber(f, "p50_ns", result.Percentile(0.5));
+			WriteNumber(f, "p90_ns", result.Percentile(0.9));
+			WriteNumber(f, "p99_ns", result.Percentile(0.99));
+			WriteNumber(f, "p999_ns", result.Percentile(0.999));
+			WriteNumber(f, "max_ns", result.latencies.back());
+		}
+
+		WriteNumber(f, "hits", result.hits);
+		WriteNumber(f, "nodes_visited", result.nodesVisited);
+		WriteNumber(f, "leaves_tested", result.leavesTested);
+		WriteNumber(f, "bytes_per_second", result.bytesPerSecond);
+		fprintf(f, ", \"peak_rss_kb\": %ld}%s\n", result.rss, r + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(f, "  ]\n}\n");
+}
+
+
+bool ParseOptions(int argc, char ** argv, Options &options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+
+		if (i + 1 >= argc)
+			return false;
+
+		const char * value = argv[++i];
+
+		if (arg == "--dataset")
+			options.dataset = value;
+		else if (arg == "--n")
+			options.n = std::strtoul(value, NULL, 10);
+		else if (arg == "--queries")
+			options.queries = std::strtoul(value, NULL, 10);
+		else if (arg == "--seed")
+			options.seed = std::strtoul(value, NULL, 10);
+		else if (arg == "--msd")
+			options.msdPath = value;
+		else if (arg == "--ops")
+			options.ops = value;
+		else if (arg == "--out")
+			options.out = value;
+		else if (arg == "--log")
+			options.logPrefix = value;
+		else if (arg == "--sstree")
+		{
+			if (std::sscanf(value, "%d,%d", &options.sstreeDegree, &options.sstreeLevels) != 2)
+				return false;
+		}
+		else
+			return false;
+	}
+
+	return options.n > 0 && options.queries > 0 && options.sstreeDegree > 1 && options.sstreeLevels > 0;
+}
+
+int main(int argc, char ** argv)
+{
+	Options options;
+
+	if (!ParseOptions(argc, argv, options))
+	{
+		fprintf(stderr, "uso: %s [--dataset uniform|clustered|zipf|points|msd] [--n N] [--queries Q] [--seed S]\n"
+			"       [--msd archivo] [--ops insert,bulk,range,knn,ray,delete,split,sstree,log] [--sstree grado,niveles] [--out archivo]\n"
+			"       [--log prefijo]\n", argv[0]);
+		return 2;
+	}
+
+	std::vector<BoundingBox> boxes;
+	RStarCSVStats load;
+	if (!Generate(options, boxes, load))
+	{
+		fprintf(stderr, "no se pudo generar el dataset '%s'\n", options.dataset.c_str());
+		return 1;
+	}
+
+	std::vector<Result> results;
+
+	// lectura del archivo de --dataset msd
+	if (load.rows)
+	{
+		Result result("load", "csv");
+		result.ops = load.rows;
+		result.bytesPerSecond = load.BytesPerSecond();
+		result.Finish(RStarQueryCounters::Local());
+		result.seconds = load.seconds;
+		results.push_back(result);
+	}
+
+	{
+		BenchTree inserted, bulk;
+
+		if (options.Runs("insert"))
+			RunInsert(boxes, inserted, results);
+
+		if (options.Runs("bulk"))
+			RunBulk(boxes, bulk, results);
+
+		if (options.Runs("range"))
+		{
+			if (inserted.GetSize())
+				RunRange(boxes, options, "insert", inserted, results);
+			if (bulk.GetSize())
+				RunRange(boxes, options, "bulk", bulk, results);
+		}
+
+		if (options.Runs("knn"))
+		{
+			if (inserted.GetSize())
+				RunNearest(options, "insert", inserted, results);
+			if (bulk.GetSize())
+				RunNearest(options, "bulk", bulk, results);
+		}
+
+		if (options.Runs("ray"))
+		{
+			if (inserted.GetSize())
+				RunRay(boxes, options, "insert", inserted, results);
+			if (bulk.GetSize())
+				RunRay(boxes, options, "bulk", bulk, results);
+		}
+
+		if (options.Runs("delete") && inserted.GetSize())
+			RunDelete(boxes, options, inserted, results);
+	}
+
+	if (options.Runs("split"))
+		RunSplit(boxes, options, results);
+
+	if (options.Runs("sstree"))
+		RunSSTree(boxes, options, results);
+
+	if (options.Runs("log") && !RunLog(boxes, options, results))
+	{
+		fprintf(stderr, "fallo la prueba log con '%s'\n", options.logPrefix.c_str());
+		return 1;
+	}
+
+	FILE * f = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+	if (!f)
+	{
+		fprintf(stderr, "no se pudo escribir '%s'\n", options.out.c_str());
+		return 1;
+	}
+
+	WriteJSON(f, options, boxes.size(), results);
+
+	if (f != stdout)
+		fclose(f);
+
+	return 0;
+}
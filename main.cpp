@@ -4,6 +4,7 @@
 #include <vector>
 #include <stdio.h>
 #include "RStarTree.h"
+#include "RStarCSV.h"
 #include <cstdlib>
 #include "SSTree.h"
 #include <fstream>
@@ -13,15 +14,15 @@ using namespace std;
 
 
 #ifdef RANDOM_DATASET
-	typedef RStarTree<int, 2, 32, 64> 			RsTree;
+	typedef RStarTree<int, 2, 32, 64, double> 			RsTree;
 #else
-	typedef RStarTree<std::string, 2, 2, 3> 	RsTree;
+	typedef RStarTree<std::string, 2, 2, 3, double> 	RsTree;
 #endif
 
 typedef RsTree::BoundingBox			BoundingBox;
 
 
-BoundingBox bounds(int x, int y, int w, int h)
+BoundingBox bounds(double x, double y, double w, double h)
 {
 	BoundingBox bb;
 
@@ -63,36 +64,22 @@ int main(int argc, char ** argv)
 	Visitor x;
     //int dimension, dataSize, blockSize;
 
-    string cadena;
-    string lineas;
-    vector<double> atributos;
-    string temp = "";
-    ifstream fs("YearPredictionMSD.txt");
-    for(int i=0;i<100;i++)
+    // los primeros 100 registros: atributos 1 y 2 son x e y, 3 y 4 ancho y alto
+    RStarCSVLayout<2> layout;
+    layout.extent = true;
+    layout.Set(0, 1, 3).Set(1, 2, 4);
+
+    RStarCSVLoader<2, double> loader(layout);
+    loader.SetLimit(100);
+
+    if (loader.Insert("YearPredictionMSD.txt", tree))
     {
-        getline(fs, cadena);
-        lineas += cadena;
-        lineas += ",";
-
-        for(int a = 0; a < lineas.size(); a++)
-        {
-            if(lineas[a] != ',')
-            {
-                temp += lineas[a];
-            }
-            else{
-                atributos.push_back(strtod(temp.c_str(), 0));
-                temp.clear();
-            }
-        }
-
-        tree.Insert(i, bounds( atributos[1], atributos[2], atributos[3], atributos[4]));
-
-        temp.clear();
-        atributos.clear();
-
-        lineas.clear();
+        const RStarCSVStats &stats = loader.GetStats();
+        std::cout << "Loaded " << stats.rows << " rows (" << stats.RowsPerSecond() << " rows/s, "
+            << stats.BytesPerSecond() / 1e6 << " MB/s)" << std::endl;
     }
+    else
+        std::cout << "Could not read YearPredictionMSD.txt" << std::endl;
 
 
 #ifdef RANDOM_DATASET
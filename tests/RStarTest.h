@@ -0,0 +1,211 @@
+#ifndef RSTARTEST_H
+#define RSTARTEST_H
+
+// Apoyo de las pruebas de tests/. Cada prueba es un programa que compara el
+// arbol contra una busqueda por fuerza bruta y termina con 1 si algo falla.
+// Desde la raiz del repositorio, todas:
+//
+//   for t in nearest snapshot file remove update log choose bulk paged; do
+//       g++ -O2 -std=c++11 -pthread tests/$t.cpp -o $t && ./$t || break; done
+
+#include <cstdio>
+#include <cstddef>
+#include <random>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+
+#include "../RStarBoundingBox.h"
+
+// atomico: las pruebas con hilos fallan desde cualquiera
+static std::atomic<int> rstar_test_failures(0);
+
+// solo se imprimen las primeras fallas; se cuentan todas
+#define RSTAR_CHECK(condition) \
+	do { \
+		if (!(condition) && rstar_test_failures++ < 20) \
+			std::printf("%s:%d: falla %s\n", __FILE__, __LINE__, #condition); \
+	} while (0)
+
+inline int RStarTestResult(const char * name)
+{
+	if (rstar_test_failures)
+		std::printf("%s: %d fallas\n", name, rstar_test_failures.load());
+	else
+		std::printf("%s: ok\n", name);
+
+	return rstar_test_failures ? 1 : 0;
+}
+
+typedef std::mt19937 RStarTestRandom;
+
+// caja con esquina en [0, side) por eje y lados en [0, maxSide]; con lado 0
+// sale degenerada, como un punto
+template <std::size_t dimensions, typename Coord>
+RStarBoundingBox<dimensions, Coord> RStarTestBox(RStarTestRandom &random, int side, int maxSide)
+{
+	std::uniform_int_distribution<int> position(0, side - 1), size(0, maxSide);
+
+	RStarBoundingBox<dimensions, Coord> bound;
+	for (std::size_t axis = 0; axis < dimensions; axis++)
+	{
+		bound.edges[axis].first = (Coord)position(random);
+		bound.edges[axis].second = bound.edges[axis].first + (Coord)size(random);
+	}
+
+	return bound;
+}
+
+template <std::size_t dimensions>
+RStarPoint<dimensions> RStarTestPoint(RStarTestRandom &random, int side)
+{
+	std::uniform_real_distribution<double> position(-side / 8.0, side * 9 / 8.0);
+
+	RStarPoint<dimensions> point;
+	for (std::size_t axis = 0; axis < dimensions; axis++)
+		point.coords[axis] = position(random);
+
+	return point;
+}
+
+// Items vivos del arbol por id, para las respuestas por fuerza bruta
+template <std::size_t dimensions, typename Coord>
+struct RStarTestItems {
+
+	typedef RStarBoundingBox<dimensions, Coord> BoundingBox;
+	enum { item_dimensions = dimensions };
+
+	std::vector<BoundingBox> bounds;
+	std::vector<bool> live;
+
+	int Add(const BoundingBox &bound)
+	{
+		bounds.push_back(bound);
+		live.push_back(true);
+		return (int)bounds.size() - 1;
+	}
+
+	std::size_t Size() const
+	{
+		return (std::size_t)std::count(live.begin(), live.end(), true);
+	}
+
+	// ids ordenados de los vivos que acepta RStarAcceptOverlapping(bound);
+	// overlaps es estricto, asi que tocarse en un borde no cuenta
+	std::vector<int> Overlapping(const BoundingBox &bound) const
+	{
+		std::vector<int> ids;
+		for (std::size_t i = 0; i < bounds.size(); i++)
+			if (live[i] && bound.overlaps(bounds[i]))
+				ids.push_back((int)i);
+
+		return ids;
+	}
+
+	// las k menores distancias al cuadrado de point a los vivos
+	std::vector<double> Nearest(const RStarPoint<dimensions> &point, std::size_t k) const
+	{
+		std::vector<double> distances;
+		for (std::size_t i = 0; i < bounds.size(); i++)
+			if (live[i])
+				distances.push_back(bounds[i].minDistance(point));
+
+		std::sort(distances.begin(), distances.end());
+		if (distances.size() > k)
+			distances.resize(k);
+
+		return distances;
+	}
+};
+
+// visitor que junta los ids de las hojas, para RStarTree, RStarMappedTree
+// y los Snapshot
+template <typename Leaf>
+struct RStarTestCollect
+{
+	bool ContinueVisiting;
+	std::vector<int> ids;
+
+	RStarTestCollect() : ContinueVisiting(true) {}
+
+	void operator()(const Leaf * const leaf) { ids.push_back((int)leaf->leaf); }
+};
+
+// queries consultas de rango al azar contra la fuerza bruta
+template <typename Tree, typename Items>
+void RStarTestCheckRange(Tree &tree, const Items &items, RStarTestRandom &random, std::size_t queries)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+
+	for (std::size_t q = 0; q < queries; q++)
+	{
+		const BoundingBox bound = RStarTestBox<Items::item_dimensions, Coord>(random, 1000, 100);
+
+		RStarTestCollect<typename Tree::Leaf> found =
+			tree.Query(typename Tree::AcceptOverlapping(bound), RStarTestCollect<typename Tree::Leaf>());
+		std::sort(found.ids.begin(), found.ids.end());
+
+		RSTAR_CHECK(found.ids == items.Overlapping(bound));
+	}
+}
+
+// Estructura del arbol: bounds que encierran a los hijos, childBounds al
+// dia, entre min y max hijos y hojas todas a la misma altura
+template <typename Tree>
+std::size_t RStarTestCheckNode(const typename Tree::Node * node, std::size_t depth, std::size_t &leafDepth, std::size_t min, std::size_t max)
+{
+	typedef typename Tree::Node Node;
+
+	RSTAR_CHECK(node->items.size() >= min && node->items.size() <= max);
+
+	std::size_t leaves = 0;
+	for (std::size_t i = 0; i < node->items.size(); i++)
+	{
+		RSTAR_CHECK(node->bound.encloses(node->items[i]->bound));
+		RSTAR_CHECK(node->childBounds.get(i) == node->items[i]->bound);
+
+		if (node->hasLeaves)
+			leaves++;
+		else
+			leaves += RStarTestCheckNode<Tree>(static_cast<const Node*>(node->items[i]), depth + 1, leafDepth, min, max);
+	}
+
+	if (node->hasLeaves)
+	{
+		if (leafDepth == 0)
+			leafDepth = depth;
+		RSTAR_CHECK(leafDepth == depth);
+	}
+
+	return leaves;
+}
+
+// la raiz puede tener menos de min hijos; los demas nodos no
+template <typename Tree>
+void RStarTestCheckStructure(const Tree &tree, std::size_t min, std::size_t max)
+{
+	typedef typename Tree::Node Node;
+	const Node * root = tree.GetRoot();
+
+	if (!root || !tree.GetSize())
+		return;
+
+	std::size_t leafDepth = 0, leaves = 0;
+	for (std::size_t i = 0; i < root->items.size(); i++)
+	{
+		RSTAR_CHECK(root->bound.encloses(root->items[i]->bound));
+		RSTAR_CHECK(root->childBounds.get(i) == root->items[i]->bound);
+
+		if (root->hasLeaves)
+			leaves++;
+		else
+			leaves += RStarTestCheckNode<Tree>(static_cast<const Node*>(root->items[i]), 1, leafDepth, min, max);
+	}
+
+	RSTAR_CHECK(root->items.size() <= max);
+	RSTAR_CHECK(leaves == tree.GetSize());
+}
+
+#endif
@@ -0,0 +1,166 @@
+// BulkLoad, InsertBatch y Merge: el arbol empaquetado responde como la
+// fuerza bruta y respeta la estructura de siempre, con todos los nodos
+// fuera de la raiz entre min y max hijos. Se prueban tamanos que dejan un
+// ultimo slab o un ultimo nodo casi vacio (577 y 4097 con max 64), fill
+// bajo hasta capacity == min, los dos ordenes, el camino en paralelo, y
+// lotes e injertos de alturas iguales y distintas.
+//
+//   g++ -O2 -std=c++11 -pthread tests/bulk.cpp -o bulk && ./bulk
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+template <typename Tree, std::size_t dimensions>
+std::vector< std::pair<int, typename Tree::BoundingBox> > Batch(RStarTestItems<dimensions, typename Tree::BoundingBox::coord_type> &items,
+	RStarTestRandom &random, std::size_t n)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+
+	std::vector< std::pair<int, BoundingBox> > batch;
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		batch.push_back(std::make_pair(items.Add(bound), bound));
+	}
+
+	return batch;
+}
+
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Check(Tree &tree, const RStarTestItems<dimensions, typename Tree::BoundingBox::coord_type> &items, RStarTestRandom &random, std::size_t queries)
+{
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckStructure(tree, min, max);
+	RStarTestCheckRange(tree, items, random, queries);
+}
+
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Load(unsigned seed, std::size_t n, double fill, RStarBulkOrder order, unsigned threads, std::size_t queries)
+{
+	typedef typename Tree::BoundingBox::coord_type Coord;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree;
+
+	const std::vector< std::pair<int, typename Tree::BoundingBox> > batch = Batch<Tree, dimensions>(items, random, n);
+	tree.BulkLoad(batch.begin(), batch.end(), fill, order, threads);
+	Check<Tree, dimensions, min, max>(tree, items, random, queries);
+
+	// el arbol cargado acepta Insert y Remove como cualquiera
+	const std::vector< std::pair<int, typename Tree::BoundingBox> > more = Batch<Tree, dimensions>(items, random, 100);
+	for (std::size_t i = 0; i < more.size(); i++)
+		tree.Insert(more[i].first, more[i].second);
+
+	for (std::size_t i = 0; i < items.bounds.size(); i += 2)
+	{
+		tree.RemoveItem((int)i, items.bounds[i]);
+		items.live[i] = false;
+	}
+
+	Check<Tree, dimensions, min, max>(tree, items, random, queries);
+}
+
+// lotes de tamanos distintos sobre un arbol de base: mas bajos, de la
+// misma altura y mas altos que el arbol
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Batches(unsigned seed, std::size_t base, RStarBulkOrder order)
+{
+	typedef typename Tree::BoundingBox::coord_type Coord;
+
+	// 1100 con max 64 da un lote de dos niveles con mas de min hijos en la
+	// raiz, contra un arbol de dos niveles con pocos
+	const std::size_t sizes[] = { 1, 3, 1100, min - 1, min + 1, max + 1, 577, 4097, 2 };
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree;
+
+	const std::vector< std::pair<int, typename Tree::BoundingBox> > first = Batch<Tree, dimensions>(items, random, base);
+	for (std::size_t i = 0; i < first.size(); i++)
+		tree.Insert(first[i].first, first[i].second);
+
+	for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		const std::vector< std::pair<int, typename Tree::BoundingBox> > batch = Batch<Tree, dimensions>(items, random, sizes[s]);
+		tree.InsertBatch(batch.begin(), batch.end(), 1.0, order, 1);
+		Check<Tree, dimensions, min, max>(tree, items, random, 50);
+	}
+}
+
+// other se injerta entero; los dos tamanos cubren raices con menos de min
+// hijos y alturas iguales y distintas
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Merge(unsigned seed, std::size_t n, std::size_t otherN, bool bulk)
+{
+	typedef typename Tree::BoundingBox::coord_type Coord;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree, other;
+
+	const std::vector< std::pair<int, typename Tree::BoundingBox> > mine = Batch<Tree, dimensions>(items, random, n);
+	const std::vector< std::pair<int, typename Tree::BoundingBox> > theirs = Batch<Tree, dimensions>(items, random, otherN);
+
+	if (bulk)
+	{
+		tree.BulkLoad(mine.begin(), mine.end());
+		other.BulkLoad(theirs.begin(), theirs.end());
+	}
+	else
+	{
+		for (std::size_t i = 0; i < mine.size(); i++)
+			tree.Insert(mine[i].first, mine[i].second);
+		for (std::size_t i = 0; i < theirs.size(); i++)
+			other.Insert(theirs[i].first, theirs[i].second);
+	}
+
+	tree.Merge(std::move(other));
+	RSTAR_CHECK(other.GetSize() == 0);
+	Check<Tree, dimensions, min, max>(tree, items, random, 50);
+}
+
+int main()
+{
+	typedef RStarTree<int, 2, 16, 64> Tree;
+	typedef RStarTree<int, 3, 4, 8, double> Small;
+
+	// los tamanos del reporte, y los bordes de un nodo y de un slab
+	const std::size_t sizes[] = { 1, 15, 16, 17, 63, 64, 65, 129, 577, 1000, 4097, 4160 };
+	const double fills[] = { 1.0, 0.7, 0.3, 0.25 };
+
+	for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+		for (std::size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++)
+		{
+			Load<Tree, 2, 16, 64>((unsigned)(s * 10 + f), sizes[s], fills[f], RSTAR_BULK_STR, 1, 20);
+			Load<Tree, 2, 16, 64>((unsigned)(s * 10 + f), sizes[s], fills[f], RSTAR_BULK_HILBERT, 1, 20);
+		}
+
+	// todos los tamanos chicos en 3D, con capacity == min
+	for (std::size_t n = 1; n < 300; n++)
+	{
+		Load<Small, 3, 4, 8>((unsigned)n, n, 1.0, RSTAR_BULK_STR, 1, 5);
+		Load<Small, 3, 4, 8>((unsigned)n, n, 0.5, RSTAR_BULK_STR, 1, 5);
+		Load<Small, 3, 4, 8>((unsigned)n, n, 0.5, RSTAR_BULK_HILBERT, 1, 5);
+	}
+
+	// por encima de RSTAR_BULK_PARALLEL_MIN, con hilos
+	Load<Tree, 2, 16, 64>(100, RSTAR_BULK_PARALLEL_MIN + 577, 1.0, RSTAR_BULK_STR, 4, 50);
+	Load<Tree, 2, 16, 64>(101, RSTAR_BULK_PARALLEL_MIN + 577, 0.25, RSTAR_BULK_HILBERT, 4, 50);
+
+	Batches<Tree, 2, 16, 64>(200, 100, RSTAR_BULK_STR);
+	Batches<Tree, 2, 16, 64>(201, 3000, RSTAR_BULK_HILBERT);
+	Batches<Small, 3, 4, 8>(202, 50, RSTAR_BULK_STR);
+
+	// alturas iguales con raices chicas, y distintas para los dos lados
+	const std::size_t merges[][2] = { { 65, 65 }, { 577, 577 }, { 100, 1100 }, { 1100, 100 }, { 100, 4097 }, { 4097, 100 }, { 5, 4097 }, { 4097, 5 } };
+	for (std::size_t m = 0; m < sizeof(merges) / sizeof(merges[0]); m++)
+	{
+		Merge<Tree, 2, 16, 64>((unsigned)(300 + m), merges[m][0], merges[m][1], true);
+		Merge<Tree, 2, 16, 64>((unsigned)(400 + m), merges[m][0], merges[m][1], false);
+		Merge<Small, 3, 4, 8>((unsigned)(500 + m), merges[m][0], merges[m][1], true);
+	}
+
+	return RStarTestResult("bulk");
+}
@@ -0,0 +1,174 @@
+// ChooseSubtree de RStarStrategyRStar contra una version directa del
+// criterio R*: antes de cada Insert se baja por el camino que elige la
+// estrategia y en cada nodo se compara el hijo elegido con el que sale de
+// ordenar a todos por ampliacion de area, cortar en choose_subtree_p como
+// el ChooseSubtree original y, si los hijos tienen hojas, tomar el de menor
+// ampliacion de overlap contra todos los hermanos. Se comparan los costos
+// (overlap, area ampliada, area) y no los indices, asi que los empates
+// exactos dan igual.
+//
+//   g++ -O2 -std=c++11 -pthread tests/choose.cpp -o choose && ./choose
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+template <typename Accum>
+struct Key
+{
+	Accum overlap, enlargement, area;
+
+	bool operator<(const Key &other) const
+	{
+		if (overlap != other.overlap)
+			return overlap < other.overlap;
+		if (enlargement != other.enlargement)
+			return enlargement < other.enlargement;
+		return area < other.area;
+	}
+
+	bool operator==(const Key &other) const
+	{
+		return overlap == other.overlap && enlargement == other.enlargement && area == other.area;
+	}
+};
+
+template <typename Accum>
+struct ByEnlargement
+{
+	const std::vector< Key<Accum> > &keys;
+	explicit ByEnlargement(const std::vector< Key<Accum> > &keys) : keys(keys) {}
+
+	bool operator()(std::size_t a, std::size_t b) const
+	{
+		return keys[a].enlargement < keys[b].enlargement ||
+			(keys[a].enlargement == keys[b].enlargement && keys[a].area < keys[b].area);
+	}
+};
+
+// costos de todos los hijos de node para bound, calculados uno por uno
+template <typename Node, typename BoundingBox>
+std::vector< Key<typename BoundingBox::accum_type> > Keys(const Node * node, const BoundingBox &bound)
+{
+	typedef typename BoundingBox::accum_type Accum;
+
+	const std::size_t n = node->items.size();
+	const bool leaves = static_cast<const Node*>(node->items[0])->hasLeaves;
+	std::vector< Key<Accum> > keys(n);
+
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const BoundingBox &box = node->items[i]->bound;
+		BoundingBox enlarged = box;
+		enlarged.stretch(bound);
+
+		keys[i].area = box.area();
+		keys[i].enlargement = enlarged.area() - keys[i].area;
+		keys[i].overlap = 0;
+
+		if (leaves)
+			for (std::size_t j = 0; j < n; j++)
+				if (j != i)
+					keys[i].overlap += enlarged.overlap(node->items[j]->bound) - box.overlap(node->items[j]->bound);
+	}
+
+	return keys;
+}
+
+// el mejor costo segun el criterio R*, con el corte en p candidatos
+template <typename Node, typename BoundingBox>
+Key<typename BoundingBox::accum_type> Reference(const Node * node, const BoundingBox &bound, std::size_t p, std::size_t max)
+{
+	typedef typename BoundingBox::accum_type Accum;
+
+	const std::vector< Key<Accum> > keys = Keys(node, bound);
+	std::vector<std::size_t> order(keys.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), ByEnlargement<Accum>(keys));
+
+	if (!static_cast<const Node*>(node->items[0])->hasLeaves)
+		return keys[order[0]];
+
+	if (max > (p*2)/3 && order.size() > p)
+		order.resize(p);
+
+	Key<Accum> best = keys[order[0]];
+	for (std::size_t c = 1; c < order.size(); c++)
+		if (keys[order[c]] < best)
+			best = keys[order[c]];
+
+	return best;
+}
+
+template <std::size_t dimensions, typename Coord>
+RStarBoundingBox<dimensions, Coord> Box(RStarTestRandom &random, double side, double maxSide)
+{
+	std::uniform_real_distribution<double> position(0, side), size(0, maxSide);
+
+	RStarBoundingBox<dimensions, Coord> bound;
+	for (std::size_t axis = 0; axis < dimensions; axis++)
+	{
+		bound.edges[axis].first = (Coord)position(random);
+		bound.edges[axis].second = bound.edges[axis].first + (Coord)size(random);
+	}
+
+	return bound;
+}
+
+template <typename Tree, typename Strategy, std::size_t dimensions, std::size_t max, std::size_t p>
+void Run(unsigned seed, std::size_t inserts)
+{
+	typedef typename Tree::Node Node;
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+	typedef typename BoundingBox::accum_type Accum;
+
+	RStarTestRandom random(seed);
+	Tree tree;
+	std::size_t checked = 0, cut = 0;
+
+	for (std::size_t i = 0; i < inserts; i++)
+	{
+		// la mitad chicas y dispersas, la mitad en un cumulo: muchas
+		// quedan adentro de un hijo y empatan en ampliacion 0
+		const BoundingBox bound = i % 2 ?
+			Box<dimensions, Coord>(random, 1000, 20) : Box<dimensions, Coord>(random, 100, 3);
+
+		const Node * node = tree.GetRoot();
+		while (node && node->items.size() && !node->hasLeaves)
+		{
+			const std::size_t index = Strategy::ChooseSubtree(node, bound);
+			RSTAR_CHECK(index < node->items.size());
+
+			const std::vector< Key<Accum> > keys = Keys(node, bound);
+			RSTAR_CHECK(keys[index] == Reference(node, bound, p, max));
+
+			checked++;
+			if (static_cast<const Node*>(node->items[0])->hasLeaves && node->items.size() > p)
+				cut++;
+
+			node = static_cast<const Node*>(node->items[index]);
+		}
+
+		tree.Insert((int)i, bound);
+	}
+
+	RSTAR_CHECK(tree.GetSize() == inserts);
+	RSTAR_CHECK(checked > inserts);
+
+	// que el corte en p candidatos se haya probado donde puede haberlo
+	RSTAR_CHECK(max < p || cut > 0);
+}
+
+int main()
+{
+	typedef RStarStrategyRStar<> RStar;
+	typedef RStarStrategyRStar<30, 4> RStarP4;
+
+	Run<RStarTree<int, 2, 4, 16>, RStar, 2, 16, 32>(1, 5000);
+	Run<RStarTree<int, 2, 16, 64, double>, RStar, 2, 64, 32>(2, 20000);
+	Run<RStarTree<int, 3, 4, 16, double, RStarPoolAllocator, RStarNoLocator, RStarP4>, RStarP4, 3, 16, 4>(3, 5000);
+
+	return RStarTestResult("choose");
+}
@@ -0,0 +1,148 @@
+// Save, RStarMappedTree y Load: el archivo mapeado y el arbol cargado
+// responden como el original, el cargado se puede seguir modificando, y los
+// archivos cortados, de otra configuracion o con el magic roto se rechazan
+// sin tocar el arbol.
+//
+//   g++ -O2 -std=c++11 -pthread tests/file.cpp -o file && ./file
+
+#include <cstdio>
+#include <fstream>
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+#define FILE_NAME "rstar-test-file.bin"
+
+bool Truncate(const char * fileName, std::size_t keep)
+{
+	std::ifstream in(fileName, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	if (bytes.size() < keep)
+		return false;
+
+	bytes.resize(keep);
+	std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+	out.write(bytes.empty() ? NULL : &bytes[0], bytes.size());
+	return (bool)out;
+}
+
+template <typename Tree, std::size_t dimensions>
+void Run(unsigned seed)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+	typedef RStarMappedTree<int, dimensions, Coord> MappedTree;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree;
+
+	// vacio
+	RSTAR_CHECK(tree.Save(FILE_NAME));
+	{
+		MappedTree mapped;
+		RSTAR_CHECK(mapped.Open(FILE_NAME));
+		RSTAR_CHECK(mapped.GetSize() == 0);
+		RStarTestCheckRange(mapped, items, random, 10);
+
+		Tree loaded;
+		RSTAR_CHECK(loaded.Load(FILE_NAME));
+		RSTAR_CHECK(loaded.GetSize() == 0);
+	}
+
+	// con borrados, para que queden bounds mas grandes que sus hijos
+	for (std::size_t i = 0; i < 6000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		tree.Insert(items.Add(bound), bound);
+	}
+
+	for (std::size_t i = 0; i < items.bounds.size(); i += 2)
+	{
+		tree.RemoveItem((int)i, items.bounds[i]);
+		items.live[i] = false;
+	}
+
+	RSTAR_CHECK(tree.Save(FILE_NAME));
+
+	{
+		MappedTree mapped;
+		RSTAR_CHECK(mapped.Open(FILE_NAME));
+		RSTAR_CHECK(mapped.GetSize() == items.Size());
+		RStarTestCheckRange(mapped, items, random, 300);
+	}
+
+	Tree loaded;
+	RSTAR_CHECK(loaded.Load(FILE_NAME));
+	RSTAR_CHECK(loaded.GetSize() == items.Size());
+	RStarTestCheckRange(loaded, items, random, 300);
+
+	// el cargado es un arbol normal
+	for (std::size_t i = 1; i < items.bounds.size(); i += 4)
+	{
+		loaded.RemoveItem((int)i, items.bounds[i]);
+		items.live[i] = false;
+	}
+
+	for (std::size_t i = 0; i < 1000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		loaded.Insert(items.Add(bound), bound);
+	}
+
+	RSTAR_CHECK(loaded.GetSize() == items.Size());
+	RStarTestCheckRange(loaded, items, random, 300);
+
+	// y se puede volver a guardar
+	RSTAR_CHECK(loaded.Save(FILE_NAME));
+	{
+		MappedTree mapped;
+		RSTAR_CHECK(mapped.Open(FILE_NAME));
+		RStarTestCheckRange(mapped, items, random, 100);
+	}
+
+	// otra configuracion
+	{
+		RStarMappedTree<int, dimensions + 1, Coord> other;
+		RSTAR_CHECK(!other.Open(FILE_NAME));
+
+		RStarMappedTree<long long, dimensions, Coord> payload;
+		RSTAR_CHECK(!payload.Open(FILE_NAME));
+	}
+
+	// cortado: Open y Load fallan y loaded no cambia
+	RSTAR_CHECK(Truncate(FILE_NAME, sizeof(RStarFileHeader) + 100));
+	{
+		MappedTree mapped;
+		RSTAR_CHECK(!mapped.Open(FILE_NAME));
+		RSTAR_CHECK(!loaded.Load(FILE_NAME));
+		RSTAR_CHECK(loaded.GetSize() == items.Size());
+		RStarTestCheckRange(loaded, items, random, 50);
+	}
+
+	// magic roto
+	RSTAR_CHECK(loaded.Save(FILE_NAME));
+	{
+		std::fstream f(FILE_NAME, std::ios::binary | std::ios::in | std::ios::out);
+		f.seekp(0);
+		f.put('X');
+	}
+	{
+		MappedTree mapped;
+		RSTAR_CHECK(!mapped.Open(FILE_NAME));
+	}
+
+	RSTAR_CHECK(!loaded.Load("rstar-test-no-such-file.bin"));
+	std::remove(FILE_NAME);
+}
+
+int main()
+{
+	Run<RStarTree<int, 2, 4, 16>, 2>(1);
+	Run<RStarTree<int, 3, 8, 32, float>, 3>(2);
+	Run<RStarTree<int, 2, 8, 32, double>, 2>(3);
+
+	return RStarTestResult("file");
+}
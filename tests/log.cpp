@@ -0,0 +1,211 @@
+// RStarLoggedTree: despues de cerrar y reabrir, el arbol reaplicado del log
+// (con y sin checkpoint) tiene los mismos items que la fuerza bruta; un log
+// cortado a mitad del ultimo registro pierde solo ese registro, y uno con
+// un byte cambiado en el medio se corta en el registro danado.
+//
+//   g++ -O2 -std=c++11 -pthread tests/log.cpp -o log && ./log
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "../RStarTree.h"
+#include "../RStarLog.h"
+#include "RStarTest.h"
+
+typedef RStarTree<int, 2, 4, 16> Tree;
+typedef RStarLoggedTree<Tree> LoggedTree;
+typedef Tree::BoundingBox BoundingBox;
+typedef RStarTestItems<2, int> Items;
+
+#define PREFIX "rstar-test-log"
+
+std::string LogName(uint64_t generation)
+{
+	std::ostringstream name;
+	name << PREFIX << "." << generation << ".log";
+	return name.str();
+}
+
+std::vector<char> ReadFile(const std::string &fileName)
+{
+	std::ifstream in(fileName.c_str(), std::ios::binary);
+	return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string &fileName, const std::vector<char> &bytes)
+{
+	std::ofstream out(fileName.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(bytes.empty() ? NULL : &bytes[0], bytes.size());
+}
+
+// los vivos de items pasan a ser los que estan en el arbol; para despues de
+// RemoveBoundedArea y Clear, que no dicen que borraron
+void Refresh(Tree &tree, Items &items)
+{
+	const RStarTestCollect<Tree::Leaf> all = tree.Query(Tree::AcceptAny(), RStarTestCollect<Tree::Leaf>());
+
+	std::fill(items.live.begin(), items.live.end(), false);
+	for (std::size_t i = 0; i < all.ids.size(); i++)
+		items.live[all.ids[i]] = true;
+}
+
+// count cambios al azar de todos los tipos
+void Change(LoggedTree &logged, Items &items, RStarTestRandom &random, std::size_t count)
+{
+	std::uniform_int_distribution<int> op(0, 99);
+
+	for (std::size_t c = 0; c < count; c++)
+	{
+		const int choice = op(random);
+		const int id = items.bounds.empty() ? -1 : (int)(random() % items.bounds.size());
+
+		if (choice < 50 || id < 0 || !items.live[id])
+		{
+			const BoundingBox bound = RStarTestBox<2, int>(random, 1000, 20);
+			RSTAR_CHECK(logged.Insert(items.Add(bound), bound));
+		}
+		else if (choice < 65)
+		{
+			RSTAR_CHECK(logged.RemoveItem(id, items.bounds[id]));
+			items.live[id] = false;
+		}
+		else if (choice < 75)
+		{
+			RSTAR_CHECK(logged.RemoveItem(id));
+			items.live[id] = false;
+		}
+		else if (choice < 98)
+		{
+			const BoundingBox bound = RStarTestBox<2, int>(random, 1000, 20);
+			RSTAR_CHECK(logged.Update(id, items.bounds[id], bound, choice % 3));
+			items.bounds[id] = bound;
+		}
+		else
+		{
+			RSTAR_CHECK(logged.RemoveBoundedArea(RStarTestBox<2, int>(random, 1000, 80)));
+			Refresh(logged.GetTree(), items);
+		}
+	}
+}
+
+void Check(LoggedTree &logged, const Items &items, RStarTestRandom &random)
+{
+	RSTAR_CHECK(logged.GetSize() == items.Size());
+	RStarTestCheckRange(logged.GetTree(), items, random, 200);
+}
+
+int main()
+{
+	RStarLogOptions options;
+	options.groupCommit = 0;
+	options.sync = false;
+
+	RStarTestRandom random(1);
+	Items items;
+
+	LoggedTree::Destroy(PREFIX);
+
+	// solo log
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		Change(logged, items, random, 3000);
+		RSTAR_CHECK(logged.Commit());
+		Check(logged, items, random);
+	}
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		RSTAR_CHECK(logged.GetStats().replayed == 3000);
+		Check(logged, items, random);
+
+		// un Clear en el log y despues mas cambios
+		RSTAR_CHECK(logged.Clear());
+		Refresh(logged.GetTree(), items);
+		Change(logged, items, random, 1000);
+	}
+
+	// checkpoint y log despues del checkpoint
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		Check(logged, items, random);
+
+		RSTAR_CHECK(logged.Checkpoint());
+		Change(logged, items, random, 500);
+	}
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		RSTAR_CHECK(logged.GetStats().loadedLeaves > 0);
+		RSTAR_CHECK(logged.GetStats().replayed == 500);
+		Check(logged, items, random);
+	}
+
+	// el ultimo registro a medias: se pierde solo ese Insert
+	uint64_t generation;
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		generation = logged.GetGeneration();
+
+		const BoundingBox bound = RStarTestBox<2, int>(random, 1000, 20);
+		RSTAR_CHECK(logged.Insert(items.Add(bound), bound));
+	}
+	items.live.back() = false;
+	{
+		std::vector<char> bytes = ReadFile(LogName(generation));
+		RSTAR_CHECK(bytes.size() > 10);
+		bytes.resize(bytes.size() - 3);
+		WriteFile(LogName(generation), bytes);
+	}
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		Check(logged, items, random);
+
+		// y se puede seguir escribiendo despues del corte
+		Change(logged, items, random, 200);
+	}
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		Check(logged, items, random);
+	}
+
+	// un byte cambiado: el CRC corta el replay en ese registro
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		RSTAR_CHECK(logged.Checkpoint());
+		generation = logged.GetGeneration();
+
+		for (int i = 0; i < 10; i++)
+		{
+			const BoundingBox bound = RStarTestBox<2, int>(random, 1000, 20);
+			RSTAR_CHECK(logged.Insert(items.Add(bound), bound));
+		}
+	}
+	{
+		std::vector<char> bytes = ReadFile(LogName(generation));
+		const std::size_t record = (bytes.size() - sizeof(RStarLogHeader)) / 10;
+		RSTAR_CHECK(record * 10 == bytes.size() - sizeof(RStarLogHeader));
+
+		// el registro 6 y los que le siguen se descartan
+		bytes[sizeof(RStarLogHeader) + 5 * record + 4] ^= 0x20;
+		WriteFile(LogName(generation), bytes);
+
+		for (std::size_t i = items.live.size() - 5; i < items.live.size(); i++)
+			items.live[i] = false;
+	}
+	{
+		LoggedTree logged;
+		RSTAR_CHECK(logged.Open(PREFIX, options));
+		RSTAR_CHECK(logged.GetStats().replayed == 5);
+		Check(logged, items, random);
+	}
+
+	LoggedTree::Destroy(PREFIX);
+	return RStarTestResult("log");
+}
@@ -0,0 +1,129 @@
+// QueryNearest contra fuerza bruta: despues de insertar, despues de borrar
+// casi todo (los bounds de los nodos quedan mas grandes que sus hijos) y
+// despues de mover items con slack.
+//
+//   g++ -O2 -std=c++11 -pthread tests/nearest.cpp -o nearest && ./nearest
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+template <typename Tree>
+struct CollectNearest
+{
+	bool ContinueVisiting;
+	std::vector<std::pair<int, double> > found;
+
+	CollectNearest() : ContinueVisiting(true) {}
+
+	void operator()(const typename Tree::Leaf * const leaf, double distance)
+	{
+		found.push_back(std::make_pair(leaf->leaf, distance));
+	}
+};
+
+template <typename Tree, typename Items>
+void CheckNearest(Tree &tree, const Items &items, RStarTestRandom &random, std::size_t queries)
+{
+	const std::size_t ks[] = { 1, 3, 16 };
+	typename Tree::NearestBuffer buffer;
+
+	for (std::size_t q = 0; q < queries; q++)
+	{
+		const RStarPoint<2> point = RStarTestPoint<2>(random, 1000);
+
+		for (std::size_t k = 0; k < sizeof(ks) / sizeof(ks[0]); k++)
+		{
+			const std::vector<double> expected = items.Nearest(point, ks[k]);
+			const CollectNearest<Tree> result = tree.QueryNearest(point, ks[k], CollectNearest<Tree>(), buffer);
+
+			RSTAR_CHECK(result.found.size() == expected.size());
+
+			for (std::size_t i = 0; i < result.found.size() && i < expected.size(); i++)
+			{
+				const int id = result.found[i].first;
+
+				RSTAR_CHECK(result.found[i].second == expected[i]);
+				RSTAR_CHECK(id >= 0 && id < (int)items.bounds.size() && items.live[id]);
+				RSTAR_CHECK(items.bounds[id].minDistance(point) == result.found[i].second);
+			}
+		}
+	}
+}
+
+template <typename Tree>
+void Run(unsigned seed)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<2, Coord> items;
+	Tree tree;
+
+	for (std::size_t i = 0; i < 5000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<2, Coord>(random, 1000, 20);
+		tree.Insert(items.Add(bound), bound);
+	}
+
+	CheckNearest(tree, items, random, 200);
+
+	// borra el 90%, la mitad con el bound y la mitad sin el
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+	{
+		if (i % 10 == 0)
+			continue;
+
+		if (i % 2)
+			tree.RemoveItem((int)i, items.bounds[i]);
+		else
+			tree.RemoveItem((int)i);
+
+		items.live[i] = false;
+	}
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	CheckNearest(tree, items, random, 1000);
+
+	// mueve los que quedan, unos en sitio dentro del slack y otros lejos
+	std::uniform_int_distribution<int> shift(-3, 3);
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+	{
+		if (!items.live[i])
+			continue;
+
+		BoundingBox bound = items.bounds[i];
+		if (i % 3 == 0)
+			bound = RStarTestBox<2, Coord>(random, 1000, 20);
+		else
+			for (std::size_t axis = 0; axis < 2; axis++)
+			{
+				const int d = shift(random);
+				bound.edges[axis].first += (Coord)d;
+				bound.edges[axis].second += (Coord)d;
+			}
+
+		RSTAR_CHECK(tree.Update((int)i, items.bounds[i], bound, 4));
+		items.bounds[i] = bound;
+	}
+
+	CheckNearest(tree, items, random, 1000);
+
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+		if (items.live[i])
+		{
+			tree.RemoveItem((int)i, items.bounds[i]);
+			items.live[i] = false;
+		}
+
+	RSTAR_CHECK(tree.GetSize() == 0);
+	CheckNearest(tree, items, random, 10);
+}
+
+int main()
+{
+	Run< RStarTree<int, 2, 4, 16> >(1);
+	Run< RStarTree<int, 2, 8, 32, double> >(2);
+
+	return RStarTestResult("nearest");
+}
@@ -0,0 +1,223 @@
+// RStarPagedTree y RStarBufferPool: Insert, Remove y Query contra fuerza
+// bruta con un pool mucho mas chico que el arbol, con CLOCK y con LRU;
+// cerrar y reabrir el archivo; paginas liberadas que se reusan desde la
+// lista libre antes de agrandar el archivo; y los contadores del pool en
+// recorridos que no entran y que entran en el pool.
+//
+//   g++ -O2 -std=c++11 -pthread tests/paged.cpp -o paged && ./paged
+
+#include <cstdio>
+
+#include "../RStarPagedTree.h"
+#include "RStarTest.h"
+
+#define FILE_NAME "rstar-test-paged.pg"
+
+typedef RStarTestItems<2, int> Items;
+
+// la politica sola: despues de 0 1 2 0, LRU desaloja 1 y CLOCK, con todos
+// los bits encendidos, da la vuelta y desaloja 0; un frame fijado se salta
+// (pinned 3 no fija ninguno)
+struct PinnedFrame
+{
+	std::size_t frame;
+	explicit PinnedFrame(std::size_t frame) : frame(frame) {}
+	bool operator()(std::size_t f) const { return f == frame; }
+};
+
+template <typename Replacement>
+std::size_t Victim(std::size_t pinned)
+{
+	Replacement replacement;
+	replacement.Reset(3);
+	replacement.Access(0);
+	replacement.Access(1);
+	replacement.Access(2);
+	replacement.Access(0);
+	return replacement.Victim(PinnedFrame(pinned));
+}
+
+template <typename Tree>
+void Change(Tree &tree, Items &items, RStarTestRandom &random, std::size_t inserts)
+{
+	for (std::size_t i = 0; i < inserts; i++)
+	{
+		const typename Tree::BoundingBox bound = RStarTestBox<2, int>(random, 1000, 20);
+		RSTAR_CHECK(tree.Insert(items.Add(bound), bound));
+	}
+}
+
+template <typename Tree>
+void Check(Tree &tree, const Items &items, RStarTestRandom &random, std::size_t queries)
+{
+	RSTAR_CHECK(!tree.HasFailed());
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckRange(tree, items, random, queries);
+
+	const RStarTestCollect<typename Tree::Leaf> all = tree.Query(typename Tree::AcceptAny(), RStarTestCollect<typename Tree::Leaf>());
+	RSTAR_CHECK(all.ids.size() == items.Size());
+}
+
+template <typename Tree>
+RStarBufferStats Scan(Tree &tree, const typename Tree::BoundingBox &bound)
+{
+	const RStarBufferStats before = tree.GetBufferStats();
+	tree.Query(typename Tree::AcceptOverlapping(bound), RStarTestCollect<typename Tree::Leaf>());
+	return tree.GetBufferStats() - before;
+}
+
+template <typename Replacement>
+void Run(unsigned seed)
+{
+	typedef RStarPagedTree<int, 2, 4, 16, int, Replacement> Tree;
+	typedef typename Tree::BoundingBox BoundingBox;
+
+	RStarTestRandom random(seed);
+	Items items;
+	uint64_t pages;
+
+	{
+		Tree tree;
+		RSTAR_CHECK(tree.Open(FILE_NAME, RSTAR_PAGED_MIN_FRAMES, true));
+		RSTAR_CHECK(tree.GetSize() == 0);
+		Check(tree, items, random, 10);
+
+		// con el pool minimo el arbol no entra ni de lejos
+		Change(tree, items, random, 8000);
+		RSTAR_CHECK(tree.GetPageCount() > 10 * tree.GetPoolSize());
+		Check(tree, items, random, 200);
+
+		// dos tercios afuera, con y sin el bound, y algunas areas
+		for (std::size_t i = 0; i < items.bounds.size(); i++)
+		{
+			if (i % 3 == 0)
+				continue;
+
+			if (i % 3 == 1)
+				RSTAR_CHECK(tree.RemoveItem((int)i, items.bounds[i]));
+			else if (i % 300 == 2)
+				RSTAR_CHECK(tree.RemoveItem((int)i));
+			else
+				RSTAR_CHECK(tree.RemoveItem((int)i, items.bounds[i], false));
+
+			items.live[i] = false;
+		}
+
+		for (std::size_t a = 0; a < 5; a++)
+		{
+			const BoundingBox area = RStarTestBox<2, int>(random, 1000, 100);
+			RSTAR_CHECK(tree.RemoveBoundedArea(area));
+
+			for (std::size_t i = 0; i < items.bounds.size(); i++)
+				if (area.encloses(items.bounds[i]))
+					items.live[i] = false;
+		}
+
+		Check(tree, items, random, 200);
+		pages = tree.GetPageCount();
+		RSTAR_CHECK(tree.Close());
+	}
+
+	// reabierto: el mismo contenido y el mismo archivo
+	{
+		Tree tree;
+		RSTAR_CHECK(tree.Open(FILE_NAME, RSTAR_PAGED_MIN_FRAMES));
+		RSTAR_CHECK(tree.GetPageCount() == pages);
+		Check(tree, items, random, 200);
+
+		// vaciado del todo: las paginas quedan en la lista libre
+		for (std::size_t i = 0; i < items.bounds.size(); i++)
+			if (items.live[i])
+			{
+				RSTAR_CHECK(tree.RemoveItem((int)i, items.bounds[i]));
+				items.live[i] = false;
+			}
+
+		RSTAR_CHECK(tree.GetSize() == 0);
+		RSTAR_CHECK(tree.GetHeight() == 0);
+		RSTAR_CHECK(tree.GetPageCount() == pages);
+
+		// menos items que antes: todas las paginas salen de la lista libre
+		Change(tree, items, random, 4000);
+		RSTAR_CHECK(tree.GetPageCount() == pages);
+		Check(tree, items, random, 200);
+	}
+
+	// otra configuracion no abre el archivo
+	{
+		RStarPagedTree<int, 3, 4, 16, int, Replacement> other;
+		RSTAR_CHECK(!other.Open(FILE_NAME));
+	}
+
+	// contadores del pool
+	{
+		Tree tree;
+		RSTAR_CHECK(tree.Open(FILE_NAME, RSTAR_PAGED_MIN_FRAMES));
+		RSTAR_CHECK(tree.GetPageCount() == pages);
+		Check(tree, items, random, 20);
+
+		BoundingBox everything;
+		everything.edges[0].first = everything.edges[1].first = -1;
+		everything.edges[0].second = everything.edges[1].second = 2000;
+
+		// un recorrido entero no entra: cada pagina se fija una vez, y solo
+		// las que ya estaban en el pool pueden ser hits
+		const RStarBufferStats first = Scan(tree, everything);
+		const RStarBufferStats second = Scan(tree, everything);
+		const std::size_t visited = first.hits + first.misses;
+
+		RSTAR_CHECK(visited > 10 * tree.GetPoolSize());
+		RSTAR_CHECK(visited < pages);
+		RSTAR_CHECK(second.hits + second.misses == visited);
+		RSTAR_CHECK(second.hits <= tree.GetPoolSize());
+		RSTAR_CHECK(second.reads == second.misses);
+		RSTAR_CHECK(second.evictions >= second.misses - tree.GetPoolSize());
+
+		// una consulta chica se repite entera desde el pool
+		const BoundingBox small = RStarTestBox<2, int>(random, 1000, 5);
+		const RStarBufferStats cold = Scan(tree, small);
+		const RStarBufferStats warm = Scan(tree, small);
+
+		RSTAR_CHECK(cold.hits + cold.misses > 0);
+		RSTAR_CHECK(warm.hits == cold.hits + cold.misses);
+		RSTAR_CHECK(warm.misses == 0);
+		RSTAR_CHECK(warm.reads == 0);
+
+		// con un pool mas grande que el archivo, el segundo recorrido entero
+		// ya no lee nada
+		RSTAR_CHECK(tree.SetPoolSize((std::size_t)pages + 16));
+		const RStarBufferStats load = Scan(tree, everything);
+		const RStarBufferStats resident = Scan(tree, everything);
+
+		RSTAR_CHECK(load.misses == visited);
+		RSTAR_CHECK(load.evictions == 0);
+		RSTAR_CHECK(resident.hits == visited);
+		RSTAR_CHECK(resident.misses == 0);
+
+		// y el arbol se sigue modificando con el pool que sea
+		RSTAR_CHECK(tree.SetPoolSize(RSTAR_PAGED_MIN_FRAMES));
+		Change(tree, items, random, 1000);
+		Check(tree, items, random, 100);
+	}
+
+	{
+		Tree tree;
+		RSTAR_CHECK(tree.Open(FILE_NAME, 64));
+		Check(tree, items, random, 100);
+	}
+
+	std::remove(FILE_NAME);
+}
+
+int main()
+{
+	RSTAR_CHECK(Victim<RStarLRUReplacement>(3) == 1);
+	RSTAR_CHECK(Victim<RStarClockReplacement>(3) == 0);
+	RSTAR_CHECK(Victim<RStarLRUReplacement>(1) == 2);
+	RSTAR_CHECK(Victim<RStarClockReplacement>(0) == 1);
+
+	Run<RStarClockReplacement>(1);
+	Run<RStarLRUReplacement>(2);
+
+	return RStarTestResult("paged");
+}
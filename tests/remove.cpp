@@ -0,0 +1,138 @@
+// RemoveItem y RemoveBoundedArea contra fuerza bruta, con y sin Locator:
+// consultas de rango y estructura del arbol despues de cada etapa, items
+// que ya no estan, duplicados, y un arbol vaciado del todo que se vuelve a
+// llenar.
+//
+//   g++ -O2 -std=c++11 -pthread tests/remove.cpp -o remove && ./remove
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+// caja estrictamente adentro de bound: RemoveBoundedArea la tiene que
+// sacar; las que solo tocan el borde dependen de los bounds de los nodos
+template <typename BoundingBox>
+bool Inside(const BoundingBox &bound, const BoundingBox &item)
+{
+	for (std::size_t axis = 0; axis < sizeof(bound.edges) / sizeof(bound.edges[0]); axis++)
+		if (!(bound.edges[axis].first < item.edges[axis].first) || !(item.edges[axis].second < bound.edges[axis].second))
+			return false;
+
+	return true;
+}
+
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Run(unsigned seed)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree;
+
+	for (std::size_t i = 0; i < 4000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		tree.Insert(items.Add(bound), bound);
+	}
+
+	// dos tercios afuera, con y sin el bound
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+	{
+		if (i % 3 == 0)
+			continue;
+
+		if (i % 3 == 1)
+			tree.RemoveItem((int)i, items.bounds[i]);
+		else
+			tree.RemoveItem((int)i);
+
+		items.live[i] = false;
+	}
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckStructure(tree, min, max);
+	RStarTestCheckRange(tree, items, random, 300);
+
+	// ya no estan, o el bound no es el suyo: no cambia nada
+	tree.RemoveItem(1);
+	tree.RemoveItem(2, items.bounds[2]);
+	tree.RemoveItem(3, RStarTestBox<dimensions, Coord>(random, 1000, 30));
+	tree.RemoveItem(-1);
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckRange(tree, items, random, 100);
+
+	// RemoveBoundedArea saca solo cajas que encierra, y todas las de adentro
+	for (std::size_t a = 0; a < 20; a++)
+	{
+		const BoundingBox area = RStarTestBox<dimensions, Coord>(random, 1000, 150);
+		tree.RemoveBoundedArea(area);
+
+		const RStarTestCollect<typename Tree::Leaf> all =
+			tree.Query(typename Tree::AcceptAny(), RStarTestCollect<typename Tree::Leaf>());
+		std::vector<bool> found(items.bounds.size(), false);
+		for (std::size_t i = 0; i < all.ids.size(); i++)
+			found[all.ids[i]] = true;
+
+		for (std::size_t i = 0; i < items.bounds.size(); i++)
+		{
+			if (!items.live[i])
+				RSTAR_CHECK(!found[i]);
+			else if (!found[i])
+				RSTAR_CHECK(area.encloses(items.bounds[i]));
+			else
+				RSTAR_CHECK(!Inside(area, items.bounds[i]));
+
+			items.live[i] = found[i];
+		}
+	}
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckStructure(tree, min, max);
+	RStarTestCheckRange(tree, items, random, 300);
+
+	// el resto, y el arbol vacio se vuelve a llenar
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+		if (items.live[i])
+		{
+			tree.RemoveItem((int)i, items.bounds[i]);
+			items.live[i] = false;
+		}
+
+	RSTAR_CHECK(tree.GetSize() == 0);
+	RStarTestCheckRange(tree, items, random, 10);
+
+	for (std::size_t i = 0; i < 1000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		tree.Insert(items.Add(bound), bound);
+	}
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckStructure(tree, min, max);
+	RStarTestCheckRange(tree, items, random, 100);
+
+	// duplicados: con removeDuplicates false sale uno solo
+	const int duplicate = (int)items.bounds.size() - 1;
+	for (int d = 0; d < 3; d++)
+		tree.Insert(duplicate, RStarTestBox<dimensions, Coord>(random, 1000, 30));
+
+	tree.RemoveItem(duplicate, false);
+	RSTAR_CHECK(tree.GetSize() == items.Size() + 2);
+
+	tree.RemoveItem(duplicate);
+	items.live[duplicate] = false;
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckStructure(tree, min, max);
+	RStarTestCheckRange(tree, items, random, 100);
+}
+
+int main()
+{
+	Run<RStarTree<int, 2, 4, 16>, 2, 4, 16>(1);
+	Run<RStarTree<int, 2, 4, 16, int, RStarPoolAllocator, RStarHashLocator>, 2, 4, 16>(2);
+	Run<RStarTree<int, 3, 8, 32, double, RStarPoolAllocator, RStarHashLocator>, 3, 8, 32>(3);
+
+	return RStarTestResult("remove");
+}
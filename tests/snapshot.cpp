@@ -0,0 +1,169 @@
+// Un escritor y varios lectores con Snapshot. El escritor mantiene vivos
+// los ids de una ventana [low, high): inserta por arriba, borra por abajo y
+// mueve items del medio, y publica cada tanto, asi que los nodos publicados
+// se copian (Writable), se retiran (Retire) y se liberan (Reclaim) mientras
+// los lectores consultan. Cada lector comprueba que su Snapshot ve una
+// ventana entera, con los bounds de cada id, y que QueryNearest sobre el
+// mismo Snapshot coincide con la fuerza bruta sobre esa ventana. Conviene
+// correrla tambien con -fsanitize=thread o -fsanitize=address.
+//
+//   g++ -O2 -std=c++11 -pthread tests/snapshot.cpp -o snapshot && ./snapshot
+
+#include <thread>
+#include <atomic>
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+typedef RStarTree<int, 2, 4, 16> Tree;
+typedef Tree::BoundingBox BoundingBox;
+
+#define READERS 4
+#define WRITES 40000
+#define WINDOW 600
+
+// dos posiciones por id; Update alterna entre ellas
+BoundingBox BoundOf(int id, bool moved)
+{
+	BoundingBox bound;
+	const int x = (id * 7919) % 1000 + (moved ? 3 : 0), y = (id * 104729) % 1000 + (moved ? 3 : 0);
+
+	bound.edges[0].first = x;
+	bound.edges[0].second = x + id % 5;
+	bound.edges[1].first = y;
+	bound.edges[1].second = y + id % 7;
+	return bound;
+}
+
+struct CollectLeaves
+{
+	bool ContinueVisiting;
+	std::vector<const Tree::Leaf*> leaves;
+
+	CollectLeaves() : ContinueVisiting(true) {}
+
+	void operator()(const Tree::Leaf * const leaf) { leaves.push_back(leaf); }
+	void operator()(const Tree::Leaf * const leaf, double) { leaves.push_back(leaf); }
+};
+
+bool ById(const Tree::Leaf * a, const Tree::Leaf * b)
+{
+	return a->leaf < b->leaf;
+}
+
+void Read(const Tree &tree, const std::atomic<bool> &done, unsigned seed, std::size_t &snapshots)
+{
+	RStarTestRandom random(seed);
+	Tree::NearestBuffer buffer;
+
+	// al menos una vuelta aunque el escritor termine antes de arrancar
+	do
+	{
+		const Tree::Snapshot snapshot(tree);
+
+		CollectLeaves all = snapshot.Query(Tree::AcceptAny(), CollectLeaves());
+		std::sort(all.leaves.begin(), all.leaves.end(), ById);
+
+		RSTAR_CHECK(!all.leaves.empty());
+
+		std::vector<double> distances;
+		const RStarPoint<2> point = RStarTestPoint<2>(random, 1000);
+
+		for (std::size_t i = 0; i < all.leaves.size(); i++)
+		{
+			const Tree::Leaf * leaf = all.leaves[i];
+
+			RSTAR_CHECK(i == 0 || leaf->leaf == all.leaves[i-1]->leaf + 1);
+			RSTAR_CHECK(leaf->bound == BoundOf(leaf->leaf, false) || leaf->bound == BoundOf(leaf->leaf, true));
+
+			distances.push_back(leaf->bound.minDistance(point));
+		}
+
+		std::sort(distances.begin(), distances.end());
+
+		const std::size_t k = 8;
+		const CollectLeaves nearest = snapshot.QueryNearest(point, k, CollectLeaves(), buffer);
+
+		RSTAR_CHECK(nearest.leaves.size() == std::min(k, distances.size()));
+
+		for (std::size_t i = 0; i < nearest.leaves.size() && i < distances.size(); i++)
+		{
+			const Tree::Leaf * leaf = nearest.leaves[i];
+
+			RSTAR_CHECK(leaf->bound.minDistance(point) == distances[i]);
+			RSTAR_CHECK(!all.leaves.empty() && all.leaves.front()->leaf <= leaf->leaf && leaf->leaf <= all.leaves.back()->leaf);
+		}
+
+		snapshots++;
+	}
+	while (!done.load());
+}
+
+int main()
+{
+	Tree tree;
+	std::vector<bool> moved;
+	int low = 0, high = 0;
+
+	for (; high < WINDOW; high++)
+	{
+		moved.push_back(false);
+		tree.Insert(high, BoundOf(high, false));
+	}
+
+	// los cambios se ven en los Publish del escritor
+	tree.EnableConcurrentReaders(false);
+
+	std::atomic<bool> done(false);
+	std::size_t snapshots[READERS] = {};
+	std::vector<std::thread> readers;
+
+	for (unsigned r = 0; r < READERS; r++)
+		readers.push_back(std::thread(Read, std::cref(tree), std::cref(done), r + 1, std::ref(snapshots[r])));
+
+	RStarTestRandom random(0);
+	std::uniform_int_distribution<int> op(0, 9), batch(1, 8);
+
+	for (std::size_t w = 0; w < WRITES; )
+	{
+		for (int b = batch(random); b > 0; b--, w++)
+		{
+			const int choice = op(random);
+
+			if (choice < 4 || high - low < WINDOW / 2)
+			{
+				moved.push_back(false);
+				tree.Insert(high, BoundOf(high, false));
+				high++;
+			}
+			else if (choice < 8 && high - low > 1)
+			{
+				tree.RemoveItem(low, BoundOf(low, moved[low]));
+				low++;
+			}
+			else
+			{
+				const int id = low + (int)(random() % (unsigned)(high - low));
+
+				RSTAR_CHECK(tree.Update(id, BoundOf(id, moved[id]), BoundOf(id, !moved[id]), 2));
+				moved[id] = !moved[id];
+			}
+		}
+
+		tree.Publish();
+	}
+
+	done.store(true);
+	for (std::size_t r = 0; r < readers.size(); r++)
+		readers[r].join();
+
+	RSTAR_CHECK(tree.GetSize() == (std::size_t)(high - low));
+
+	CollectLeaves all = tree.Query(Tree::AcceptAny(), CollectLeaves());
+	RSTAR_CHECK(all.leaves.size() == (std::size_t)(high - low));
+
+	for (unsigned r = 0; r < READERS; r++)
+		RSTAR_CHECK(snapshots[r] > 0);
+
+	return RStarTestResult("snapshot");
+}
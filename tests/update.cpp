@@ -0,0 +1,92 @@
+// Update contra fuerza bruta, con y sin Locator: varias vueltas de
+// movimientos chicos (en sitio, dentro o fuera del slack) y saltos lejos,
+// con consultas de rango y la estructura del arbol despues de cada vuelta.
+// Un Update con un oldBound que no es el del item, o de un item que no
+// esta, devuelve false y no cambia nada.
+//
+//   g++ -O2 -std=c++11 -pthread tests/update.cpp -o update && ./update
+
+#include "../RStarTree.h"
+#include "RStarTest.h"
+
+template <typename Tree, std::size_t dimensions, std::size_t min, std::size_t max>
+void Run(unsigned seed)
+{
+	typedef typename Tree::BoundingBox BoundingBox;
+	typedef typename BoundingBox::coord_type Coord;
+
+	RStarTestRandom random(seed);
+	RStarTestItems<dimensions, Coord> items;
+	Tree tree;
+
+	for (std::size_t i = 0; i < 4000; i++)
+	{
+		const BoundingBox bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+		tree.Insert(items.Add(bound), bound);
+	}
+
+	// un tercio afuera, para que haya nodos justo en el minimo
+	for (std::size_t i = 0; i < items.bounds.size(); i += 3)
+	{
+		tree.RemoveItem((int)i, items.bounds[i]);
+		items.live[i] = false;
+	}
+
+	// cada vuelta mueve todos: poco, con slack 0, 2 o 8, y uno de cada
+	// cuatro a cualquier lado
+	std::uniform_int_distribution<int> shift(-4, 4);
+	for (std::size_t round = 0; round < 4; round++)
+	{
+		const Coord slack = (Coord)(round == 0 ? 0 : round == 1 ? 2 : 8);
+
+		for (std::size_t i = 0; i < items.bounds.size(); i++)
+		{
+			if (!items.live[i])
+				continue;
+
+			BoundingBox bound = items.bounds[i];
+			if ((i + round) % 4 == 0)
+				bound = RStarTestBox<dimensions, Coord>(random, 1000, 30);
+			else
+				for (std::size_t axis = 0; axis < dimensions; axis++)
+				{
+					const int d = shift(random);
+					bound.edges[axis].first += (Coord)d;
+					bound.edges[axis].second += (Coord)d;
+				}
+
+			RSTAR_CHECK(tree.Update((int)i, items.bounds[i], bound, slack));
+			items.bounds[i] = bound;
+		}
+
+		RSTAR_CHECK(tree.GetSize() == items.Size());
+		RStarTestCheckStructure(tree, min, max);
+		RStarTestCheckRange(tree, items, random, 200);
+	}
+
+	// con un oldBound que no es el suyo, o un item que no esta, es false
+	RSTAR_CHECK(!tree.Update(1, RStarTestBox<dimensions, Coord>(random, 1000, 30), items.bounds[1]));
+	RSTAR_CHECK(!tree.Update(0, items.bounds[0], items.bounds[1]));
+	RSTAR_CHECK(!tree.Update(-1, items.bounds[1], items.bounds[0]));
+
+	RSTAR_CHECK(tree.GetSize() == items.Size());
+	RStarTestCheckRange(tree, items, random, 100);
+
+	// los movidos se pueden borrar con su bound nuevo
+	for (std::size_t i = 0; i < items.bounds.size(); i++)
+		if (items.live[i])
+		{
+			tree.RemoveItem((int)i, items.bounds[i]);
+			items.live[i] = false;
+		}
+
+	RSTAR_CHECK(tree.GetSize() == 0);
+}
+
+int main()
+{
+	Run<RStarTree<int, 2, 4, 16>, 2, 4, 16>(1);
+	Run<RStarTree<int, 3, 8, 32, double, RStarPoolAllocator, RStarHashLocator>, 3, 8, 32>(2);
+
+	return RStarTestResult("update");
+}